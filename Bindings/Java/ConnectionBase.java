@@ -115,6 +115,9 @@ public class ConnectionBase extends NativeComponent implements AutoCloseable {
   public native long readKeyWithTimeout (int milliseconds)
          throws InterruptedIOException, TimeoutException;
 
+  public native long[] readKeys (int max, int milliseconds)
+         throws InterruptedIOException, TimeoutException;
+
   public native void ignoreKeys (long type, long[] keys);
   public native void acceptKeys (long type, long[] keys);
 
@@ -39,6 +39,7 @@ public class Parameters extends ParameterComponent {
   public final DeviceSpeedParameter deviceSpeed;
   public final DeviceOnlineParameter deviceOnline;
   public final RetainDotsParameter retainDots;
+  public final KeyBatchDelayParameter keyBatchDelay;
   public final ComputerBrailleCellSizeParameter computerBrailleCellSize;
   public final LiteraryBrailleParameter literaryBraille;
   public final CursorDotsParameter cursorDots;
@@ -75,6 +76,7 @@ public class Parameters extends ParameterComponent {
     deviceSpeed = new DeviceSpeedParameter(connection);
     deviceOnline = new DeviceOnlineParameter(connection);
     retainDots = new RetainDotsParameter(connection);
+    keyBatchDelay = new KeyBatchDelayParameter(connection);
     computerBrailleCellSize = new ComputerBrailleCellSizeParameter(connection);
     literaryBraille = new LiteraryBrailleParameter(connection);
     cursorDots = new CursorDotsParameter(connection);
@@ -853,6 +853,39 @@ JAVA_INSTANCE_METHOD(
   return (jlong)code;
 }
 
+JAVA_INSTANCE_METHOD(
+  org_a11y_brlapi_ConnectionBase, readKeys, jlongArray,
+  jint max, jint milliseconds
+) {
+  GET_CONNECTION_HANDLE(env, this, NULL);
+
+  if (max < 1) {
+    throwJavaError(env, JAVA_OBJ_ILLEGAL_ARGUMENT_EXCEPTION, "max out of range");
+    return NULL;
+  }
+
+  brlapi_keyCode_t *codes = malloc(max * sizeof(*codes));
+
+  if (!codes) {
+    throwJavaError(env, JAVA_OBJ_OUT_OF_MEMORY_ERROR, __func__);
+    return NULL;
+  }
+
+  ssize_t result = brlapi__readKeys(handle, codes, max, milliseconds);
+  jlongArray keys = NULL;
+
+  if (result < 0) {
+    throwAPIError(env);
+  } else if (!result) {
+    throwJavaError(env, JAVA_OBJ_TIMEOUT_EXCEPTION, __func__);
+  } else if ((keys = (*env)->NewLongArray(env, result))) {
+    (*env)->SetLongArrayRegion(env, keys, 0, result, (const jlong *)codes);
+  }
+
+  free(codes);
+  return keys;
+}
+
 JAVA_INSTANCE_METHOD(
   org_a11y_brlapi_ConnectionBase, ignoreKeys, void,
   jlong jrange, jlongArray js
@@ -742,6 +742,33 @@ cdef class Connection:
 			else:
 				return code
 
+	def readKeys(self, max = 64, timeout_ms = -1):
+		"""Read all the available keys from the braille keyboard.
+		See brlapi_readKeys(3).
+
+		This function works like readKeyWithTimeout, except that it returns the list of all the keys (up to max) which have already been received, or None if the timeout expired."""
+		cdef c_brlapi.brlapi_keyCode_t *c_codes
+		cdef ssize_t retval
+		cdef size_t c_max
+		cdef int c_timeout_ms
+		c_max = max
+		c_timeout_ms = timeout_ms
+		c_codes = <c_brlapi.brlapi_keyCode_t*>c_brlapi.malloc(c_max * sizeof(c_brlapi.brlapi_keyCode_t))
+
+		try:
+			while True:
+				with nogil:
+					retval = c_brlapi.brlapi__readKeys(self.h, c_codes, c_max, c_timeout_ms)
+				if retval == -1 and not (c_brlapi.brlapi_error.brlerrno == ERROR_LIBCERR and c_brlapi.brlapi_error.libcerrno == errno.EINTR):
+					raise OperationError()
+				elif retval <= 0:
+					if timeout_ms >= 0:
+						return None
+				else:
+					return [c_codes[i] for i in range(retval)]
+		finally:
+			c_brlapi.free(c_codes)
+
 	def expandKeyCode(self, code):
 		"""Expand a keycode into its individual components.
 		This is a stub to maintain backward compatibility.
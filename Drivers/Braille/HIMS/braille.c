@@ -230,68 +230,48 @@ struct BrailleDataStruct {
 };
 
 static BraillePacketVerifierResult
-verifyPacket (
+verifyFrame (
   BrailleDisplay *brl,
   unsigned char *bytes, size_t size,
   size_t *length, void *data
 ) {
-  unsigned char byte = bytes[size-1];
-
-  switch (size) {
-    case 1: {
-      switch (byte) {
-        case 0X1C:
-          *length = 4;
-          break;
-
-        case 0XFA:
-          *length = 10;
-          break;
-
-        default:
-          return BRL_PVR_INVALID;
-      }
-
-      break;
-    }
-
-    default:
-      break;
-  }
-
-  if (size == *length) {
-    switch (bytes[0]) {
-      case 0X1C: {
-        if (byte != 0X1F) return BRL_PVR_INVALID;
-        break;
-      }
-
-      case 0XFA: {
-        if (byte != 0XFB) return BRL_PVR_INVALID;
-
-        const InputPacket *packet = (const void *)bytes;
-        int checksum = -packet->data.checksum;
-        for (size_t i=0; i<size; i+=1) checksum += packet->bytes[i];
-
-        if ((checksum & 0XFF) != packet->data.checksum) {
-          logInputProblem("incorrect input checksum", packet->bytes, size);
-          return BRL_PVR_INVALID;
-        }
-
-        break;
-      }
-
-      default:
-        break;
+  if (bytes[0] == 0XFA) {
+    const InputPacket *packet = (const void *)bytes;
+    int checksum = -packet->data.checksum;
+    for (size_t i=0; i<size; i+=1) checksum += packet->bytes[i];
+
+    if ((checksum & 0XFF) != packet->data.checksum) {
+      logInputProblem("incorrect input checksum", packet->bytes, size);
+      return BRL_PVR_INVALID;
     }
   }
 
   return BRL_PVR_INCLUDE;
 }
 
+static const BrailleFrameType frameTypes[] = {
+  { .lead = 0X1C,
+    .size = 4,
+    .trailer = 0X1F,
+    .hasTrailer = 1
+  },
+
+  { .lead = 0XFA,
+    .size = sizeof(InputPacket),
+    .trailer = 0XFB,
+    .hasTrailer = 1
+  },
+};
+
+static const BrailleFrameDescription frameDescription = {
+  .types = frameTypes,
+  .count = ARRAY_COUNT(frameTypes),
+  .verifyFrame = verifyFrame
+};
+
 static size_t
 readPacket (BrailleDisplay *brl, InputPacket *packet) {
-  return readBraillePacket(brl, NULL, packet, sizeof(*packet), verifyPacket, NULL);
+  return readBrailleFrame(brl, NULL, packet, sizeof(*packet), &frameDescription, NULL);
 }
 
 static size_t
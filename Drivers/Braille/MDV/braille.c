@@ -280,9 +280,11 @@ connectResource (BrailleDisplay *brl, const char *identifier) {
 
   descriptor.serial.parameters = &serialParameters;
   descriptor.serial.options.applicationData = &serialOperations;
+  descriptor.serial.options.lowLatency = 1;
 
   descriptor.usb.channelDefinitions = usbChannelDefinitions;
   descriptor.usb.options.applicationData = &usbOperations;
+  descriptor.usb.options.lowLatency = 1;
 
   descriptor.bluetooth.discoverChannel = 1;
 
@@ -39,6 +39,7 @@
 #include "report.h"
 #include "async_handle.h"
 #include "async_io.h"
+#include "async_wait.h"
 #include "device.h"
 #include "io_misc.h"
 #include "timing.h"
@@ -651,6 +652,8 @@ static int screenDescriptor;
 
 static int isMonitorable;
 static THREAD_LOCAL AsyncHandle screenMonitor = NULL;
+static THREAD_LOCAL AsyncHandle updateMonitor = NULL;
+static int updateDetected;
 
 static int screenUpdated;
 
@@ -728,6 +731,11 @@ closeCurrentScreen (void) {
     screenMonitor = NULL;
   }
 
+  if (updateMonitor) {
+    asyncCancelRequest(updateMonitor);
+    updateMonitor = NULL;
+  }
+
   if (screenDescriptor != -1) {
     logMessage(LOG_CATEGORY(SCREEN_DRIVER),
                "closing screen: fd=%d", screenDescriptor);
@@ -754,6 +762,7 @@ setCurrentScreen (unsigned char vt) {
              (isMonitorable? "yes": "no"));
 
   screenMonitor = NULL;
+  updateMonitor = NULL;
   screenUpdated = 1;
   return 1;
 }
@@ -1478,6 +1487,34 @@ poll_LinuxScreen (void) {
   return poll;
 }
 
+ASYNC_MONITOR_CALLBACK(lxUpdateDetected) {
+  updateDetected = 1;
+  return 1;
+}
+
+ASYNC_CONDITION_TESTER(lxTestUpdateDetected) {
+  return updateDetected;
+}
+
+static int
+awaitUpdate_LinuxScreen (int timeout) {
+  /* The alert remains pending until the screen is next read so a change
+   * which happens before we start waiting isn't missed.
+   */
+  if (!isMonitorable) return 0;
+
+  if (!updateMonitor) {
+    if (!asyncMonitorFileAlert(&updateMonitor, screenDescriptor,
+                               lxUpdateDetected, NULL)) {
+      return 0;
+    }
+  }
+
+  updateDetected = 0;
+  asyncAwaitCondition(timeout, lxTestUpdateDetected, NULL);
+  return 1;
+}
+
 static int
 getConsoleState (struct vt_stat *state) {
   if (controlMainConsole(VT_GETSTATE, state) != -1) return 1;
@@ -2469,6 +2506,7 @@ scr_initialize (MainScreen *main) {
 
   main->base.poll = poll_LinuxScreen;
   main->base.refresh = refresh_LinuxScreen;
+  main->base.awaitUpdate = awaitUpdate_LinuxScreen;
   main->base.describe = describe_LinuxScreen;
   main->base.readCharacters = readCharacters_LinuxScreen;
   main->base.insertKey = insertKey_LinuxScreen;
@@ -26,17 +26,22 @@
 #include <stdio.h>
 #include <string.h>
 #include <signal.h>
+#include <fcntl.h>
 #include <sys/wait.h>
 
 #include "log.h"
 #include "parse.h"
+#include "notes.h"
+#include "pcm.h"
 
 typedef enum {
-  PARM_pitch
+  PARM_pitch,
+  PARM_cache
 } DriverParameter;
-#define SPKPARMS "pitch"
+#define SPKPARMS "pitch", "cache"
 
 #include "spk_driver.h"
+#include "spk_cache.h"
 #include <flite.h>
 #include <flite_version.h>
 
@@ -52,10 +57,156 @@ static	int		fds[2];
 static	int		*const readfd	= &fds[0];
 static	int		*const writefd	= &fds[1];
 
+/* The child writes a byte to this pipe whenever it finishes saying a line
+ * so that it's known when it's no longer speaking.
+ */
+static	int		doneFds[2];
+static	int		*const doneReadfd	= &doneFds[0];
+static	int		*const doneWritefd	= &doneFds[1];
+static	size_t		pendingLines	= 0;
+
+/* Short utterances are synthesized in-process (rather than by the child)
+ * so that their audio can be cached and replayed through the sound device.
+ */
+static	SpeechCache	*speechCache	= NULL;
+static	PcmDevice	*pcm		= NULL;
+static	unsigned char	rateSetting	= SPK_RATE_DEFAULT;
+
 static void
 spk_setRate (SpeechSynthesizer *spk, unsigned char setting)
 {
   feat_set_float(voice->features, "duration_stretch", 1.0/getFloatSpeechRate(setting));
+  rateSetting = setting;
+}
+
+static int
+openCache (const char *parameter)
+{
+  int size = 0;
+  static const int minimum = 0;
+
+  if (*parameter) {
+    if (!validateInteger(&size, parameter, &minimum, NULL)) {
+      logMessage(LOG_WARNING, "%s: %s", "invalid cache size", parameter);
+      return 0;
+    }
+  }
+
+  if (!size) return 0;
+
+  if ((pcm = openPcmDevice(LOG_WARNING, opt_pcmDevice, PCM_LATENCY_NORMAL))) {
+    setPcmChannelCount(pcm, 1);
+
+    if (setPcmAmplitudeFormat(pcm, PCM_FMT_S16N) == PCM_FMT_S16N) {
+      if ((speechCache = newSpeechCache(size * 0X400))) {
+        logMessage(LOG_DEBUG, "Festival Lite speech cache size: %dK", size);
+        return 1;
+      }
+    } else {
+      logMessage(LOG_WARNING, "Festival Lite sound device doesn't support 16-bit samples");
+    }
+
+    closePcmDevice(pcm);
+    pcm = NULL;
+  }
+
+  return 0;
+}
+
+static void
+closeCache (void)
+{
+  if (speechCache) {
+    destroySpeechCache(speechCache);
+    speechCache = NULL;
+  }
+
+  if (pcm) {
+    closePcmDevice(pcm);
+    pcm = NULL;
+  }
+}
+
+static int
+playCachedSpeech (const SpeechCacheAudio *audio)
+{
+  if (getPcmSampleRate(pcm) != audio->sampleRate) setPcmSampleRate(pcm, audio->sampleRate);
+  return writePcmData(pcm, (const unsigned char *)audio->samples, audio->count * sizeof(*audio->samples));
+}
+
+static void
+closeChild (void)
+{
+  close(*readfd);
+  close(*writefd);
+  close(*doneReadfd);
+  close(*doneWritefd);
+
+  child = -1;
+  pendingLines = 0;
+}
+
+static int
+isChildSpeaking (void)
+{
+  if (child == -1) return 0;
+
+  if (waitpid(child, NULL, WNOHANG) == child) {
+    /* it only exits on its own if something has gone wrong */
+    closeChild();
+    return 0;
+  }
+
+  {
+    char buffer[0X40];
+    ssize_t count;
+
+    while ((count = read(*doneReadfd, buffer, sizeof(buffer))) > 0) {
+      pendingLines -= MIN(pendingLines, count);
+    }
+  }
+
+  return pendingLines > 0;
+}
+
+static int
+sayCachedSpeech (SpeechSynthesizer *spk, const unsigned char *buffer, size_t length)
+{
+  SpeechCacheKey key = {
+    .text = buffer,
+    .length = length,
+    .voice = voice->name,
+    .rate = rateSetting
+  };
+  SpeechCacheAudio audio;
+  int said;
+
+  if (!isCacheableSpeech(speechCache, length)) return 0;
+
+  /* don't overlap whatever the child might still be saying */
+  if (isChildSpeaking()) return 0;
+
+  if (getCachedSpeech(speechCache, &key, &audio)) {
+    said = playCachedSpeech(&audio);
+  } else {
+    char text[length + 1];
+    cst_wave *wave;
+
+    memcpy(text, buffer, length);
+    text[length] = 0;
+    if (!(wave = flite_text_to_wave(text, voice))) return 0;
+
+    audio.samples = wave->samples;
+    audio.count = wave->num_samples;
+    audio.sampleRate = wave->sample_rate;
+
+    putCachedSpeech(speechCache, &key, &audio);
+    said = playCachedSpeech(&audio);
+    delete_wave(wave);
+  }
+
+  if (said) tellSpeechFinished(spk);
+  return said;
 }
 
 static int
@@ -75,6 +226,8 @@ spk_construct (SpeechSynthesizer *spk, char **parameters)
     feat_set_int(voice->features, "int_f0_target_mean", pitch);
   }
 
+  openCache(parameters[PARM_cache]);
+
   logMessage(LOG_INFO, "Festival Lite Engine: version %s-%s, %s",
 	     FLITE_PROJECT_VERSION, FLITE_PROJECT_STATE,
 	     FLITE_PROJECT_DATE);
@@ -85,6 +238,7 @@ static void
 spk_destruct (SpeechSynthesizer *spk)
 {
   spk_mute(spk);
+  closeCache();
 
   UNREGISTER_VOX(voice);
   voice = NULL;
@@ -100,6 +254,9 @@ doChild (void) {
 
     while ((line = fgets(buffer, sizeof(buffer), stream))) {
       flite_text_to_speech(line, voice, outtype);
+
+      /* a long line is read in pieces - only its end has been counted */
+      if (strchr(line, '\n')) write(*doneWritefd, "", 1);
     }
 
     fclose(stream);
@@ -111,20 +268,41 @@ doChild (void) {
 static void
 spk_say (SpeechSynthesizer *spk, const unsigned char *buffer, size_t length, size_t count, const unsigned char *attributes)
 {
+  if (speechCache) {
+    if (sayCachedSpeech(spk, buffer, length)) return;
+  }
+
   if (child != -1) goto ready;
 
   if (pipe(fds) != -1) {
-    if ((child = fork()) == -1) {
-      logSystemError("fork");
-    } else if (child == 0) {
-      _exit(doChild());
-    } else
-    ready: {
-      unsigned char text[length + 1];
-      memcpy(text, buffer, length);
-      text[length] = '\n';
-      write(*writefd, text, sizeof(text));
-      return;
+    if (pipe(doneFds) != -1) {
+      fcntl(*doneReadfd, F_SETFL, (fcntl(*doneReadfd, F_GETFL) | O_NONBLOCK));
+
+      if ((child = fork()) == -1) {
+        logSystemError("fork");
+      } else if (child == 0) {
+        _exit(doChild());
+      } else
+      ready: {
+        unsigned char text[length + 1];
+        memcpy(text, buffer, length);
+        text[length] = '\n';
+
+        {
+          const unsigned char *byte = text;
+          const unsigned char *end = byte + sizeof(text);
+
+          while (byte < end) if (*byte++ == '\n') pendingLines += 1;
+        }
+
+        write(*writefd, text, sizeof(text));
+        return;
+      }
+
+      close(*doneReadfd);
+      close(*doneWritefd);
+    } else {
+      logSystemError("pipe");
     }
 
     close(*readfd);
@@ -137,12 +315,13 @@ spk_say (SpeechSynthesizer *spk, const unsigned char *buffer, size_t length, siz
 static void
 spk_mute (SpeechSynthesizer *spk)
 {
+  if (pcm) cancelPcmOutput(pcm);
+
   if (child != -1) {
-    close(*readfd);
-    close(*writefd);
+    pid_t pid = child;
+    closeChild();
 
-    kill(child, SIGKILL);
-    waitpid(child, NULL, 0);
-    child = -1;
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
   }
 }
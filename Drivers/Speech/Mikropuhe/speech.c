@@ -87,7 +87,7 @@ static PcmDevice *pcm = NULL;
 static int
 openSoundDevice (void) {
   if (!pcm) {
-    if (!(pcm = openPcmDevice(LOG_WARNING, opt_pcmDevice))) return 0;
+    if (!(pcm = openPcmDevice(LOG_WARNING, opt_pcmDevice, PCM_LATENCY_NORMAL))) return 0;
 
     speechParameters.nChannels = setPcmChannelCount(pcm, 1);
     speechParameters.nSampleFreq = setPcmSampleRate(pcm, 22050);
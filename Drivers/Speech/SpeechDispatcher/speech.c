@@ -20,18 +20,31 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "log.h"
 #include "parse.h"
+#include "parameters.h"
+#include "strfmt.h"
+#include "file.h"
+#include "async_handle.h"
+#include "async_alarm.h"
+#include "async_io.h"
 
 typedef enum {
   PARM_PORT,
   PARM_MODULE,
   PARM_LANGUAGE,
   PARM_VOICE,
-  PARM_NAME
+  PARM_NAME,
+  PARM_ASYNC
 } DriverParameter;
-#define SPKPARMS "port", "module", "language", "voice", "name"
+#define SPKPARMS "port", "module", "language", "voice", "name", "async"
 
 #include "spk_driver.h"
 
@@ -41,22 +54,390 @@ static SPDConnection *connectionHandle = NULL;
 static const char *moduleName;
 static const char *languageName;
 static SPDVoiceType voiceType;
+static const char *voiceTypeName;
 static const char *voiceName;
 static signed int relativeVolume;
 static signed int relativeRate;
 static signed int relativePitch;
 static SPDPunctuation punctuationVerbosity;
+static const char *punctuationName;
 
 static void
 clearSettings (void) {
   moduleName = NULL;
   languageName = NULL;
   voiceType = -1;
+  voiceTypeName = NULL;
   voiceName = NULL;
   relativeVolume = 0;
   relativeRate = 0;
   relativePitch = 0;
   punctuationVerbosity = -1;
+  punctuationName = NULL;
+}
+
+/* In asynchronous mode, SSIP (Speech Synthesis Interface Protocol) is spoken
+ * directly over a nonblocking socket rather than via libspeechd. Setting
+ * changes are deferred so that they can be batched with the next text (or
+ * with each other), replies are only checked for errors (never waited for),
+ * and a lost connection is reestablished in the background.
+ */
+static unsigned int asynchronousMode = 0;
+static int ssipSocket = -1;
+static const char *ssipPort = NULL;
+static AsyncHandle ssipInputHandle = NULL;
+static AsyncHandle ssipSettingsAlarm = NULL;
+static AsyncHandle ssipReconnectAlarm = NULL;
+
+typedef enum {
+  SSIP_SET_CLIENT      = 0X001,
+  SSIP_SET_MODULE      = 0X002,
+  SSIP_SET_LANGUAGE    = 0X004,
+  SSIP_SET_VOICE_TYPE  = 0X008,
+  SSIP_SET_VOICE_NAME  = 0X010,
+  SSIP_SET_VOLUME      = 0X020,
+  SSIP_SET_RATE        = 0X040,
+  SSIP_SET_PITCH       = 0X080,
+  SSIP_SET_PUNCTUATION = 0X100,
+  SSIP_SET_ALL         = 0X1FF
+} SsipSetting;
+
+static SsipSetting ssipPendingSettings = 0;
+
+static size_t
+formatSsipSettings (char *buffer, size_t size) {
+  size_t length;
+
+  STR_BEGIN(buffer, size);
+  SsipSetting settings = ssipPendingSettings;
+
+  if (settings & SSIP_SET_CLIENT) {
+    const char *user = getenv("USER");
+    if (!user) user = "unknown";
+
+    STR_PRINTF("SET self CLIENT_NAME %s:brltty:main\r\n", user);
+    STR_PRINTF("SET self PRIORITY message\r\n");
+  }
+
+  if ((settings & SSIP_SET_MODULE) && moduleName) {
+    STR_PRINTF("SET self OUTPUT_MODULE %s\r\n", moduleName);
+  }
+
+  if ((settings & SSIP_SET_LANGUAGE) && languageName) {
+    STR_PRINTF("SET self LANGUAGE %s\r\n", languageName);
+  }
+
+  if ((settings & SSIP_SET_VOICE_TYPE) && voiceTypeName) {
+    STR_PRINTF("SET self VOICE_TYPE %s\r\n", voiceTypeName);
+  }
+
+  if ((settings & SSIP_SET_VOICE_NAME) && voiceName) {
+    STR_PRINTF("SET self SYNTHESIS_VOICE %s\r\n", voiceName);
+  }
+
+  if (settings & SSIP_SET_VOLUME) {
+    STR_PRINTF("SET self VOLUME %d\r\n", relativeVolume);
+  }
+
+  if (settings & SSIP_SET_RATE) {
+    STR_PRINTF("SET self RATE %d\r\n", relativeRate);
+  }
+
+  if (settings & SSIP_SET_PITCH) {
+    STR_PRINTF("SET self PITCH %d\r\n", relativePitch);
+  }
+
+  if ((settings & SSIP_SET_PUNCTUATION) && punctuationName) {
+    STR_PRINTF("SET self PUNCTUATION %s\r\n", punctuationName);
+  }
+
+  ssipPendingSettings = 0;
+  length = STR_LENGTH;
+  STR_END;
+
+  return length;
+}
+
+static size_t
+formatSsipText (char *buffer, size_t size, const unsigned char *text, size_t length, size_t count) {
+  size_t result;
+
+  STR_BEGIN(buffer, size);
+
+  if (count == 1) {
+    if ((length == 1) && (text[0] == ' ')) {
+      STR_PRINTF("CHAR space\r\n");
+    } else {
+      STR_PRINTF("CHAR %.*s\r\n", (int)length, text);
+    }
+  } else {
+    const unsigned char *end = text + length;
+    int atLineStart = 1;
+
+    STR_PRINTF("SPEAK\r\n");
+
+    /* a line consisting of only a dot ends the data - dots which begin
+     * lines are doubled so that the text can't be mistaken for that
+     */
+    while (text < end) {
+      unsigned char byte = *text++;
+
+      if (byte == '\n') {
+        STR_PRINTF("\r\n");
+        atLineStart = 1;
+        continue;
+      }
+
+      if (byte == '\r') continue;
+      if (atLineStart && (byte == '.')) STR_PRINTF(".");
+      STR_PRINTF("%c", byte);
+      atLineStart = 0;
+    }
+
+    STR_PRINTF("\r\n.\r\n");
+  }
+
+  result = STR_LENGTH;
+  STR_END;
+
+  return result;
+}
+
+static void
+writeSsipData (const char *data, size_t size) {
+  if (size) {
+    if (!asyncWriteFile(NULL, ssipSocket, data, size, NULL, NULL)) {
+      logMessage(LOG_WARNING, "speech dispatcher write failure");
+    }
+  }
+}
+
+static void
+cancelSsipSettingsAlarm (void) {
+  if (ssipSettingsAlarm) {
+    asyncCancelRequest(ssipSettingsAlarm);
+    ssipSettingsAlarm = NULL;
+  }
+}
+
+static void
+flushSsipSettings (void) {
+  cancelSsipSettingsAlarm();
+
+  if (ssipSocket != -1) {
+    char buffer[0X400];
+    writeSsipData(buffer, formatSsipSettings(buffer, sizeof(buffer)));
+  }
+}
+
+ASYNC_ALARM_CALLBACK(handleSsipSettingsAlarm) {
+  asyncDiscardHandle(ssipSettingsAlarm);
+  ssipSettingsAlarm = NULL;
+
+  flushSsipSettings();
+}
+
+static void
+changeSsipSetting (SsipSetting setting) {
+  ssipPendingSettings |= setting;
+
+  if (!ssipSettingsAlarm) {
+    asyncNewRelativeAlarm(&ssipSettingsAlarm, SPEECH_DISPATCHER_SETTINGS_DELAY,
+                          handleSsipSettingsAlarm, NULL);
+  }
+}
+
+static void scheduleSsipReconnect (void);
+
+static void
+closeSsipConnection (void) {
+  cancelSsipSettingsAlarm();
+
+  if (ssipInputHandle) {
+    asyncCancelRequest(ssipInputHandle);
+    ssipInputHandle = NULL;
+  }
+
+  if (ssipSocket != -1) {
+    close(ssipSocket);
+    ssipSocket = -1;
+  }
+}
+
+static void
+checkSsipReply (const char *line, size_t length) {
+  /* replies in the 3xx, 4xx, and 5xx ranges are errors */
+  if ((length >= 3) && (line[0] >= '3')) {
+    logMessage(LOG_WARNING, "speech dispatcher error: %.*s", (int)length, line);
+  }
+}
+
+ASYNC_INPUT_CALLBACK(handleSsipInput) {
+  if (parameters->error) {
+    logMessage(LOG_WARNING, "speech dispatcher input error: %s", strerror(parameters->error));
+  } else if (parameters->end) {
+    logMessage(LOG_WARNING, "speech dispatcher end-of-file");
+  } else {
+    const char *buffer = parameters->buffer;
+    size_t length = parameters->length;
+    size_t count = 0;
+
+    while (count < length) {
+      const char *line = &buffer[count];
+      const char *end = memchr(line, '\n', length - count);
+      if (!end) break;
+
+      {
+        size_t size = end - line;
+        if (size && (line[size-1] == '\r')) size -= 1;
+        checkSsipReply(line, size);
+      }
+
+      count = end - buffer + 1;
+    }
+
+    if (!count && (length == parameters->size)) count = length;
+    return count;
+  }
+
+  /* the input operation has already finished */
+  asyncDiscardHandle(ssipInputHandle);
+  ssipInputHandle = NULL;
+
+  closeSsipConnection();
+  scheduleSsipReconnect();
+  return 0;
+}
+
+static int
+connectSsipSocket (void) {
+  int socketDescriptor;
+
+  if (ssipPort) {
+    struct sockaddr_in address;
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(atoi(ssipPort));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if ((socketDescriptor = socket(PF_INET, SOCK_STREAM, 0)) != -1) {
+      if (connect(socketDescriptor, (struct sockaddr *)&address, sizeof(address)) != -1) {
+        return socketDescriptor;
+      }
+
+      logMessage(LOG_WARNING, "speech dispatcher connect error: port %s: %s", ssipPort, strerror(errno));
+      close(socketDescriptor);
+    } else {
+      logSystemError("socket");
+    }
+  } else {
+    const char *directory = getenv("XDG_RUNTIME_DIR");
+    char *path;
+
+    if (directory) {
+      path = makePath(directory, "speech-dispatcher/speechd.sock");
+    } else {
+      const char *home = getenv("HOME");
+      path = makePath(home? home: ".", ".cache/speech-dispatcher/speechd.sock");
+    }
+
+    if (path) {
+      struct sockaddr_un address;
+
+      memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      strncpy(address.sun_path, path, sizeof(address.sun_path)-1);
+
+      if ((socketDescriptor = socket(PF_UNIX, SOCK_STREAM, 0)) != -1) {
+        if (connect(socketDescriptor, (struct sockaddr *)&address, sizeof(address)) != -1) {
+          free(path);
+          return socketDescriptor;
+        }
+
+        logMessage(LOG_WARNING, "speech dispatcher connect error: %s: %s", path, strerror(errno));
+        close(socketDescriptor);
+      } else {
+        logSystemError("socket");
+      }
+
+      free(path);
+    }
+  }
+
+  return -1;
+}
+
+static int
+openSsipConnection (void) {
+  if ((ssipSocket = connectSsipSocket()) != -1) {
+    if (fcntl(ssipSocket, F_SETFL, O_NONBLOCK) != -1) {
+      if (asyncReadFile(&ssipInputHandle, ssipSocket, 0X200, handleSsipInput, NULL)) {
+        logMessage(LOG_DEBUG, "speech dispatcher connected");
+        ssipPendingSettings = SSIP_SET_ALL;
+        flushSsipSettings();
+        return 1;
+      }
+    } else {
+      logSystemError("fcntl[F_SETFL,O_NONBLOCK]");
+    }
+
+    close(ssipSocket);
+    ssipSocket = -1;
+  }
+
+  return 0;
+}
+
+ASYNC_ALARM_CALLBACK(handleSsipReconnectAlarm) {
+  asyncDiscardHandle(ssipReconnectAlarm);
+  ssipReconnectAlarm = NULL;
+
+  if (!openSsipConnection()) scheduleSsipReconnect();
+}
+
+static void
+scheduleSsipReconnect (void) {
+  if (!ssipReconnectAlarm) {
+    asyncNewRelativeAlarm(&ssipReconnectAlarm, SPEECH_DISPATCHER_RECONNECT_INTERVAL,
+                          handleSsipReconnectAlarm, NULL);
+  }
+}
+
+static void
+stopSsip (void) {
+  closeSsipConnection();
+
+  if (ssipReconnectAlarm) {
+    asyncCancelRequest(ssipReconnectAlarm);
+    ssipReconnectAlarm = NULL;
+  }
+}
+
+static void
+saySsipText (const unsigned char *text, size_t length, size_t count) {
+  if (ssipSocket == -1) {
+    logMessage(LOG_DEBUG, "speech dispatcher not connected");
+    return;
+  }
+
+  cancelSsipSettingsAlarm();
+
+  {
+    char buffer[0X400 + (length * 2)];
+    size_t size = formatSsipSettings(buffer, sizeof(buffer));
+
+    size += formatSsipText(&buffer[size], sizeof(buffer)-size, text, length, count);
+    writeSsipData(buffer, size);
+  }
+}
+
+static void
+muteSsip (void) {
+  if (ssipSocket != -1) {
+    static const char command[] = "CANCEL self\r\n";
+    writeSsipData(command, sizeof(command)-1);
+  }
 }
 
 static void
@@ -105,7 +486,12 @@ setVolume (const void *data) {
 static void
 spk_setVolume (SpeechSynthesizer *spk, unsigned char setting) {
   relativeVolume = getIntegerSpeechVolume(setting, 100) - 100;
-  speechdAction(setVolume, NULL);
+  if (asynchronousMode) {
+    changeSsipSetting(SSIP_SET_VOLUME);
+  } else {
+    speechdAction(setVolume, NULL);
+  }
+
   logMessage(LOG_DEBUG, "set volume: %u -> %d", setting, relativeVolume);
 }
 
@@ -117,7 +503,12 @@ setRate (const void *data) {
 static void
 spk_setRate (SpeechSynthesizer *spk, unsigned char setting) {
   relativeRate = getIntegerSpeechRate(setting, 100) - 100;
-  speechdAction(setRate, NULL);
+  if (asynchronousMode) {
+    changeSsipSetting(SSIP_SET_RATE);
+  } else {
+    speechdAction(setRate, NULL);
+  }
+
   logMessage(LOG_DEBUG, "set rate: %u -> %d", setting, relativeRate);
 }
 
@@ -129,7 +520,12 @@ setPitch (const void *data) {
 static void
 spk_setPitch (SpeechSynthesizer *spk, unsigned char setting) {
   relativePitch = getIntegerSpeechPitch(setting, 100) - 100;
-  speechdAction(setPitch, NULL);
+  if (asynchronousMode) {
+    changeSsipSetting(SSIP_SET_PITCH);
+  } else {
+    speechdAction(setPitch, NULL);
+  }
+
   logMessage(LOG_DEBUG, "set pitch: %u -> %d", setting, relativePitch);
 }
 
@@ -143,7 +539,15 @@ spk_setPunctuation (SpeechSynthesizer *spk, SpeechPunctuation setting) {
   punctuationVerbosity = (setting <= SPK_PUNCTUATION_NONE)? SPD_PUNCT_NONE: 
                          (setting >= SPK_PUNCTUATION_ALL)? SPD_PUNCT_ALL: 
                          SPD_PUNCT_SOME;
-  speechdAction(setPunctuation, NULL);
+  punctuationName = (setting <= SPK_PUNCTUATION_NONE)? "none":
+                    (setting >= SPK_PUNCTUATION_ALL)? "all":
+                    "some";
+  if (asynchronousMode) {
+    changeSsipSetting(SSIP_SET_PUNCTUATION);
+  } else {
+    speechdAction(setPunctuation, NULL);
+  }
+
   logMessage(LOG_DEBUG, "set punctuation: %u -> %d", setting, punctuationVerbosity);
 }
 
@@ -229,8 +633,16 @@ spk_construct (SpeechSynthesizer *spk, char **parameters) {
 
     unsigned int choice = 0;
 
+    static const char *const names[] = {
+      "MALE1", "FEMALE1",
+      "MALE2", "FEMALE2",
+      "MALE3", "FEMALE3",
+      "CHILD_MALE", "CHILD_FEMALE"
+    };
+
     if (validateChoice(&choice, parameters[PARM_VOICE], choices)) {
       voiceType = voices[choice];
+      voiceTypeName = names[choice];
     } else {
       logMessage(LOG_WARNING, "%s: %s", "invalid voice type", parameters[PARM_VOICE]);
     }
@@ -240,12 +652,30 @@ spk_construct (SpeechSynthesizer *spk, char **parameters) {
     voiceName = parameters[PARM_NAME];
   }
 
+  asynchronousMode = 0;
+  if (parameters[PARM_ASYNC] && *parameters[PARM_ASYNC]) {
+    if (!validateYesNo(&asynchronousMode, parameters[PARM_ASYNC])) {
+      logMessage(LOG_WARNING, "%s: %s", "invalid asynchronous setting", parameters[PARM_ASYNC]);
+    }
+  }
+
+  if (asynchronousMode) {
+    ssipPort = (parameters[PARM_PORT] && *parameters[PARM_PORT])? parameters[PARM_PORT]: NULL;
+    if (!openSsipConnection()) scheduleSsipReconnect();
+    return 1;
+  }
+
   return openConnection();
 }
 
 static void
 spk_destruct (SpeechSynthesizer *spk) {
-  closeConnection();
+  if (asynchronousMode) {
+    stopSsip();
+  } else {
+    closeConnection();
+  }
+
   clearSettings();
 }
 
@@ -272,6 +702,11 @@ sayText (const void *data) {
 
 static void
 spk_say (SpeechSynthesizer *spk, const unsigned char *text, size_t length, size_t count, const unsigned char *attributes) {
+  if (asynchronousMode) {
+    saySsipText(text, length, count);
+    return;
+  }
+
   const SayData say = {
     .text = text,
     .length = length,
@@ -289,5 +724,9 @@ spk_say (SpeechSynthesizer *spk, const unsigned char *text, size_t length, size_
 
 static void
 spk_mute (SpeechSynthesizer *spk) {
-  speechdAction(cancelSpeech, NULL);
+  if (asynchronousMode) {
+    muteSsip();
+  } else {
+    speechdAction(cancelSpeech, NULL);
+  }
 }
@@ -24,26 +24,159 @@
 
 #include "log.h"
 #include "parse.h"
+#include "thread.h"
+#include "notes.h"
+#include "pcm.h"
 
 typedef enum {
 	PARM_PATH,
 	PARM_PUNCTLIST,
 	PARM_VOICE,
-	PARM_MAXRATE
+	PARM_MAXRATE,
+	PARM_CACHE
 } DriverParameter;
-#define SPKPARMS "path", "punctlist", "voice", "maxrate"
+#define SPKPARMS "path", "punctlist", "voice", "maxrate", "cache"
 
 #include "spk_driver.h"
+#include "spk_cache.h"
 
 #include <espeak-ng/speak_lib.h>
 
 static int maxrate = espeakRATE_MAXIMUM;
 
+/* When the cache is enabled, the audio is retrieved from the engine (rather
+ * than played by it) so that short utterances can be kept and replayed
+ * without being synthesized again.
+ */
+static SpeechCache *speechCache = NULL;
+static PcmDevice *pcm = NULL;
+static CriticalSectionLock cacheLock = CRITICAL_SECTION_LOCK_INITIALIZER;
+
+static const char *voiceName = NULL;
+static unsigned char volumeSetting = SPK_VOLUME_DEFAULT;
+static unsigned char rateSetting = SPK_RATE_DEFAULT;
+static unsigned char pitchSetting = SPK_PITCH_DEFAULT;
+static unsigned char punctuationSetting = SPK_PUNCTUATION_SOME;
+
+static struct {
+	unsigned active:1;
+	unsigned cancelled:1;
+	SpeechCacheKey key;
+	unsigned char *text;
+	int16_t *samples;
+	size_t count;
+	size_t size;
+} capture;
+
+static void
+makeCacheKey(SpeechCacheKey *key, const unsigned char *text, size_t length)
+{
+	key->text = text;
+	key->length = length;
+	key->voice = voiceName;
+	key->volume = volumeSetting;
+	key->rate = rateSetting;
+	key->pitch = pitchSetting;
+	key->punctuation = punctuationSetting;
+}
+
+static void
+startCapture(const unsigned char *text, size_t length)
+{
+	unsigned char *copy = malloc(length);
+
+	if (!copy) {
+		logMallocError();
+		return;
+	}
+
+	memcpy(copy, text, length);
+	if (capture.text) free(capture.text);
+	capture.text = copy;
+	makeCacheKey(&capture.key, capture.text, length);
+	capture.count = 0;
+	capture.active = 1;
+}
+
+static void
+appendCapture(const short *audio, int numsamples)
+{
+	size_t count = capture.count + numsamples;
+
+	if (count > capture.size) {
+		size_t size = count | 0XFFF;
+		int16_t *samples = realloc(capture.samples, size * sizeof(*samples));
+
+		if (!samples) {
+			logMallocError();
+			capture.active = 0;
+			return;
+		}
+
+		capture.samples = samples;
+		capture.size = size;
+	}
+
+	memcpy(&capture.samples[capture.count], audio, numsamples * sizeof(*audio));
+	capture.count = count;
+}
+
+static void
+finishCapture(void)
+{
+	if (capture.active) {
+		SpeechCacheAudio audio = {
+			.samples = capture.samples,
+			.count = capture.count,
+			.sampleRate = getPcmSampleRate(pcm)
+		};
+
+		putCachedSpeech(speechCache, &capture.key, &audio);
+		capture.active = 0;
+	}
+}
+
+static int
+sayCachedSpeech(SpeechSynthesizer *spk, const unsigned char *text, size_t length)
+{
+	int said = 0;
+
+	if (!isCacheableSpeech(speechCache, length)) return 0;
+	if (espeak_IsPlaying()) return 0;
+
+	enterCriticalSection(&cacheLock);
+	{
+		SpeechCacheKey key;
+		SpeechCacheAudio audio;
+
+		makeCacheKey(&key, text, length);
+
+		if (getCachedSpeech(speechCache, &key, &audio)) {
+			said = writePcmData(pcm, (const unsigned char *)audio.samples,
+					audio.count * sizeof(*audio.samples));
+		} else {
+			startCapture(text, length);
+		}
+	}
+	leaveCriticalSection(&cacheLock);
+
+	if (said) tellSpeechFinished(spk);
+	return said;
+}
+
 static void
 spk_say(SpeechSynthesizer *spk, const unsigned char *buffer, size_t length, size_t count, const unsigned char *attributes)
 {
 	int result;
 
+	if (speechCache) {
+		enterCriticalSection(&cacheLock);
+		capture.cancelled = 0;
+		leaveCriticalSection(&cacheLock);
+
+		if (sayCachedSpeech(spk, buffer, length)) return;
+	}
+
 	/* add 1 to the length in order to pass along the trailing zero */
 	result = espeak_Synth(buffer, length+1, 0, POS_CHARACTER, 0,
 			espeakCHARS_UTF8, NULL, (void *)spk);
@@ -54,18 +187,45 @@ spk_say(SpeechSynthesizer *spk, const unsigned char *buffer, size_t length, size
 static void
 spk_mute(SpeechSynthesizer *spk)
 {
+	if (pcm) {
+		enterCriticalSection(&cacheLock);
+		capture.cancelled = 1;
+		capture.active = 0;
+		leaveCriticalSection(&cacheLock);
+	}
+
 	espeak_Cancel();
+	if (pcm) cancelPcmOutput(pcm);
 }
 
 static int SynthCallback(short *audio, int numsamples, espeak_EVENT *events)
 {
 	SpeechSynthesizer *spk = events->user_data;
 
+	if (pcm && audio && (numsamples > 0)) {
+		int cancelled;
+
+		enterCriticalSection(&cacheLock);
+		cancelled = capture.cancelled;
+		if (!cancelled && capture.active) appendCapture(audio, numsamples);
+		leaveCriticalSection(&cacheLock);
+
+		if (cancelled) return 1;
+		writePcmData(pcm, (const unsigned char *)audio, numsamples * sizeof(*audio));
+	}
+
 	while (events->type != espeakEVENT_LIST_TERMINATED) {
 		if (events->type == espeakEVENT_WORD)
 			tellSpeechLocation(spk, events->text_position - 1);
-		if (events->type == espeakEVENT_MSG_TERMINATED)
+		if (events->type == espeakEVENT_MSG_TERMINATED) {
+			if (pcm) {
+				enterCriticalSection(&cacheLock);
+				finishCapture();
+				leaveCriticalSection(&cacheLock);
+			}
+
 			tellSpeechFinished(spk);
+		}
 		events++;
 	}
 	return 0;
@@ -82,6 +242,7 @@ spk_setVolume(SpeechSynthesizer *spk, unsigned char setting)
 {
 	int volume = getIntegerSpeechVolume(setting, 50);
 	espeak_SetParameter(espeakVOLUME, volume, 0);
+	volumeSetting = setting;
 }
 
 static void
@@ -90,6 +251,7 @@ spk_setRate(SpeechSynthesizer *spk, unsigned char setting)
 	int h_range = (maxrate - espeakRATE_MINIMUM)/2;
 	int rate = getIntegerSpeechRate(setting, h_range) + espeakRATE_MINIMUM;
 	espeak_SetParameter(espeakRATE, rate, 0);
+	rateSetting = setting;
 }
 
 static void
@@ -97,6 +259,7 @@ spk_setPitch(SpeechSynthesizer *spk, unsigned char setting)
 {
 	int pitch = getIntegerSpeechPitch(setting, 50);
 	espeak_SetParameter(espeakPITCH, pitch, 0);
+	pitchSetting = setting;
 }
 
 static void
@@ -110,12 +273,62 @@ spk_setPunctuation(SpeechSynthesizer *spk, SpeechPunctuation setting)
 	else
 		punct = espeakPUNCT_SOME;
 	espeak_SetParameter(espeakPUNCTUATION, punct, 0);
+	punctuationSetting = setting;
+}
+
+static int openCache(const char *parameter)
+{
+	int size = 0;
+	static const int minimum = 0;
+
+	if (parameter && *parameter) {
+		if (!validateInteger(&size, parameter, &minimum, NULL)) {
+			logMessage(LOG_WARNING, "%s: %s", "invalid cache size", parameter);
+			return 0;
+		}
+	}
+
+	if (!size) return 0;
+
+	if (!(pcm = openPcmDevice(LOG_WARNING, opt_pcmDevice, PCM_LATENCY_NORMAL))) return 0;
+	setPcmChannelCount(pcm, 1);
+
+	if (setPcmAmplitudeFormat(pcm, PCM_FMT_S16N) == PCM_FMT_S16N) {
+		if ((speechCache = newSpeechCache(size * 0X400))) {
+			logMessage(LOG_DEBUG, "eSpeak-NG: speech cache size: %dK", size);
+			return 1;
+		}
+	} else {
+		logMessage(LOG_WARNING, "eSpeak-NG: sound device doesn't support 16-bit samples");
+	}
+
+	closePcmDevice(pcm);
+	pcm = NULL;
+	return 0;
+}
+
+static void closeCache(void)
+{
+	if (speechCache) {
+		destroySpeechCache(speechCache);
+		speechCache = NULL;
+	}
+
+	if (pcm) {
+		closePcmDevice(pcm);
+		pcm = NULL;
+	}
+
+	if (capture.text) free(capture.text);
+	if (capture.samples) free(capture.samples);
+	memset(&capture, 0, sizeof(capture));
 }
 
 static int spk_construct(SpeechSynthesizer *spk, char **parameters)
 {
 	const char *data_path, *voicename, *punctlist;
 	int result;
+	int output = AUDIO_OUTPUT_PLAYBACK;
 
 	spk->setVolume = spk_setVolume;
 	spk->setRate = spk_setRate;
@@ -128,11 +341,14 @@ static int spk_construct(SpeechSynthesizer *spk, char **parameters)
 	data_path = parameters[PARM_PATH];
 	if (data_path && !*data_path)
 		data_path = NULL;
-	result = espeak_Initialize(AUDIO_OUTPUT_PLAYBACK, 0, data_path, 0);
+	if (openCache(parameters[PARM_CACHE])) output = AUDIO_OUTPUT_RETRIEVAL;
+	result = espeak_Initialize(output, 0, data_path, 0);
 	if (result < 0) {
 		logMessage(LOG_ERR, "eSpeak-NG: initialization failed");
+		closeCache();
 		return 0;
 	}
+	if (pcm) setPcmSampleRate(pcm, result);
 
 	voicename = parameters[PARM_VOICE];
 	if(!voicename || !*voicename)
@@ -146,8 +362,10 @@ static int spk_construct(SpeechSynthesizer *spk, char **parameters)
 	}
 	if (result != EE_OK) {
 		logMessage(LOG_ERR, "eSpeak-NG: unable to load voice '%s'", voicename);
+		closeCache();
 		return 0;
 	}
+	voiceName = voicename;
 
 	punctlist = parameters[PARM_PUNCTLIST];
 	if (punctlist && *punctlist) {
@@ -171,4 +389,5 @@ static void spk_destruct(SpeechSynthesizer *spk)
 {
 	espeak_Cancel();
 	espeak_Terminate();
+	closeCache();
 }
@@ -114,6 +114,29 @@ extern size_t readBraillePacket (
   BraillePacketVerifier *verifyPacket, void *data
 );
 
+typedef struct {
+  unsigned char lead;         /* the first byte of the frame */
+  unsigned char size;         /* the size of the frame (excluding any variable part) */
+  unsigned char lengthOffset; /* where the size of the variable part is (0 if none) */
+  unsigned char trailer;      /* the last byte of the frame (if hasTrailer is set) */
+  unsigned char hasTrailer:1;
+} BrailleFrameType;
+
+typedef struct {
+  const BrailleFrameType *types;
+  unsigned char count;
+
+  const BrailleFrameType *defaultType; /* for leads not listed (NULL if they're invalid) */
+  BraillePacketVerifier *verifyFrame;  /* optional check of each complete frame */
+} BrailleFrameDescription;
+
+extern size_t readBrailleFrame (
+  BrailleDisplay *brl,
+  GioEndpoint *endpoint,
+  void *packet, size_t size,
+  const BrailleFrameDescription *frame, void *data
+);
+
 extern int writeBraillePacket (
   BrailleDisplay *brl, GioEndpoint *endpoint,
   const void *packet, size_t size
@@ -26,6 +26,8 @@ extern "C" {
 #endif /* __cplusplus */
 
 extern void drainBrailleOutput (BrailleDisplay *brl, int minimumDelay);
+extern void beginBrailleOutput (BrailleDisplay *brl);
+extern int endBrailleOutput (BrailleDisplay *brl);
 
 extern void announceBrailleOffline (void);
 extern void announceBrailleOnline (void);
@@ -63,6 +63,7 @@ typedef struct {
   int outputTimeout;
   int requestTimeout;
   unsigned ignoreWriteTimeouts:1;
+  unsigned lowLatency:1;
 } GioOptions;
 
 typedef struct {
@@ -104,6 +105,7 @@ typedef enum {
   GIO_TYPE_BLUETOOTH,
   GIO_TYPE_HID,
   GIO_TYPE_NULL,
+  GIO_TYPE_REPLAY,
 } GioTypeIdentifier;
 
 typedef struct {
@@ -0,0 +1,160 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2022 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#ifndef BRLTTY_INCLUDED_HID_REPORTS
+#define BRLTTY_INCLUDED_HID_REPORTS
+
+#include "hid_types.h"
+#include "bitmask.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+typedef enum {
+  HID_RPT_Input,
+  HID_RPT_Output,
+  HID_RPT_Feature,
+  HID_RPT_COUNT /* must be last */
+} HidReportType;
+
+#define HID_USAGE(page,usage) (((HidUnsignedValue)(page) << 0X10) | (usage))
+#define HID_USAGE_PAGE(usage) ((usage) >> 0X10)
+#define HID_USAGE_IDENTIFIER(usage) ((usage) & UINT16_MAX)
+
+/* A variable field has one element (count is 1) and one usage. An array
+ * field has count elements, each of which is an index into its usage range.
+ * The bit offset is relative to the start of the report as it's read, i.e.
+ * it includes the leading report identifier byte (if there is one).
+ */
+typedef struct {
+  HidUnsignedValue usageMinimum;
+  HidUnsignedValue usageMaximum;
+  HidSignedValue logicalMinimum;
+  HidSignedValue logicalMaximum;
+
+  uint32_t bitOffset;
+  uint16_t count;
+  uint16_t flags;
+  uint8_t bitSize;
+} HidReportField;
+
+typedef struct {
+  uint32_t bitCount;
+  uint16_t firstField;
+  uint16_t fieldCount;
+  HidReportIdentifier identifier;
+  uint8_t type;
+} HidReportLayout;
+
+typedef struct {
+  const HidReportLayout *reports;
+  const HidReportField *fields;
+  unsigned int reportCount;
+  unsigned int fieldCount;
+
+  /* index+1 into reports (0 means undefined) */
+  uint16_t reportIndex[HID_RPT_COUNT][UINT8_MAX+1];
+  BITMASK(definedIdentifiers, UINT8_MAX+1, char);
+  unsigned char hasIdentifiers:1;
+} HidReportTable;
+
+/* The table (including its reports and fields) is a single allocation
+ * which is released via free().
+ */
+extern HidReportTable *hidCompileReports (const HidItemsDescriptor *items);
+
+extern int hidGetCompiledReportSize (
+  const HidReportTable *table,
+  HidReportIdentifier identifier,
+  HidReportSize *size
+);
+
+static inline const HidReportLayout *
+hidGetReportLayout (const HidReportTable *table, HidReportType type, HidReportIdentifier identifier) {
+  uint16_t index = table->reportIndex[type][identifier];
+  return index? &table->reports[index-1]: NULL;
+}
+
+static inline const HidReportField *
+hidGetReportFields (const HidReportTable *table, const HidReportLayout *report) {
+  return &table->fields[report->firstField];
+}
+
+/* The size (in bits) of a field is at most HID_FIELD_SIZE_MAXIMUM - larger
+ * fields are left out of the table when it's compiled. A value can only be
+ * extracted if it lies entirely within the size (in bytes) of the report
+ * that was actually received.
+ */
+#define HID_FIELD_SIZE_MAXIMUM 0X20
+
+static inline int
+hidGetReportBits (
+  const unsigned char *report, size_t size,
+  uint32_t bitOffset, uint8_t bitSize, HidUnsignedValue *value
+) {
+  if (bitSize > HID_FIELD_SIZE_MAXIMUM) return 0;
+  if (((uint64_t)bitOffset + bitSize) > ((uint64_t)size * 8)) return 0;
+
+  const unsigned char *byte = report + (bitOffset >> 3);
+  unsigned char shift = bitOffset & 7;
+  unsigned char count = (shift + bitSize + 7) >> 3;
+  uint64_t bits = 0;
+
+  for (unsigned char index=0; index<count; index+=1) {
+    bits |= (uint64_t)byte[index] << (index * 8);
+  }
+
+  bits >>= shift;
+  if (bitSize < 0X20) bits &= (UINT64_C(1) << bitSize) - 1;
+
+  *value = bits;
+  return 1;
+}
+
+static inline int
+hidGetFieldValue (
+  const HidReportField *field, const unsigned char *report, size_t size,
+  unsigned int element, HidSignedValue *value
+) {
+  if (element >= field->count) return 0;
+  HidUnsignedValue bits;
+
+  if (!hidGetReportBits(report, size,
+                        field->bitOffset + (element * field->bitSize),
+                        field->bitSize, &bits)) {
+    return 0;
+  }
+
+  if ((field->logicalMinimum < 0) && (field->bitSize < 0X20)) {
+    HidUnsignedValue sign = UINT32_C(1) << (field->bitSize - 1);
+    if (bits & sign) bits |= ~((sign << 1) - 1);
+  }
+
+  *value = bits;
+  return 1;
+}
+
+typedef int HidReportLister (const char *line, void *data);
+extern int hidListReportTable (const HidReportTable *table, HidReportLister *listLine, void *data);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BRLTTY_INCLUDED_HID_REPORTS */
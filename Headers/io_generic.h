@@ -21,6 +21,7 @@
 
 #include "gio_types.h"
 #include "async_types_io.h"
+#include "hid_reports.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -28,6 +29,9 @@ extern "C" {
 
 extern const GioPublicProperties *gioGetPublicProperties (const char **identifier);
 
+extern int gioStartCapture (const char *path);
+extern void gioStopCapture (void);
+
 extern void gioInitializeDescriptor (GioDescriptor *descriptor);
 extern void gioInitializeSerialParameters (SerialParameters *parameters);
 
@@ -47,6 +51,9 @@ extern GioTypeIdentifier gioGetResourceType (GioEndpoint *endpoint);
 extern void *gioGetResourceObject (GioEndpoint *endpoint);
 
 extern ssize_t gioWriteData (GioEndpoint *endpoint, const void *data, size_t size);
+extern void gioBeginOutput (GioEndpoint *endpoint);
+extern int gioFlushOutput (GioEndpoint *endpoint);
+extern int gioEndOutput (GioEndpoint *endpoint);
 extern int gioAwaitInput (GioEndpoint *endpoint, int timeout);
 extern ssize_t gioReadData (GioEndpoint *endpoint, void *buffer, size_t size, int wait);
 extern int gioReadByte (GioEndpoint *endpoint, unsigned char *byte, int wait);
@@ -82,6 +89,10 @@ extern int gioGetHidReportSize (
   HidReportSize *size
 );
 
+extern const HidReportTable *gioGetHidReportTable (
+  GioEndpoint *endpoint
+);
+
 extern size_t gioGetHidInputSize (
   GioEndpoint *endpoint,
   HidReportIdentifier identifier
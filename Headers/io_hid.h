@@ -20,6 +20,7 @@
 #define BRLTTY_INCLUDED_IO_HID
 
 #include "hid_types.h"
+#include "hid_reports.h"
 #include "async_types_io.h"
 
 #ifdef __cplusplus
@@ -51,6 +52,7 @@ extern int hidOpenDeviceWithParameters (
 extern void hidCloseDevice (HidDevice *device);
 
 extern const HidItemsDescriptor *hidGetItems (HidDevice *device);
+extern const HidReportTable *hidGetReportTable (HidDevice *device);
 
 extern int hidGetReportSize (
   HidDevice *device,
@@ -81,6 +81,9 @@ extern int serialSetStopBits (SerialDevice *serial, SerialStopBits bits);
 extern int serialSetParity (SerialDevice *serial, SerialParity parity);
 extern int serialSetFlowControl (SerialDevice *serial, SerialFlowControl flow);
 
+extern int serialSetLowLatency (SerialDevice *serial, int enabled);
+extern int serialGetLowLatency (SerialDevice *serial);
+
 extern unsigned int serialGetCharacterSize (const SerialParameters *parameters);
 extern unsigned int serialGetCharacterBits (SerialDevice *serial);
 
@@ -228,6 +228,7 @@ extern int usbAddInputFilter (UsbDevice *device, UsbInputFilter *filter);
 
 extern const UsbSerialOperations *usbGetSerialOperations (UsbDevice *device);
 extern int usbSetSerialParameters (UsbDevice *device, const SerialParameters *parameters);
+extern int usbSetSerialLowLatency (UsbDevice *device, int enabled);
 
 typedef struct {
   const UsbChannelDefinition *definition;
@@ -239,6 +240,20 @@ extern void usbCloseChannel (UsbChannel *channel);
 extern const char *usbMakeChannelIdentifier (UsbChannel *channel, char *buffer, size_t size);
 
 extern const char *const *usbGetDriverCodes (uint16_t vendor, uint16_t product);
+extern const char **usbGetAttachedDriverCodes (void);
+
+typedef struct {
+  const char *const *driverCodes;
+  uint16_t vendor;
+  uint16_t product;
+  unsigned arrived:1;
+  unsigned opened:1;
+  void *data;
+} UsbHotplugParameters;
+
+#define USB_HOTPLUG_HANDLER(name) void name (const UsbHotplugParameters *parameters)
+typedef USB_HOTPLUG_HANDLER(UsbHotplugHandler);
+extern void usbSetHotplugHandler (UsbHotplugHandler *handler, void *data);
 
 #define USB_DEVICE_QUALIFIER "usb"
 extern int isUsbDeviceIdentifier (const char **identifier);
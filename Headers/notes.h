@@ -20,6 +20,7 @@
 #define BRLTTY_INCLUDED_NOTES
 
 #include "note_types.h"
+#include "tune.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,10 +48,19 @@ typedef struct {
   NoteDevice * (*construct) (int errorLevel);
   void (*destruct) (NoteDevice *device);
 
+  /* optional - keep the device open rather than closing it when idle */
+  int (*isPersistent) (void);
+
   int (*tone) (NoteDevice *device, unsigned int duration, NoteFrequency frequency);
   int (*note) (NoteDevice *device, unsigned int duration, unsigned char note);
 
+  /* optional - plays (and flushes) a whole tune */
+  int (*tones) (NoteDevice *device, const ToneElement *tune);
+
   int (*flush) (NoteDevice *device);
+
+  /* optional - milliseconds until what's written now is heard (-1 if unknown) */
+  int (*getDelay) (NoteDevice *device);
 } NoteMethods;
 
 extern const NoteMethods beepNoteMethods;
@@ -59,6 +69,7 @@ extern const NoteMethods midiNoteMethods;
 extern const NoteMethods fmNoteMethods;
 
 extern char *opt_pcmDevice;
+extern int opt_pcmLowLatency;
 extern char *opt_midiDevice;
 
 #ifdef __cplusplus
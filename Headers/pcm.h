@@ -61,7 +61,12 @@ extern PcmSampleMaker getPcmSampleMaker (PcmAmplitudeFormat format);
 
 typedef struct PcmDeviceStruct PcmDevice;
 
-extern PcmDevice *openPcmDevice (int errorLevel, const char *device);
+typedef enum {
+  PCM_LATENCY_NORMAL,
+  PCM_LATENCY_LOW // small periods, kept primed with silence
+} PcmLatency;
+
+extern PcmDevice *openPcmDevice (int errorLevel, const char *device, PcmLatency latency);
 extern void closePcmDevice (PcmDevice *pcm);
 
 extern int getPcmBlockSize (PcmDevice *pcm);
@@ -79,6 +84,7 @@ extern int writePcmData (PcmDevice *pcm, const unsigned char *buffer, int count)
 extern void pushPcmOutput (PcmDevice *pcm);
 extern void awaitPcmOutput (PcmDevice *pcm);
 extern void cancelPcmOutput (PcmDevice *pcm);
+extern int getPcmOutputDelay (PcmDevice *pcm); // milliseconds, or -1 if unknown
 
 #ifdef __cplusplus
 }
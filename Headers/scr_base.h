@@ -38,6 +38,7 @@ typedef struct {
 
   int (*poll) (void);
   int (*refresh) (void);
+  int (*awaitUpdate) (int timeout);
   void (*describe) (ScreenDescription *);
 
   int (*readCharacters) (const ScreenBox *box, ScreenCharacter *buffer);
@@ -36,6 +36,10 @@ extern int muteSpeech (SpeechSynthesizer *spk, const char *reason);
 extern int canDrainSpeech (SpeechSynthesizer *spk);
 extern int drainSpeech (SpeechSynthesizer *spk);
 
+/* wait until the driver has handled every request which has been made */
+extern int awaitSpeech (SpeechSynthesizer *spk, int timeout);
+extern void getSpeechStatistics (SpeechSynthesizer *spk, SpeechQueueStatistics *statistics);
+
 extern int sayUtf8Characters (
   SpeechSynthesizer *spk,
   const char *text, const unsigned char *attributes,
@@ -0,0 +1,64 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2022 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#ifndef BRLTTY_INCLUDED_SPK_CACHE
+#define BRLTTY_INCLUDED_SPK_CACHE
+
+#include "prologue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/* A least recently used cache of the audio (signed, 16-bit, native endian,
+ * mono samples) which a speech engine has synthesized for short utterances.
+ * It isn't thread-safe - a driver which synthesizes on more than one thread
+ * must serialize its own calls.
+ */
+typedef struct SpeechCacheStruct SpeechCache;
+
+typedef struct {
+  const unsigned char *text;
+  size_t length;
+
+  const char *voice;
+  unsigned char volume;
+  unsigned char rate;
+  unsigned char pitch;
+  unsigned char punctuation;
+} SpeechCacheKey;
+
+typedef struct {
+  const int16_t *samples;
+  size_t count;
+  int sampleRate;
+} SpeechCacheAudio;
+
+extern SpeechCache *newSpeechCache (size_t size);
+extern void destroySpeechCache (SpeechCache *cache);
+
+extern int isCacheableSpeech (const SpeechCache *cache, size_t length);
+
+extern int getCachedSpeech (SpeechCache *cache, const SpeechCacheKey *key, SpeechCacheAudio *audio);
+extern int putCachedSpeech (SpeechCache *cache, const SpeechCacheKey *key, const SpeechCacheAudio *audio);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* BRLTTY_INCLUDED_SPK_CACHE */
@@ -29,6 +29,19 @@ typedef enum {
   SAY_OPT_MUTE_FIRST      = 0X01,
   SAY_OPT_HIGHER_PITCH    = 0X02,
   SAY_OPT_ALL_PUNCTUATION = 0X04,
+
+  /* The request class determines how queued requests are superseded/merged.
+   * Muting first for an automatic (autospeak or echo) request doesn't cut a
+   * message short - it only replaces older automatic speech. Muting first
+   * for speech input (see spk_input.c) only discards or interrupts other
+   * speech input.
+   */
+  SAY_OPT_CLASS_REQUESTED = 0X00,
+  SAY_OPT_CLASS_AUTOSPEAK = 0X10,
+  SAY_OPT_CLASS_ECHO      = 0X20,
+  SAY_OPT_CLASS_MESSAGE   = 0X30,
+  SAY_OPT_CLASS_INPUT     = 0X40,
+  SAY_OPT_CLASS_MASK      = 0X70,
 } SayOptions;
 
 #define SPK_VOLUME_DEFAULT 10
@@ -59,6 +72,15 @@ typedef void SetSpeechPitchMethod (SpeechSynthesizer *spk, unsigned char setting
 typedef void SetSpeechPunctuationMethod (SpeechSynthesizer *spk, SpeechPunctuation setting);
 typedef void DrainSpeechMethod (SpeechSynthesizer *spk);
 
+typedef struct {
+  unsigned int requests;
+  unsigned int maximumDepth;
+  long int totalAge;
+  long int maximumAge;
+  unsigned int superseded;
+  unsigned int merged;
+} SpeechQueueStatistics;
+
 typedef void SetSpeechFinishedMethod (SpeechSynthesizer *spk);
 typedef void SetSpeechLocationMethod (SpeechSynthesizer *spk, int location);
 
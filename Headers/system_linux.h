@@ -82,6 +82,27 @@ extern void destroyInputEventMonitor (
   InputEventMonitor *monitor
 );
 
+typedef struct {
+  const char *action;
+  const char *path;
+  const char *properties;
+  size_t size;
+} KobjectUevent;
+
+extern const char *getKobjectUeventProperty (const KobjectUevent *event, const char *name);
+
+#define KOBJECT_UEVENT_HANDLER(name) void name (const KobjectUevent *event, void *data)
+typedef KOBJECT_UEVENT_HANDLER(KobjectUeventHandler);
+typedef struct KobjectUeventMonitorStruct KobjectUeventMonitor;
+
+extern KobjectUeventMonitor *newKobjectUeventMonitor (
+  KobjectUeventHandler *handleUevent, void *data
+);
+
+extern void destroyKobjectUeventMonitor (
+  KobjectUeventMonitor *monitor
+);
+
 typedef uint8_t LinuxKeyCode;
 #define LINUX_KEY_MAP_NAME(type) linuxKeyMap_ ## type
 #define LINUX_KEY_MAP(type) const LinuxKeyCode LINUX_KEY_MAP_NAME(type)[0X100]
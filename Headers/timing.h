@@ -43,6 +43,7 @@ extern long int millisecondsTillNextMinute (const TimeValue *reference);
 
 extern void getMonotonicTime (TimeValue *now);
 extern long int getMonotonicElapsed (const TimeValue *start);
+extern long int getMonotonicElapsedMicroseconds (const TimeValue *start);
 
 typedef struct {
   TimeValue start;
@@ -313,6 +313,7 @@ typedef struct {
 
   int (*setDtrState) (UsbDevice *device, int state);
   int (*setRtsState) (UsbDevice *device, int state);
+  int (*setLowLatency) (UsbDevice *device, int enabled);
 
   UsbInputFilter *inputFilter;
   ssize_t (*writeData) (UsbDevice *device, const void *data, size_t size);
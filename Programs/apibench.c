@@ -0,0 +1,932 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2022 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+/* apibench puts a BrlAPI server under load with a mix of simulated clients */
+
+#include "prologue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+#ifdef __MINGW32__
+#include "win_pthread.h"
+#else /* __MINGW32__ */
+#include <pthread.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif /* __MINGW32__ */
+
+#include "options.h"
+#include "log.h"
+#include "parse.h"
+#include "timing.h"
+
+#define BRLAPI_NO_DEPRECATED
+#define BRLAPI_NO_SINGLE_SESSION
+#include "brlapi.h"
+
+static char *opt_host;
+static char *opt_auth;
+static char *opt_writers;
+static char *opt_readers;
+static char *opt_watchers;
+static int opt_rawMode;
+static char *opt_duration;
+static char *opt_displaySocket;
+static char *opt_displayCells;
+static char *opt_keyRate;
+static char *opt_keyBatchDelay;
+static char *opt_serverProcess;
+
+BEGIN_OPTION_TABLE(programOptions)
+  { .word = "writers",
+    .letter = 'w',
+    .argument = "count",
+    .setting.string = &opt_writers,
+    .description = "Number of clients which write text and wait for it to be acknowledged."
+  },
+
+  { .word = "readers",
+    .letter = 'r',
+    .argument = "count",
+    .setting.string = &opt_readers,
+    .description = "Number of clients which read keys."
+  },
+
+  { .word = "watchers",
+    .letter = 'p',
+    .argument = "count",
+    .setting.string = &opt_watchers,
+    .description = "Number of clients which watch the (overwritten) clipboard content parameter."
+  },
+
+  { .word = "raw",
+    .letter = 'R',
+    .setting.flag = &opt_rawMode,
+    .description = "Add a client which repeatedly enters and leaves raw mode."
+  },
+
+  { .word = "time",
+    .letter = 't',
+    .argument = "seconds",
+    .setting.string = &opt_duration,
+    .description = "How long to run the benchmark."
+  },
+
+  { .word = "display",
+    .letter = 'd',
+    .argument = "path",
+    .setting.string = &opt_displaySocket,
+    .description = "Act as the display of a Virtual braille driver listening on this local socket."
+  },
+
+  { .word = "cells",
+    .letter = 'c',
+    .argument = "count",
+    .setting.string = &opt_displayCells,
+    .description = "Number of cells the simulated display reports."
+  },
+
+  { .word = "keys",
+    .letter = 'k',
+    .argument = "per-second",
+    .setting.string = &opt_keyRate,
+    .description = "How many key events the simulated display generates each second."
+  },
+
+  { .word = "batch",
+    .letter = 'B',
+    .argument = "milliseconds",
+    .setting.string = &opt_keyBatchDelay,
+    .description = "Key batch delay requested by the readers."
+  },
+
+  { .word = "server",
+    .letter = 's',
+    .argument = "pid",
+    .setting.string = &opt_serverProcess,
+    .description = "Process identifier of the server whose CPU usage should be reported."
+  },
+
+  { .word = "brlapi",
+    .letter = 'b',
+    .argument = "[host][:port]",
+    .setting.string = &opt_host,
+    .description = "BrlAPI host and/or port to connect to."
+  },
+
+  { .word = "auth",
+    .letter = 'a',
+    .argument = "scheme+...",
+    .setting.string = &opt_auth,
+    .description = "BrlAPI authorization/authentication schemes."
+  },
+END_OPTION_TABLE
+
+static int writerCount;
+static int readerCount;
+static int watcherCount;
+static int benchmarkDuration;
+static int displayCells;
+static int keyRate;
+static int keyBatchDelay;
+static int serverProcess;
+
+static volatile int stopBenchmark = 0;
+
+typedef struct {
+  const char *name;
+  pthread_mutex_t mutex;
+
+  long int *samples;
+  size_t size;
+  size_t count;
+} SampleList;
+
+#define SAMPLE_LIST_INITIALIZER(label) { \
+  .name = label, \
+  .mutex = PTHREAD_MUTEX_INITIALIZER \
+}
+
+static SampleList writeLatencies = SAMPLE_LIST_INITIALIZER("write acknowledgement");
+static SampleList keyLatencies = SAMPLE_LIST_INITIALIZER("key delivery");
+static SampleList parameterLatencies = SAMPLE_LIST_INITIALIZER("parameter update");
+static SampleList rawModeLatencies = SAMPLE_LIST_INITIALIZER("raw mode round trip");
+
+static void
+addSample (SampleList *list, long int sample) {
+  pthread_mutex_lock(&list->mutex);
+
+  if (list->count == list->size) {
+    size_t newSize = list->size? list->size << 1: 0X400;
+    long int *newSamples = realloc(list->samples, ARRAY_SIZE(newSamples, newSize));
+
+    if (!newSamples) {
+      logMallocError();
+      goto done;
+    }
+
+    list->samples = newSamples;
+    list->size = newSize;
+  }
+
+  list->samples[list->count++] = sample;
+
+done:
+  pthread_mutex_unlock(&list->mutex);
+}
+
+static int
+compareSamples (const void *element1, const void *element2) {
+  const long int *sample1 = element1;
+  const long int *sample2 = element2;
+
+  if (*sample1 < *sample2) return -1;
+  if (*sample1 > *sample2) return 1;
+  return 0;
+}
+
+static double
+getPercentile (const SampleList *list, unsigned int percent) {
+  size_t index = ((list->count - 1) * percent) / 100;
+  return (double)list->samples[index] / 1000.0;
+}
+
+static void
+reportSamples (SampleList *list, double seconds) {
+  printf("%s: %zu", list->name, list->count);
+
+  if (list->count) {
+    qsort(list->samples, list->count, sizeof(*list->samples), compareSamples);
+
+    printf(
+      " (%.1f/s), latency p50 %.3fms, p99 %.3fms, max %.3fms",
+      (double)list->count / seconds,
+      getPercentile(list, 50), getPercentile(list, 99),
+      getPercentile(list, 100)
+    );
+  }
+
+  printf("\n");
+}
+
+static brlapi_connectionSettings_t connectionSettings;
+
+static brlapi_handle_t *
+openClient (const char *role, unsigned int number) {
+  brlapi_handle_t *handle = malloc(brlapi_getHandleSize());
+
+  if (handle) {
+    if (brlapi__openConnection(handle, &connectionSettings, NULL) != (brlapi_fileDescriptor)(-1)) {
+      return handle;
+    }
+
+    fprintf(stderr, "%s %u: connection failed: %s\n",
+            role, number, brlapi_strerror(&brlapi_error));
+    free(handle);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+static void
+closeClient (brlapi_handle_t *handle) {
+  brlapi__closeConnection(handle);
+  free(handle);
+}
+
+static int
+enterTtyMode (brlapi_handle_t *handle, const char *role, unsigned int number) {
+  if (brlapi__enterTtyModeWithPath(handle, NULL, 0, NULL) != -1) return 1;
+
+  fprintf(stderr, "%s %u: enter tty mode failed: %s\n",
+          role, number, brlapi_strerror(&brlapi_error));
+  return 0;
+}
+
+static int
+waitForDisplay (void) {
+  brlapi_handle_t *handle = openClient("probe", 1);
+  int ok = 0;
+
+  if (handle) {
+    /* the driver might still be starting (e.g. waiting for our display) */
+    int attempts = 50;
+
+    while (1) {
+      unsigned int columns, rows;
+
+      if (brlapi__getDisplaySize(handle, &columns, &rows) == -1) {
+        fprintf(stderr, "get display size failed: %s\n",
+                brlapi_strerror(&brlapi_error));
+        break;
+      }
+
+      if (columns && rows) {
+        ok = 1;
+        break;
+      }
+
+      if (!--attempts) {
+        fprintf(stderr, "braille display not ready\n");
+        break;
+      }
+
+      approximateDelay(100);
+    }
+
+    closeClient(handle);
+  }
+
+  return ok;
+}
+
+typedef struct ClientThreadStruct ClientThread;
+typedef void ClientRunner (ClientThread *client);
+
+struct ClientThreadStruct {
+  ClientRunner *run;
+  pthread_t thread;
+  unsigned int number;
+
+  int started;
+  int ready;
+};
+
+static pthread_mutex_t readyMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t readyCondition = PTHREAD_COND_INITIALIZER;
+static int clientsStarting = 0;
+
+static void
+setClientReady (ClientThread *client) {
+  pthread_mutex_lock(&readyMutex);
+
+  if (!client->ready) {
+    client->ready = 1;
+
+    if (clientsStarting > 0) {
+      if (!--clientsStarting) pthread_cond_broadcast(&readyCondition);
+    }
+  }
+
+  pthread_mutex_unlock(&readyMutex);
+}
+
+static void
+waitForClients (void) {
+  pthread_mutex_lock(&readyMutex);
+  while (clientsStarting > 0) pthread_cond_wait(&readyCondition, &readyMutex);
+  pthread_mutex_unlock(&readyMutex);
+}
+
+static void
+releaseClients (void) {
+  pthread_mutex_lock(&readyMutex);
+  clientsStarting = 0;
+  pthread_cond_broadcast(&readyCondition);
+  pthread_mutex_unlock(&readyMutex);
+}
+
+static void
+startBenchmark (ClientThread *client) {
+  /* the measurements only begin once every client has been set up */
+  setClientReady(client);
+  waitForClients();
+}
+
+static void *
+runClient (void *argument) {
+  ClientThread *client = argument;
+
+  client->run(client);
+  setClientReady(client);
+  return NULL;
+}
+
+static void
+runWriter (ClientThread *client) {
+  static const char role[] = "writer";
+  brlapi_handle_t *handle = openClient(role, client->number);
+
+  if (handle) {
+    if (enterTtyMode(handle, role, client->number)) {
+      if (brlapi__ignoreAllKeys(handle) != -1) {
+        unsigned long int counter = 0;
+        startBenchmark(client);
+
+        while (!stopBenchmark) {
+          char text[0X40];
+          snprintf(text, sizeof(text), "writer %u: %lu", client->number, counter++);
+
+          TimeValue start;
+          getMonotonicTime(&start);
+
+          if (brlapi__writeText(handle, BRLAPI_CURSOR_OFF, text) == -1) break;
+          if (brlapi__sync(handle) == -1) break;
+          addSample(&writeLatencies, getMonotonicElapsedMicroseconds(&start));
+        }
+
+        if (!stopBenchmark) {
+          fprintf(stderr, "%s %u: write failed: %s\n",
+                  role, client->number, brlapi_strerror(&brlapi_error));
+        }
+      }
+    }
+
+    closeClient(handle);
+  }
+}
+
+static pthread_mutex_t keyMutex = PTHREAD_MUTEX_INITIALIZER;
+static TimeValue *keyInjectionTimes = NULL;
+static unsigned long int keysInjected = 0;
+static unsigned long int keysDelivered = 0;
+
+static void
+noteKeysDelivered (const brlapi_keyCode_t *codes, size_t count) {
+  while (count > 0) {
+    brlapi_keyCode_t code = *codes++;
+    long int latency = -1;
+
+    if ((code & BRLAPI_KEY_TYPE_MASK) == BRLAPI_KEY_TYPE_CMD) {
+      if ((code & BRLAPI_KEY_CMD_BLK_MASK) == BRLAPI_KEY_CMD_ROUTE) {
+        unsigned int column = (code & BRLAPI_KEY_CMD_ARG_MASK) - 1;
+
+        pthread_mutex_lock(&keyMutex);
+        if ((column < displayCells) && (column < keysInjected)) {
+          latency = getMonotonicElapsedMicroseconds(&keyInjectionTimes[column]);
+        }
+        keysDelivered += 1;
+        pthread_mutex_unlock(&keyMutex);
+      }
+    }
+
+    if (latency >= 0) addSample(&keyLatencies, latency);
+    count -= 1;
+  }
+}
+
+static void
+runReader (ClientThread *client) {
+  static const char role[] = "reader";
+  brlapi_handle_t *handle = openClient(role, client->number);
+
+  if (handle) {
+    if (enterTtyMode(handle, role, client->number)) {
+      int ok = 1;
+
+      if (keyBatchDelay) {
+        brlapi_param_keyBatchDelay_t delay = keyBatchDelay;
+
+        if (brlapi__setParameter(handle, BRLAPI_PARAM_KEY_BATCH_DELAY, 0, 0,
+                                 &delay, sizeof(delay)) == -1) {
+          fprintf(stderr, "%s %u: set key batch delay failed: %s\n",
+                  role, client->number, brlapi_strerror(&brlapi_error));
+          ok = 0;
+        }
+      }
+
+      if (ok) startBenchmark(client);
+
+      while (ok && !stopBenchmark) {
+        brlapi_keyCode_t codes[0X20];
+        ssize_t count = brlapi__readKeys(handle, codes, ARRAY_COUNT(codes), 100);
+
+        if (count == -1) {
+          fprintf(stderr, "%s %u: read keys failed: %s\n",
+                  role, client->number, brlapi_strerror(&brlapi_error));
+          break;
+        }
+
+        noteKeysDelivered(codes, count);
+      }
+    }
+
+    closeClient(handle);
+  }
+}
+
+#define PARAMETER_UPDATE_INTERVAL 100000
+static TimeValue benchmarkStart;
+
+static void
+handleClipboardContent (
+  brlapi_param_t parameter, brlapi_param_subparam_t subparam,
+  brlapi_param_flags_t flags, void *priv, const void *data, size_t length
+) {
+  char content[0X40];
+  long int published;
+
+  if (length >= sizeof(content)) return;
+  memcpy(content, data, length);
+  content[length] = 0;
+
+  if (sscanf(content, "apibench %ld", &published) == 1) {
+    addSample(&parameterLatencies, getMonotonicElapsedMicroseconds(&benchmarkStart) - published);
+  }
+}
+
+static void
+runWatcher (ClientThread *client) {
+  static const char role[] = "watcher";
+  brlapi_handle_t *handle = malloc(brlapi_getHandleSize());
+
+  if (handle) {
+    brlapi_fileDescriptor fd = brlapi__openConnection(handle, &connectionSettings, NULL);
+
+    if (fd != (brlapi_fileDescriptor)(-1)) {
+      if (brlapi__watchParameter(handle, BRLAPI_PARAM_CLIPBOARD_CONTENT, 0,
+                                 BRLAPI_PARAMF_GLOBAL, handleClipboardContent,
+                                 NULL, NULL, 0)) {
+        /* the first watcher also publishes the updates */
+        int publisher = client->number == 1;
+        long int due = 0;
+
+        startBenchmark(client);
+
+        while (!stopBenchmark) {
+          int timeout = 100;
+
+          if (publisher) {
+            long int now = getMonotonicElapsedMicroseconds(&benchmarkStart);
+
+            if (now >= due) {
+              char content[0X40];
+              snprintf(content, sizeof(content), "apibench %ld", now);
+
+              if (brlapi__setParameter(handle, BRLAPI_PARAM_CLIPBOARD_CONTENT, 0,
+                                       BRLAPI_PARAMF_GLOBAL, content,
+                                       strlen(content)) == -1) {
+                break;
+              }
+
+              due = now + PARAMETER_UPDATE_INTERVAL;
+              continue;
+            }
+
+            timeout = ((due - now) + 999) / 1000;
+          }
+
+#ifdef __MINGW32__
+          approximateDelay(timeout);
+#else /* __MINGW32__ */
+          struct pollfd pfd = {
+            .fd = fd,
+            .events = POLLIN
+          };
+
+          if (poll(&pfd, 1, timeout) <= 0) continue;
+#endif /* __MINGW32__ */
+
+          /* parameter updates are only delivered while a BrlAPI call is
+           * waiting for a reply - a synchronization round trip will do
+           */
+          if (brlapi__sync(handle) == -1) break;
+        }
+      }
+
+      if (!stopBenchmark) {
+        fprintf(stderr, "%s %u: watch failed: %s\n",
+                role, client->number, brlapi_strerror(&brlapi_error));
+      }
+
+      brlapi__closeConnection(handle);
+    } else {
+      fprintf(stderr, "%s %u: connection failed: %s\n",
+              role, client->number, brlapi_strerror(&brlapi_error));
+    }
+
+    free(handle);
+  } else {
+    logMallocError();
+  }
+}
+
+static void
+runRawClient (ClientThread *client) {
+  static const char role[] = "raw";
+  brlapi_handle_t *handle = openClient(role, client->number);
+
+  if (handle) {
+    char driver[0X20];
+
+    if (brlapi__getDriverName(handle, driver, sizeof(driver)) != -1) {
+      startBenchmark(client);
+
+      while (!stopBenchmark) {
+        TimeValue start;
+        getMonotonicTime(&start);
+
+        if (brlapi__enterRawMode(handle, driver) == -1) break;
+        if (brlapi__leaveRawMode(handle) == -1) break;
+        addSample(&rawModeLatencies, getMonotonicElapsedMicroseconds(&start));
+
+        /* give the other clients a chance at the driver */
+        approximateDelay(10);
+      }
+    }
+
+    if (!stopBenchmark) {
+      fprintf(stderr, "%s %u: raw mode failed: %s\n",
+              role, client->number, brlapi_strerror(&brlapi_error));
+    }
+
+    closeClient(handle);
+  }
+}
+
+#ifndef __MINGW32__
+static int displaySocket = -1;
+
+static int
+writeDisplayLine (const char *line) {
+  size_t length = strlen(line);
+
+  while (length > 0) {
+    ssize_t result = send(displaySocket, line, length, 0);
+
+    if (result == -1) {
+      if (errno == EINTR) continue;
+      logSystemError("display write");
+      return 0;
+    }
+
+    line += result;
+    length -= result;
+  }
+
+  return 1;
+}
+
+static int
+allocateKeyInjectionTimes (void) {
+  if ((keyInjectionTimes = calloc(displayCells, sizeof(*keyInjectionTimes)))) return 1;
+  logMallocError();
+  return 0;
+}
+
+static int
+injectKey (void) {
+  /* each routing key is used in turn so that deliveries can be matched up */
+  unsigned int column = keysInjected % displayCells;
+  char line[0X20];
+  snprintf(line, sizeof(line), "ROUTE %u\n", column+1);
+
+  pthread_mutex_lock(&keyMutex);
+  getMonotonicTime(&keyInjectionTimes[column]);
+  keysInjected += 1;
+  pthread_mutex_unlock(&keyMutex);
+
+  return writeDisplayLine(line);
+}
+
+static int
+connectDisplay (void) {
+  struct sockaddr_un address;
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_LOCAL;
+
+  if (strlen(opt_displaySocket) >= sizeof(address.sun_path)) {
+    logMessage(LOG_ERR, "display socket path too long: %s", opt_displaySocket);
+    return 0;
+  }
+
+  strcpy(address.sun_path, opt_displaySocket);
+
+  if ((displaySocket = socket(PF_LOCAL, SOCK_STREAM, 0)) != -1) {
+    if (connect(displaySocket, (struct sockaddr *)&address, sizeof(address)) != -1) {
+      char line[0X20];
+      snprintf(line, sizeof(line), "cells %d\n", displayCells);
+      if (writeDisplayLine(line)) return 1;
+    } else {
+      logSystemError("display connect");
+    }
+
+    close(displaySocket);
+    displaySocket = -1;
+  } else {
+    logSystemError("display socket");
+  }
+
+  return 0;
+}
+
+static void *
+runDisplay (void *argument) {
+  long int interval = 1000000 / keyRate;
+  TimeValue start;
+  unsigned long int keyCount = 0;
+
+  getMonotonicTime(&start);
+
+  while (!stopBenchmark) {
+    long int due = (long int)keyCount * interval;
+    long int elapsed = getMonotonicElapsedMicroseconds(&start);
+
+    if (elapsed >= due) {
+      /* the Virtual driver handles one line per read so keys are paced */
+      if (!injectKey()) break;
+      keyCount += 1;
+      continue;
+    }
+
+    {
+      struct pollfd pfd = {
+        .fd = displaySocket,
+        .events = POLLIN
+      };
+
+      int timeout = ((due - elapsed) + 999) / 1000;
+      int result = poll(&pfd, 1, timeout);
+
+      if (result > 0) {
+        char buffer[0X1000];
+
+        /* discard what the driver writes to the display */
+        if (recv(displaySocket, buffer, sizeof(buffer), 0) <= 0) {
+          logMessage(LOG_ERR, "display disconnected");
+          break;
+        }
+      } else if ((result == -1) && (errno != EINTR)) {
+        logSystemError("display poll");
+        break;
+      }
+    }
+  }
+
+  return NULL;
+}
+#endif /* __MINGW32__ */
+
+static int
+getProcessTicks (unsigned long long int *ticks) {
+  char path[0X40];
+  snprintf(path, sizeof(path), "/proc/%d/stat", serverProcess);
+
+  FILE *stream = fopen(path, "r");
+  if (!stream) return 0;
+
+  char buffer[0X400];
+  int ok = 0;
+
+  if (fgets(buffer, sizeof(buffer), stream)) {
+    /* skip the command name since it might contain spaces */
+    const char *fields = strrchr(buffer, ')');
+
+    if (fields) {
+      unsigned long int user;
+      unsigned long int system;
+
+      if (sscanf(fields+1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                 &user, &system) == 2) {
+        *ticks = (unsigned long long int)user + system;
+        ok = 1;
+      }
+    }
+  }
+
+  fclose(stream);
+  return ok;
+}
+
+static int
+parseCount (int *count, const char *name, const char *operand, int minimum, int maximum) {
+  if (!operand || !*operand) return 1;
+  if (validateInteger(count, operand, &minimum, &maximum)) return 1;
+
+  logMessage(LOG_ERR, "invalid %s: %s", name, operand);
+  return 0;
+}
+
+static int
+startClients (ClientThread *clients, int count, ClientRunner *run) {
+  for (int index=0; index<count; index+=1) {
+    ClientThread *client = &clients[index];
+    client->run = run;
+    client->number = index + 1;
+
+    int error = pthread_create(&client->thread, NULL, runClient, client);
+
+    if (error) {
+      logActionError(error, "pthread_create");
+      return 0;
+    }
+
+    client->started = 1;
+  }
+
+  return 1;
+}
+
+static void
+stopClients (ClientThread *clients, int count) {
+  for (int index=0; index<count; index+=1) {
+    ClientThread *client = &clients[index];
+    if (client->started) pthread_join(client->thread, NULL);
+  }
+}
+
+int
+main (int argc, char *argv[]) {
+  ProgramExitStatus exitStatus = PROG_EXIT_SUCCESS;
+
+  {
+    static const OptionsDescriptor descriptor = {
+      OPTION_TABLE(programOptions),
+      .applicationName = "apibench"
+    };
+    PROCESS_OPTIONS(descriptor, argc, argv);
+  }
+
+  writerCount = 1;
+  readerCount = 1;
+  watcherCount = 0;
+  benchmarkDuration = 10;
+  displayCells = 40;
+  keyRate = 20;
+  keyBatchDelay = 0;
+  serverProcess = 0;
+
+  if (!parseCount(&writerCount, "writer count", opt_writers, 0, 1000)) return PROG_EXIT_SYNTAX;
+  if (!parseCount(&readerCount, "reader count", opt_readers, 0, 1000)) return PROG_EXIT_SYNTAX;
+  if (!parseCount(&watcherCount, "watcher count", opt_watchers, 0, 1000)) return PROG_EXIT_SYNTAX;
+  if (!parseCount(&benchmarkDuration, "duration", opt_duration, 1, 3600)) return PROG_EXIT_SYNTAX;
+  if (!parseCount(&displayCells, "cell count", opt_displayCells, 1, 0XFF)) return PROG_EXIT_SYNTAX;
+  if (!parseCount(&keyRate, "key rate", opt_keyRate, 1, 1000)) return PROG_EXIT_SYNTAX;
+  if (!parseCount(&keyBatchDelay, "key batch delay", opt_keyBatchDelay, 0, 1000)) return PROG_EXIT_SYNTAX;
+  if (!parseCount(&serverProcess, "server process", opt_serverProcess, 1, INT_MAX)) return PROG_EXIT_SYNTAX;
+
+  connectionSettings.host = opt_host;
+  connectionSettings.auth = opt_auth;
+
+  int haveDisplay = 0;
+#ifndef __MINGW32__
+  pthread_t displayThread;
+#endif /* __MINGW32__ */
+
+  if (opt_displaySocket && *opt_displaySocket) {
+#ifdef __MINGW32__
+    logMessage(LOG_ERR, "simulated display not supported");
+    return PROG_EXIT_SEMANTIC;
+#else /* __MINGW32__ */
+    if (!allocateKeyInjectionTimes()) return PROG_EXIT_FATAL;
+    if (!connectDisplay()) return PROG_EXIT_FATAL;
+#endif /* __MINGW32__ */
+  }
+
+  if (!waitForDisplay()) {
+#ifndef __MINGW32__
+    if (displaySocket != -1) close(displaySocket);
+#endif /* __MINGW32__ */
+
+    return PROG_EXIT_FATAL;
+  }
+
+  ClientThread writers[writerCount];
+  ClientThread readers[readerCount];
+  ClientThread watchers[watcherCount];
+  ClientThread rawClient;
+
+  memset(writers, 0, sizeof(writers));
+  memset(readers, 0, sizeof(readers));
+  memset(watchers, 0, sizeof(watchers));
+  memset(&rawClient, 0, sizeof(rawClient));
+
+  int rawCount = opt_rawMode? 1: 0;
+  clientsStarting = writerCount + readerCount + watcherCount + rawCount;
+  getMonotonicTime(&benchmarkStart);
+
+  unsigned long long int startTicks = 0;
+  int haveTicks = 0;
+  TimeValue start;
+
+  if (startClients(writers, writerCount, runWriter) &&
+      startClients(readers, readerCount, runReader) &&
+      startClients(watchers, watcherCount, runWatcher) &&
+      startClients(&rawClient, rawCount, runRawClient)) {
+    waitForClients();
+
+    haveTicks = serverProcess && getProcessTicks(&startTicks);
+    getMonotonicTime(&start);
+
+#ifndef __MINGW32__
+    if (displaySocket != -1) {
+      int error = pthread_create(&displayThread, NULL, runDisplay, NULL);
+
+      if (error) {
+        logActionError(error, "pthread_create");
+      } else {
+        haveDisplay = 1;
+      }
+    }
+#endif /* __MINGW32__ */
+
+    approximateDelay(benchmarkDuration * 1000);
+  } else {
+    exitStatus = PROG_EXIT_FATAL;
+    getMonotonicTime(&start);
+  }
+
+  stopBenchmark = 1;
+  releaseClients();
+#ifndef __MINGW32__
+  if (haveDisplay) pthread_join(displayThread, NULL);
+#endif /* __MINGW32__ */
+
+  stopClients(writers, writerCount);
+  stopClients(readers, readerCount);
+  stopClients(watchers, watcherCount);
+  stopClients(&rawClient, 1);
+
+  double seconds = (double)getMonotonicElapsedMicroseconds(&start) / 1000000.0;
+  printf("clients: %d writer(s), %d reader(s), %d watcher(s), %d raw\n",
+         writerCount, readerCount, watcherCount, rawCount);
+  printf("duration: %.1fs\n", seconds);
+
+  reportSamples(&writeLatencies, seconds);
+  if (haveDisplay) printf("keys injected: %lu, delivered: %lu\n", keysInjected, keysDelivered);
+  reportSamples(&keyLatencies, seconds);
+  reportSamples(&parameterLatencies, seconds);
+  if (opt_rawMode) reportSamples(&rawModeLatencies, seconds);
+
+  if (haveTicks) {
+    unsigned long long int endTicks;
+
+    if (getProcessTicks(&endTicks)) {
+      double cpu = (double)(endTicks - startTicks) / (double)sysconf(_SC_CLK_TCK);
+      printf("server CPU: %.2fs (%.1f%%)\n", cpu, (cpu * 100.0) / seconds);
+    }
+  } else if (serverProcess) {
+    printf("server CPU: not available\n");
+  }
+
+#ifndef __MINGW32__
+  if (displaySocket != -1) close(displaySocket);
+  if (keyInjectionTimes) free(keyInjectionTimes);
+#endif /* __MINGW32__ */
+
+  return exitStatus;
+}
@@ -19,6 +19,7 @@
 #include "prologue.h"
 
 #include <string.h>
+#include <ctype.h>
 #include <errno.h>
 
 #include "log.h"
@@ -28,6 +29,7 @@
 #include "async_wait.h"
 #include "parse.h"
 #include "device.h"
+#include "file.h"
 #include "queue.h"
 #include "io_bluetooth.h"
 #include "bluetooth_internal.h"
@@ -62,21 +64,226 @@ bthLogChannel (uint8_t channel) {
 typedef struct {
   uint64_t address;
   char *name;
+  char *driver;
+  const char *driverCodes[2];
   int error;
+  uint8_t channel;
   unsigned paired:1;
 } BluetoothDeviceEntry;
 
+static BluetoothDeviceEntry *
+bthNewDeviceEntry (uint64_t address) {
+  BluetoothDeviceEntry *device;
+
+  if ((device = malloc(sizeof(*device)))) {
+    memset(device, 0, sizeof(*device));
+    device->address = address;
+    device->name = NULL;
+    device->driver = NULL;
+    device->driverCodes[0] = NULL;
+    device->error = 0;
+    device->channel = 0;
+    device->paired = 0;
+    return device;
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
 static void
 bthDeallocateDeviceEntry (void *item, void *data) {
   BluetoothDeviceEntry *device = item;
 
   if (device->name) free(device->name);
+  if (device->driver) free(device->driver);
   free(device);
 }
 
+static int
+bthSetDeviceString (char **string, const char *value) {
+  if (value && *value) {
+    if (*string && (strcmp(*string, value) == 0)) return 1;
+    char *copy = strdup(value);
+
+    if (copy) {
+      if (*string) free(*string);
+      *string = copy;
+      return 1;
+    } else {
+      logMallocError();
+    }
+  }
+
+  return 0;
+}
+
+static int
+bthSetDeviceDriver (BluetoothDeviceEntry *device, const char *driver) {
+  if (!bthSetDeviceString(&device->driver, driver)) return 0;
+
+  device->driverCodes[0] = device->driver;
+  device->driverCodes[1] = NULL;
+  return 1;
+}
+
+/* The RFCOMM channel, driver, and name of each device that has been
+ * connected to are saved in the updatable directory so that a reconnect
+ * (e.g. after a suspend) can skip the name request and channel discovery.
+ * A cached channel that's refused is forgotten and rediscovered.
+ */
+static const char bthDeviceCacheFile[] = "bluetooth-devices";
+
+static int
+bthIsCachedString (const char *string) {
+  while (*string) {
+    if (iscntrl((unsigned char)*string)) return 0;
+    string += 1;
+  }
+
+  return 1;
+}
+
+static int
+bthLoadCachedDevice (const LineHandlerParameters *parameters) {
+  Queue *devices = parameters->data;
+  char *fields[4];
+  unsigned int count = 0;
+
+  {
+    char *next = parameters->line.text;
+
+    while (count < ARRAY_COUNT(fields)) {
+      fields[count++] = next;
+      if (!(next = strchr(next, '\t'))) break;
+      *next++ = 0;
+    }
+  }
+
+  if ((count == ARRAY_COUNT(fields)) &&
+      bthIsCachedString(fields[2]) && bthIsCachedString(fields[3])) {
+    uint64_t address;
+    uint8_t channel;
+
+    if (bthParseAddress(&address, fields[0]) &&
+        bthParseChannelNumber(&channel, fields[1])) {
+      BluetoothDeviceEntry *device = bthNewDeviceEntry(address);
+
+      if (device) {
+        device->channel = channel;
+        bthSetDeviceDriver(device, fields[2]);
+        bthSetDeviceString(&device->name, fields[3]);
+
+        if (enqueueItem(devices, device)) return 1;
+        bthDeallocateDeviceEntry(device, NULL);
+      }
+
+      return 1;
+    }
+  }
+
+  logMessage(LOG_WARNING, "invalid Bluetooth device cache entry: %s[%u]",
+             bthDeviceCacheFile, parameters->line.number);
+  return 1;
+}
+
+static void
+bthLoadDeviceCache (Queue *devices) {
+  char *path = makeUpdatablePath(bthDeviceCacheFile);
+
+  if (path) {
+    FILE *stream = openFile(path, "r", 1);
+
+    if (stream) {
+      processLines(stream, bthLoadCachedDevice, devices);
+      fclose(stream);
+
+      logMessage(LOG_CATEGORY(BLUETOOTH_IO),
+                 "cached devices: %d", getQueueSize(devices));
+    }
+
+    free(path);
+  }
+}
+
+static void
+bthWriteCachedString (FILE *stream, const char *string) {
+  /* The name comes from the remote device so it mustn't be allowed to
+   * introduce field (tab) or line (newline) separators.
+   */
+  if (string) {
+    while (*string) {
+      unsigned char character = *string++;
+      fputc((iscntrl(character)? ' ': character), stream);
+    }
+  }
+}
+
+static int
+bthSaveCachedDevice (void *item, void *data) {
+  const BluetoothDeviceEntry *device = item;
+  FILE *stream = data;
+
+  if (device->channel) {
+    char address[0X20];
+
+    bthFormatAddress(address, sizeof(address), device->address);
+    fprintf(stream, "%s\t%u\t", address, device->channel);
+    bthWriteCachedString(stream, device->driver);
+    fputc('\t', stream);
+    bthWriteCachedString(stream, device->name);
+    fputc('\n', stream);
+  }
+
+  return ferror(stream);
+}
+
+static void
+bthSaveDeviceCache (Queue *devices) {
+  char *path = makeUpdatablePath(bthDeviceCacheFile);
+
+  if (path) {
+    /* Write a new file and then replace the old one with it so that an
+     * interrupted save can't leave a truncated cache behind.
+     */
+    char newPath[strlen(path) + 5];
+    snprintf(newPath, sizeof(newPath), "%s.new", path);
+
+    FILE *stream = openFile(newPath, "w", 1);
+
+    if (stream) {
+      int ok = !processQueue(devices, bthSaveCachedDevice, stream);
+
+      if (fclose(stream) == EOF) {
+        logSystemError("fclose");
+        ok = 0;
+      }
+
+      if (ok) {
+#ifdef __MINGW32__
+        remove(path);
+#endif /* __MINGW32__ */
+
+        if (rename(newPath, path) == -1) {
+          logSystemError("rename");
+          ok = 0;
+        }
+      }
+
+      if (!ok) remove(newPath);
+    }
+
+    free(path);
+  }
+}
+
 static Queue *
 bthCreateDeviceQueue (void *data) {
-  return newQueue(bthDeallocateDeviceEntry, NULL);
+  Queue *devices = newQueue(bthDeallocateDeviceEntry, NULL);
+
+  if (devices) bthLoadDeviceCache(devices);
+  return devices;
 }
 
 static Queue *
@@ -104,16 +311,9 @@ bthGetDeviceEntry (uint64_t address, int add) {
     if (device) return device;
 
     if (add) {
-      if ((device = malloc(sizeof(*device)))) {
-        device->address = address;
-        device->name = NULL;
-        device->error = 0;
-        device->paired = 0;
-
+      if ((device = bthNewDeviceEntry(address))) {
         if (enqueueItem(devices, device)) return device;
-        free(device);
-      } else {
-        logMallocError();
+        bthDeallocateDeviceEntry(device, NULL);
       }
     }
   }
@@ -123,19 +323,7 @@ bthGetDeviceEntry (uint64_t address, int add) {
 
 static int
 bthSetDeviceName (BluetoothDeviceEntry *device, const char *name) {
-  if (name && *name) {
-    char *copy = strdup(name);
-
-    if (copy) {
-      if (device->name) free(device->name);
-      device->name = copy;
-      return 1;
-    } else {
-      logMallocError();
-    }
-  }
-
-  return 0;
+  return bthSetDeviceString(&device->name, name);
 }
 
 static inline const char *
@@ -176,7 +364,11 @@ void
 bthForgetDevices (void) {
   Queue *devices = bthGetDeviceQueue(0);
 
-  if (devices) deleteElements(devices);
+  if (devices) {
+    deleteElements(devices);
+    bthLoadDeviceCache(devices);
+  }
+
   bluetoothDevicesDiscovered = 0;
 }
 
@@ -189,6 +381,37 @@ bthRememberConnectError (uint64_t address, int value) {
   return 1;
 }
 
+static int
+bthRecallChannel (uint64_t address, uint8_t *channel) {
+  const BluetoothDeviceEntry *device = bthGetDeviceEntry(address, 1);
+  if (!device) return 0;
+  if (!device->channel) return 0;
+
+  *channel = device->channel;
+  return 1;
+}
+
+static void
+bthRememberChannel (uint64_t address, uint8_t channel, const char *driver) {
+  BluetoothDeviceEntry *device = bthGetDeviceEntry(address, 1);
+
+  if (device) {
+    device->channel = channel;
+    if (driver) bthSetDeviceDriver(device, driver);
+    bthSaveDeviceCache(bthGetDeviceQueue(0));
+  }
+}
+
+static void
+bthForgetChannel (uint64_t address) {
+  BluetoothDeviceEntry *device = bthGetDeviceEntry(address, 0);
+
+  if (device && device->channel) {
+    device->channel = 0;
+    bthSaveDeviceCache(bthGetDeviceQueue(0));
+  }
+}
+
 static int
 bthRecallConnectError (uint64_t address, int *value) {
   BluetoothDeviceEntry *device = bthGetDeviceEntry(address, 0);
@@ -497,6 +720,24 @@ bthApplyParameters (BluetoothConnectionRequest *request, const char *identifier)
   return ok;
 }
 
+static int
+bthOpenConnectionChannel (BluetoothConnection *connection, int timeout) {
+  TimePeriod period;
+  startTimePeriod(&period, BLUETOOTH_CHANNEL_BUSY_RETRY_TIMEOUT);
+
+  while (1) {
+    if (bthOpenChannel(connection->extension, connection->channel, timeout)) {
+      return 1;
+    }
+
+    if (afterTimePeriod(&period, NULL)) break;
+    if (errno != EBUSY) break;
+    asyncWait(BLUETOOTH_CHANNEL_BUSY_RETRY_INTERVAL);
+  }
+
+  return 0;
+}
+
 BluetoothConnection *
 bthOpenConnection (const BluetoothConnectionRequest *request) {
   BluetoothConnection *connection;
@@ -519,24 +760,35 @@ bthOpenConnection (const BluetoothConnectionRequest *request) {
       }
 
       if (!alreadyTried) {
-        if (request->discover) bthDiscoverSerialPortChannel(&connection->channel, connection->extension, request->timeout);
-        bthLogChannel(connection->channel);
+        int discover = request->discover;
 
-        {
-          TimePeriod period;
-          startTimePeriod(&period, BLUETOOTH_CHANNEL_BUSY_RETRY_TIMEOUT);
+        if (discover && bthRecallChannel(connection->address, &connection->channel)) {
+          logMessage(LOG_CATEGORY(BLUETOOTH_IO), "using cached channel");
+          bthLogChannel(connection->channel);
 
-          while (1) {
-            if (bthOpenChannel(connection->extension, connection->channel, request->timeout)) {
-              return connection;
-            }
+          if (bthOpenConnectionChannel(connection, request->timeout)) return connection;
+          if (errno != ECONNREFUSED) discover = 0;
 
-            if (afterTimePeriod(&period, NULL)) break;
-            if (errno != EBUSY) break;
-            asyncWait(BLUETOOTH_CHANNEL_BUSY_RETRY_INTERVAL);
+          if (discover) {
+            logMessage(LOG_CATEGORY(BLUETOOTH_IO), "cached channel refused");
+            bthForgetChannel(connection->address);
+            connection->channel = request->channel;
           }
         }
 
+        if (discover) {
+          bthDiscoverSerialPortChannel(&connection->channel, connection->extension, request->timeout);
+          bthLogChannel(connection->channel);
+
+          if (bthOpenConnectionChannel(connection, request->timeout)) {
+            bthRememberChannel(connection->address, connection->channel, request->driver);
+            return connection;
+          }
+        } else if (!request->discover) {
+          bthLogChannel(connection->channel);
+          if (bthOpenConnectionChannel(connection, request->timeout)) return connection;
+        }
+
         bthRememberConnectError(connection->address, errno);
       }
 
@@ -638,6 +890,7 @@ bthGetDeviceName (uint64_t address, int timeout) {
 
       if ((device->name = bthObtainDeviceName(address, timeout))) {
         logMessage(LOG_CATEGORY(BLUETOOTH_IO), "device name: %s", device->name);
+        if (device->channel) bthSaveDeviceCache(bthGetDeviceQueue(0));
       } else {
         logMessage(LOG_CATEGORY(BLUETOOTH_IO), "device name not obtained");
       }
@@ -771,7 +1024,17 @@ bthGetDriverCodes (const char *identifier, int timeout) {
     if (bthGetDeviceAddress(&address, parameters, NULL)) {
       const char *name = bthGetDeviceName(address, timeout);
       const BluetoothNameEntry *entry = bthGetNameEntry(name);
-      if (entry) codes = entry->driverCodes;
+
+      if (entry) {
+        codes = entry->driverCodes;
+      } else {
+        const BluetoothDeviceEntry *device = bthGetDeviceEntry(address, 0);
+
+        if (device && device->driver) {
+          logMessage(LOG_CATEGORY(BLUETOOTH_IO), "using cached driver: %s", device->driver);
+          codes = device->driverCodes;
+        }
+      }
     }
 
     deallocateStrings(parameters);
@@ -246,6 +246,125 @@ readBraillePacket (
   }
 }
 
+static const BrailleFrameType *
+getBrailleFrameType (const BrailleFrameDescription *frame, unsigned char lead) {
+  const BrailleFrameType *type = frame->types;
+  const BrailleFrameType *end = type + frame->count;
+
+  while (type < end) {
+    if (type->lead == lead) return type;
+    type += 1;
+  }
+
+  return frame->defaultType;
+}
+
+static int
+readBrailleFrameBytes (
+  GioEndpoint *endpoint,
+  unsigned char *bytes, size_t *count, size_t length
+) {
+  if (*count < length) {
+    ssize_t result = gioReadData(endpoint, &bytes[*count], (length - *count), 1);
+
+    if (result > 0) *count += result;
+
+    if (*count < length) {
+      logPartialPacket(bytes, *count);
+      if (result != -1) errno = EAGAIN;
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static int
+discardBrailleFrameBytes (GioEndpoint *endpoint, size_t count) {
+  while (count > 0) {
+    unsigned char buffer[0X40];
+    size_t size = MIN(count, sizeof(buffer));
+    ssize_t result = gioReadData(endpoint, buffer, size, 1);
+
+    if (result <= 0) return 0;
+    logDiscardedBytes(buffer, result);
+    count -= result;
+  }
+
+  return 1;
+}
+
+size_t
+readBrailleFrame (
+  BrailleDisplay *brl,
+  GioEndpoint *endpoint,
+  void *packet, size_t size,
+  const BrailleFrameDescription *frame, void *data
+) {
+  if (!endpoint) endpoint = brl->gioEndpoint;
+
+  unsigned char *bytes = packet;
+  unsigned char byte;
+  int haveLead = 0;
+
+  while (1) {
+    if (!haveLead) {
+      if (!gioReadByte(endpoint, &byte, 0)) return 0;
+    }
+
+    haveLead = 0;
+    const BrailleFrameType *type = getBrailleFrameType(frame, byte);
+
+    if (!type) {
+      logIgnoredByte(byte);
+      continue;
+    }
+
+    size_t length = type->size;
+    size_t count = 0;
+
+    if (length > size) {
+      logTruncatedPacket(&byte, 1);
+      continue;
+    }
+
+    bytes[count++] = byte;
+
+    if (type->lengthOffset) {
+      /* the rest of the frame is read as one block once its length is known */
+      if (!readBrailleFrameBytes(endpoint, bytes, &count, (type->lengthOffset + 1))) return 0;
+      length += bytes[type->lengthOffset];
+    }
+
+    if (length > size) {
+      logTruncatedPacket(bytes, count);
+      if (!discardBrailleFrameBytes(endpoint, (length - count))) return 0;
+      continue;
+    }
+
+    if (!readBrailleFrameBytes(endpoint, bytes, &count, length)) return 0;
+
+    if (type->hasTrailer && (bytes[length-1] != type->trailer)) {
+      /* the unexpected byte might be the start of the next frame */
+      logShortPacket(bytes, length-1);
+      byte = bytes[length-1];
+      haveLead = 1;
+      continue;
+    }
+
+    if (frame->verifyFrame) {
+      size_t expected = length;
+
+      if (frame->verifyFrame(brl, bytes, length, &expected, data) == BRL_PVR_INVALID) {
+        continue;
+      }
+    }
+
+    logInputPacket(bytes, length);
+    return length;
+  }
+}
+
 int
 writeBraillePacket (
   BrailleDisplay *brl, GioEndpoint *endpoint,
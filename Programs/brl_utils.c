@@ -26,17 +26,31 @@
 #include "brl_utils.h"
 #include "brl_dots.h"
 #include "async_wait.h"
+#include "io_generic.h"
 #include "ktb.h"
 
 void
 drainBrailleOutput (BrailleDisplay *brl, int minimumDelay) {
   int duration = brl->writeDelay + 1;
 
+  if (brl->gioEndpoint) gioFlushOutput(brl->gioEndpoint);
+
   brl->writeDelay = 0;
   if (duration < minimumDelay) duration = minimumDelay;
   asyncWait(duration);
 }
 
+void
+beginBrailleOutput (BrailleDisplay *brl) {
+  if (brl->gioEndpoint) gioBeginOutput(brl->gioEndpoint);
+}
+
+int
+endBrailleOutput (BrailleDisplay *brl) {
+  if (brl->gioEndpoint) return gioEndOutput(brl->gioEndpoint);
+  return 1;
+}
+
 void
 announceBrailleOffline (void) {
   logMessage(LOG_DEBUG, "braille is offline");
@@ -300,6 +300,20 @@ struct brlapi_handle_t { /* Connection-specific information */
   struct brlapi_parameterCallback_t *nextCallback;
 
   void *clientData; /* Private client data */
+
+  /* window as last sent through a patch, to only send what changes next: text,
+   * then and mask, then or mask, also protected by fileDescriptor_mutex */
+  uint32_t *lastWindow;
+  unsigned int lastWindowCells;
+  int lastWindowCursor; /* BRLAPI_CURSOR_LEAVE if unknown */
+  int lastWindowValid;
+
+#ifdef BRLAPI_SHARED_WINDOW
+  /* window shared with the server, also protected by fileDescriptor_mutex */
+  volatile brlapi_sharedWindowHeader_t *sharedWindow;
+  size_t sharedWindowSize;
+  unsigned int sharedWindowCells;
+#endif /* BRLAPI_SHARED_WINDOW */
 };
 
 /* Function brlapi_getLibraryVersion */
@@ -339,6 +353,15 @@ static void brlapi_initializeHandle(brlapi_handle_t *handle)
   handle->altSem = NULL;
   handle->state = 0;
   pthread_mutex_init(&handle->state_mutex, NULL);
+  handle->lastWindow = NULL;
+  handle->lastWindowCells = 0;
+  handle->lastWindowCursor = BRLAPI_CURSOR_LEAVE;
+  handle->lastWindowValid = 0;
+#ifdef BRLAPI_SHARED_WINDOW
+  handle->sharedWindow = NULL;
+  handle->sharedWindowSize = 0;
+  handle->sharedWindowCells = 0;
+#endif /* BRLAPI_SHARED_WINDOW */
 
 #ifdef LC_GLOBAL_LOCALE
   handle->default_locale = LC_GLOBAL_LOCALE;
@@ -490,6 +513,29 @@ static ssize_t brlapi__doWaitForPacket(brlapi_handle_t *handle, brlapi_packetTyp
     pthread_mutex_unlock(&handle->read_mutex);
     return -3;
   }
+  if ((type==BRLAPI_PACKET_KEYS) && (handle->state & STCONTROLLINGTTY) && !(size%sizeof(brlapi_keyCode_t))) {
+    /* several keypresses, buffer them */
+    uint32_t *key;
+    for (key = uint32Packet; key < uint32Packet + size/sizeof(*uint32Packet); key += 2) {
+      if (handle->keybuf_nb>=BRL_KEYBUF_SIZE) {
+        syslog(LOG_WARNING,"lost key: 0X%8lx%8lx\n",(unsigned long)ntohl(key[0]),(unsigned long)ntohl(key[1]));
+      } else {
+        handle->keybuf[(handle->keybuf_next+handle->keybuf_nb++)%BRL_KEYBUF_SIZE]
+            = brlapi_packetToKeyCode(key);
+      }
+    }
+    if (handle->altSem && handle->altExpectedPacketType==BRLAPI_PACKET_KEY) {
+      /* Wake up the alternate key reader so that it gets the buffered keys */
+      *handle->altRes = -3;
+#ifndef WINDOWS
+      if (sem_post)
+#endif /* WINDOWS */
+        sem_post(handle->altSem);
+      handle->altSem = NULL;
+    }
+    pthread_mutex_unlock(&handle->read_mutex);
+    return -3;
+  }
   if (type==BRLAPI_PACKET_PARAM_UPDATE) {
     /* Parameter update, find handler */
     brlapi_paramValuePacket_t *value = (void*) handle->packet.content;
@@ -1142,6 +1188,29 @@ brlapi_fileDescriptor BRLAPI_STDCALL brlapi_getFileDescriptor(void)
   return brlapi__getFileDescriptor(&defaultHandle);
 }
 
+/* brlapi__forgetLastWindow */
+/* Forgets what the server window contains, so that the next write sends it */
+/* entirely. Must be called with fileDescriptor_mutex held */
+static void brlapi__forgetLastWindow(brlapi_handle_t *handle)
+{
+  handle->lastWindowValid = 0;
+  handle->lastWindowCursor = BRLAPI_CURSOR_LEAVE;
+}
+
+#ifdef BRLAPI_SHARED_WINDOW
+/* brlapi__closeSharedWindow */
+/* Forgets the shared window, the server does the same when leaving tty mode */
+static void brlapi__closeSharedWindow(brlapi_handle_t *handle)
+{
+  pthread_mutex_lock(&handle->fileDescriptor_mutex);
+  if (handle->sharedWindow) {
+    munmap((void *) handle->sharedWindow, handle->sharedWindowSize);
+    handle->sharedWindow = NULL;
+  }
+  pthread_mutex_unlock(&handle->fileDescriptor_mutex);
+}
+#endif /* BRLAPI_SHARED_WINDOW */
+
 /* brlapi_closeConnection */
 /* Cleanly close the socket */
 void BRLAPI_STDCALL brlapi__closeConnection(brlapi_handle_t *handle)
@@ -1149,9 +1218,16 @@ void BRLAPI_STDCALL brlapi__closeConnection(brlapi_handle_t *handle)
   pthread_mutex_lock(&handle->state_mutex);
   handle->state = 0;
   pthread_mutex_unlock(&handle->state_mutex);
+#ifdef BRLAPI_SHARED_WINDOW
+  brlapi__closeSharedWindow(handle);
+#endif /* BRLAPI_SHARED_WINDOW */
   pthread_mutex_lock(&handle->fileDescriptor_mutex);
   closeFileDescriptor(handle->fileDescriptor);
   handle->fileDescriptor = BRLAPI_INVALID_FILE_DESCRIPTOR;
+  free(handle->lastWindow);
+  handle->lastWindow = NULL;
+  handle->lastWindowCells = 0;
+  brlapi__forgetLastWindow(handle);
   pthread_mutex_unlock(&handle->fileDescriptor_mutex);
 
 #ifdef LC_GLOBAL_LOCALE
@@ -1721,6 +1797,10 @@ int BRLAPI_STDCALL brlapi__enterTtyModeWithPath(brlapi_handle_t *handle, const i
   handle->keybuf_next = handle->keybuf_nb = 0;
   pthread_mutex_unlock(&handle->read_mutex);
 
+  pthread_mutex_lock(&handle->fileDescriptor_mutex);
+  brlapi__forgetLastWindow(handle);
+  pthread_mutex_unlock(&handle->fileDescriptor_mutex);
+
   /* OK, Now we know where we are, so get the effective control of the terminal! */
   ttytreepath = getenv("WINDOWPATH");
   if (!ttytreepath && (getenv("DISPLAY") || getenv("WAYLAND_DISPLAY"))) {
@@ -1864,6 +1944,9 @@ int BRLAPI_STDCALL brlapi__leaveTtyMode(brlapi_handle_t *handle)
     res = -1;
     goto out;
   }
+#ifdef BRLAPI_SHARED_WINDOW
+  brlapi__closeSharedWindow(handle);
+#endif /* BRLAPI_SHARED_WINDOW */
   handle->brlx = 0; handle->brly = 0;
   res = brlapi__writePacketWaitForAck(handle,BRLAPI_PACKET_LEAVETTYMODE,NULL,0);
   handle->state &= ~STCONTROLLINGTTY;
@@ -1935,6 +2018,364 @@ static size_t getCharset(brlapi_handle_t *handle, void *buffer, int wide) {
   return p-start;
 }
 
+/* brlapi_isUtf8Charset */
+/* Tells whether the given charset name designates UTF-8 */
+static int brlapi_isUtf8Charset(const char *charset, size_t length)
+{
+  return ((length == 5) && !strncasecmp(charset, "UTF-8", length))
+      || ((length == 4) && !strncasecmp(charset, "UTF8", length));
+}
+
+/* brlapi__isLocaleUtf8 */
+/* Tells whether the charset of the current locale is UTF-8 */
+static int brlapi__isLocaleUtf8(brlapi_handle_t *handle)
+{
+  unsigned char charset[0X100];
+  size_t length;
+
+#ifdef LC_GLOBAL_LOCALE
+  locale_t old_locale = 0;
+
+  if (handle->default_locale != LC_GLOBAL_LOCALE) {
+    /* Temporarily load the default locale.  */
+    old_locale = uselocale(handle->default_locale);
+  }
+#endif /* LC_GLOBAL_LOCALE */
+
+  length = getCharset(handle, charset, 0);
+
+#ifdef LC_GLOBAL_LOCALE
+  if (handle->default_locale != LC_GLOBAL_LOCALE) {
+    /* Restore application locale */
+    uselocale(old_locale);
+  }
+#endif /* LC_GLOBAL_LOCALE */
+
+  return length && brlapi_isUtf8Charset((const char *) &charset[1], charset[0]);
+}
+
+/* brlapi_getUtf8Character */
+/* Decodes one UTF-8 character, returns its length, or 0 if it is invalid */
+static size_t brlapi_getUtf8Character(const unsigned char *bytes, size_t size, uint32_t *character)
+{
+  uint32_t c = bytes[0];
+  size_t length, i;
+
+  if (c < 0X80) {
+    *character = c;
+    return 1;
+  }
+
+  if ((c & 0XE0) == 0XC0) {
+    length = 2;
+    c &= 0X1F;
+  } else if ((c & 0XF0) == 0XE0) {
+    length = 3;
+    c &= 0X0F;
+  } else if ((c & 0XF8) == 0XF0) {
+    length = 4;
+    c &= 0X07;
+  } else {
+    return 0;
+  }
+
+  if (length > size) return 0;
+
+  for (i=1; i<length; i+=1) {
+    if ((bytes[i] & 0XC0) != 0X80) return 0;
+    c = (c << 6) | (bytes[i] & 0X3F);
+  }
+
+  *character = c;
+  return length;
+}
+
+/* brlapi__isUnicodeWrite */
+/* Tells whether the text of a write can be decoded here, i.e. whether it is */
+/* made of wide characters or is in UTF-8 */
+static int brlapi__isUnicodeWrite(brlapi_handle_t *handle, const brlapi_writeArguments_t *s, int wide)
+{
+  if (s->displayNumber != BRLAPI_DISPLAY_DEFAULT) return 0;
+
+  if (s->text && !wide) {
+    if (!s->charset) return 0;
+
+    if (*s->charset) {
+      if (!brlapi_isUtf8Charset(s->charset, strlen(s->charset))) return 0;
+    } else if (!brlapi__isLocaleUtf8(handle)) {
+      return 0;
+    }
+  }
+
+  if (wide && (sizeof(wchar_t) != sizeof(uint32_t))) return 0;
+  return 1;
+}
+
+/* brlapi_applyWrite */
+/* Applies the arguments of a Unicode write to a window of the given number */
+/* of cells, the same way the server does, and sets the modified region (its */
+/* size is 0 if only the cursor is to be changed). The cursor itself is left */
+/* to the caller. */
+/* Returns 0 if the arguments are invalid, in which case the window may have */
+/* been partly modified. */
+static int brlapi_applyWrite(const brlapi_writeArguments_t *s, int wide, unsigned int cells, uint32_t *text, unsigned char *andMask, unsigned char *orMask, unsigned int *begin, unsigned int *size)
+{
+  unsigned int rbeg, rsiz, rsizFilled, textCount = 0;
+  size_t textLeft = 0;
+  int fill;
+
+  rbeg = s->regionBegin;
+  if (rbeg || s->regionSize) {
+    if (!s->regionSize) return 0;
+    fill = s->regionSize < 0;
+    rsiz = fill? -s->regionSize: s->regionSize;
+  } else {
+    /* DEPRECATED */
+    rbeg = 1;
+    rsiz = cells;
+    fill = 1;
+  }
+
+  if ((rbeg < 1) || (rbeg > cells) || (rsiz > cells - rbeg + 1)) return 0;
+  rsizFilled = fill? cells - rbeg + 1: rsiz;
+
+  if (!((s->cursor >= 0) && (s->cursor <= cells)) && (s->cursor != BRLAPI_CURSOR_LEAVE)) return 0;
+
+  if (s->text) {
+    uint32_t *character = text + rbeg - 1;
+
+    if (wide) {
+      const wchar_t *in = (const wchar_t *) s->text;
+      size_t count = (s->textSize != -1)? s->textSize / sizeof(wchar_t): wcslen(in);
+
+      textCount = MIN(count, rsizFilled);
+      textLeft = count - textCount;
+      while (character < text + rbeg - 1 + textCount) *character++ = *in++;
+    } else {
+      const unsigned char *in = (const unsigned char *) s->text;
+      size_t size = (s->textSize != -1)? s->textSize: strlen(s->text);
+
+      while ((textCount < rsizFilled) && size) {
+        size_t length = brlapi_getUtf8Character(in, size, character);
+        if (!length) return 0;
+
+        in += length;
+        size -= length;
+        character += 1;
+        textCount += 1;
+      }
+
+      textLeft = size;
+    }
+
+    if (!fill) {
+      if (textLeft || (textCount != rsiz)) return 0;
+    } else if (!textLeft && (s->andMask || s->orMask) && (textCount != rsiz)) {
+      return 0;
+    }
+
+    if (fill)
+      while (character < text + cells) *character++ = ' ';
+
+    if (!s->andMask) memset(andMask+rbeg-1, 0XFF, rsizFilled);
+    if (!s->orMask) memset(orMask+rbeg-1, 0X00, rsizFilled);
+    if (fill) memset(andMask+rbeg-1+rsiz, 0X00, rsizFilled-rsiz);
+  }
+
+  if (s->andMask) {
+    memcpy(andMask+rbeg-1, s->andMask, rsiz);
+    memset(andMask+rbeg-1+rsiz, 0X00, rsizFilled-rsiz);
+  }
+
+  if (s->orMask) {
+    memcpy(orMask+rbeg-1, s->orMask, rsiz);
+    memset(orMask+rbeg-1+rsiz, 0X00, rsizFilled-rsiz);
+  }
+
+  *begin = rbeg;
+  *size = (s->text || s->andMask || s->orMask)? rsizFilled: 0;
+  return 1;
+}
+
+/* Unchanged cells between two changes are sent along with them rather than */
+/* starting a new run, as long as there are no more than this many */
+#define BRLAPI_WRITEPATCH_MAXGAP 2
+
+/* brlapi__writePatch */
+/* Performs a write by only sending the cells which changed since the */
+/* previous one, if the arguments can be expressed that way, i.e. the text is */
+/* Unicode and either the previous window is known or the whole window is */
+/* written. */
+/* Returns 1 and sets *result if the write was done, and 0 if it has to be */
+/* sent the usual way instead (which also reports invalid arguments). */
+static int brlapi__writePatch(brlapi_handle_t *handle, const brlapi_writeArguments_t *s, int wide, int *result)
+{
+  unsigned int cells = handle->brlx * handle->brly;
+  unsigned int rbeg, rsiz, next, runs = 0;
+  uint32_t flags = 0;
+  uint32_t *oldText;
+  unsigned char *oldAndMask, *oldOrMask;
+  brlapi_packet_t packet;
+  brlapi_writePatchPacket_t *wp = &packet.writePatch;
+  unsigned char *p = &wp->data;
+  unsigned char *end = (unsigned char*) &packet.data[sizeof(packet)];
+  int valid;
+
+  if (!s || !cells || (handle->serverVersion < 9)) return 0;
+  if (!brlapi__isUnicodeWrite(handle, s, wide)) return 0;
+
+  uint32_t text[cells];
+  unsigned char andMask[cells];
+  unsigned char orMask[cells];
+
+  pthread_mutex_lock(&handle->fileDescriptor_mutex);
+  if (handle->lastWindowCells != cells) {
+    free(handle->lastWindow);
+    handle->lastWindowCells = 0;
+    brlapi__forgetLastWindow(handle);
+    if (!(handle->lastWindow = malloc(cells * (sizeof(*text) + 2)))) goto unsuitable;
+    handle->lastWindowCells = cells;
+  }
+
+  oldText = handle->lastWindow;
+  oldAndMask = (unsigned char *) (oldText + cells);
+  oldOrMask = oldAndMask + cells;
+  valid = handle->lastWindowValid;
+
+  if (valid) {
+    memcpy(text, oldText, sizeof(text));
+    memcpy(andMask, oldAndMask, cells);
+    memcpy(orMask, oldOrMask, cells);
+  }
+
+  if (!brlapi_applyWrite(s, wide, cells, text, andMask, orMask, &rbeg, &rsiz)) goto unsuitable;
+  if (!valid && (!s->text || (rbeg != 1) || (rsiz != cells))) goto unsuitable;
+
+  if ((s->cursor != BRLAPI_CURSOR_LEAVE) && (s->cursor != handle->lastWindowCursor)) {
+    flags |= BRLAPI_WPF_CURSOR;
+    wp->cursor = htonl(s->cursor);
+  } else {
+    wp->cursor = 0;
+  }
+
+#define CELL_CHANGED(i) (!valid || (text[i] != oldText[i]) || \
+                         (andMask[i] != oldAndMask[i]) || (orMask[i] != oldOrMask[i]))
+  next = 0;
+  while (1) {
+    unsigned int begin, after, i;
+    size_t runSize;
+
+    while ((next < cells) && !CELL_CHANGED(next)) next += 1;
+    if (next == cells) break;
+
+    begin = next;
+    after = begin + 1;
+    for (next=after; (next < cells) && (next - after <= BRLAPI_WRITEPATCH_MAXGAP); next+=1)
+      if (CELL_CHANGED(next)) after = next + 1;
+    next = after;
+
+    runSize = BRLAPI_WRITEPATCH_RUN_SIZE(after - begin);
+    if (p + runSize > end) goto unsuitable;
+    memset(p, 0, runSize);
+    *((uint32_t *) p) = htonl(begin + 1); p += sizeof(uint32_t);
+    *((uint32_t *) p) = htonl(after - begin); p += sizeof(uint32_t);
+    for (i=begin; i<after; i+=1) {
+      *((uint32_t *) p) = htonl(text[i]); p += sizeof(uint32_t);
+    }
+    memcpy(p, andMask+begin, after-begin); p += after-begin;
+    memcpy(p, orMask+begin, after-begin); p += after-begin;
+    p = &wp->data + ((p - &wp->data + 3) & ~3);
+    runs += 1;
+  }
+#undef CELL_CHANGED
+
+  if (!runs && !flags) {
+    /* The server already has this window */
+    *result = 0;
+    goto done;
+  }
+
+  wp->flags = htonl(flags);
+  wp->runs = htonl(runs);
+  *result = brlapi_writePacket(handle->fileDescriptor, BRLAPI_PACKET_WRITEPATCH, &packet, p - packet.data);
+
+  if (*result < 0) {
+    brlapi__forgetLastWindow(handle);
+  } else {
+    memcpy(oldText, text, sizeof(text));
+    memcpy(oldAndMask, andMask, cells);
+    memcpy(oldOrMask, orMask, cells);
+    handle->lastWindowValid = 1;
+    if (flags & BRLAPI_WPF_CURSOR) handle->lastWindowCursor = s->cursor;
+  }
+
+done:
+  pthread_mutex_unlock(&handle->fileDescriptor_mutex);
+  return 1;
+
+unsuitable:
+  pthread_mutex_unlock(&handle->fileDescriptor_mutex);
+  return 0;
+}
+
+#ifdef BRLAPI_SHARED_WINDOW
+/* brlapi__writeSharedWindow */
+/* Performs a write through the shared window, if there is one and if the */
+/* arguments can be expressed there, i.e. the text is Unicode. */
+/* Returns 1 and sets *result if the write was done, and 0 if it has to be */
+/* sent the usual way instead (which also reports invalid arguments). */
+static int brlapi__writeSharedWindow(brlapi_handle_t *handle, const brlapi_writeArguments_t *s, int wide, int *result)
+{
+  volatile brlapi_sharedWindowHeader_t *header;
+  unsigned int cells, rbeg, rsiz;
+  uint32_t *text;
+  unsigned char *andMask, *orMask;
+  brlapi_packet_t packet;
+  brlapi_sharedUpdatePacket_t *su = &packet.sharedUpdate;
+
+  if (!handle->sharedWindow || !s) return 0;
+  if (!brlapi__isUnicodeWrite(handle, s, wide)) return 0;
+
+  pthread_mutex_lock(&handle->fileDescriptor_mutex);
+  if (!(header = handle->sharedWindow)) goto unsuitable;
+  cells = handle->sharedWindowCells;
+  if (cells != handle->brlx * handle->brly) goto unsuitable;
+
+  text = (uint32_t *) (header + 1);
+  andMask = (unsigned char *) (text + cells);
+  orMask = andMask + cells;
+
+  /* Tell the server that the window is being modified */
+  header->sequence += 1;
+  __sync_synchronize();
+
+  if (!brlapi_applyWrite(s, wide, cells, text, andMask, orMask, &rbeg, &rsiz)) goto invalid;
+  if (s->cursor != BRLAPI_CURSOR_LEAVE) header->cursor = s->cursor;
+
+  __sync_synchronize();
+  header->sequence += 1;
+
+  su->flags = htonl((s->cursor != BRLAPI_CURSOR_LEAVE)? BRLAPI_SUF_CURSOR: 0);
+  su->regionBegin = htonl(rsiz? rbeg: 0);
+  su->regionSize = htonl(rsiz);
+  *result = brlapi_writePacket(handle->fileDescriptor, BRLAPI_PACKET_SHAREDUPDATE, su, sizeof(*su));
+
+  /* Patches are computed against what was written without the shared window */
+  brlapi__forgetLastWindow(handle);
+  pthread_mutex_unlock(&handle->fileDescriptor_mutex);
+  return 1;
+
+invalid:
+  /* Only the cells of the region get read by the server, let it complain */
+  __sync_synchronize();
+  header->sequence += 1;
+
+unsuitable:
+  pthread_mutex_unlock(&handle->fileDescriptor_mutex);
+  return 0;
+}
+#endif /* BRLAPI_SHARED_WINDOW */
+
 /* Function : brlapi_writeText */
 /* Writes a string to the braille display */
 static int brlapi___writeText(brlapi_handle_t *handle, int cursor, const void *str, int wide)
@@ -1946,6 +2387,19 @@ static int brlapi___writeText(brlapi_handle_t *handle, int cursor, const void *s
   int res;
   size_t len;
 
+  if (dispSize) {
+    brlapi_writeArguments_t arguments = BRLAPI_WRITEARGUMENTS_INITIALIZER;
+    arguments.regionBegin = 1;
+    arguments.regionSize = -dispSize;
+    arguments.text = str;
+    arguments.cursor = cursor;
+    arguments.charset = "";
+#ifdef BRLAPI_SHARED_WINDOW
+    if (brlapi__writeSharedWindow(handle, &arguments, wide, &res)) return res;
+#endif /* BRLAPI_SHARED_WINDOW */
+    if (brlapi__writePatch(handle, &arguments, wide, &res)) return res;
+  }
+
 #ifdef LC_GLOBAL_LOCALE
   locale_t old_locale = 0;
 
@@ -1990,6 +2444,7 @@ static int brlapi___writeText(brlapi_handle_t *handle, int cursor, const void *s
 
   wa->flags = htonl(wa->flags);
   pthread_mutex_lock(&handle->fileDescriptor_mutex);
+  brlapi__forgetLastWindow(handle);
   res = brlapi_writePacket(handle->fileDescriptor,BRLAPI_PACKET_WRITE,&packet,sizeof(wa->flags)+(p-&wa->data));
   pthread_mutex_unlock(&handle->fileDescriptor_mutex);
 
@@ -2117,12 +2572,16 @@ int brlapi__write(brlapi_handle_t *handle, const brlapi_writeArguments_t *s)
 #ifndef WINDOWS
   int wide = 0;
 #endif /* WINDOWS */
+  if (s && s->regionBegin && !s->regionSize) return 0;
+#ifdef BRLAPI_SHARED_WINDOW
+  if (brlapi__writeSharedWindow(handle, s, wide, &res)) return res;
+#endif /* BRLAPI_SHARED_WINDOW */
+  if (brlapi__writePatch(handle, s, wide, &res)) return res;
   wa->flags = 0;
   if (s==NULL) goto send;
   rbeg = s->regionBegin;
   rsiz = s->regionSize;
   if (rbeg || rsiz) {
-    if (rsiz == 0) return 0;
     wa->flags |= BRLAPI_WF_REGION;
     *((uint32_t *) p) = htonl(rbeg); p += sizeof(uint32_t);
     *((uint32_t *) p) = htonl((int32_t) rsiz); p += sizeof(uint32_t);
@@ -2225,6 +2684,7 @@ int brlapi__write(brlapi_handle_t *handle, const brlapi_writeArguments_t *s)
 send:
   wa->flags = htonl(wa->flags);
   pthread_mutex_lock(&handle->fileDescriptor_mutex);
+  brlapi__forgetLastWindow(handle);
   res = brlapi_writePacket(handle->fileDescriptor,BRLAPI_PACKET_WRITE,&packet,sizeof(wa->flags)+(p-&wa->data));
   pthread_mutex_unlock(&handle->fileDescriptor_mutex);
   return res;
@@ -2242,6 +2702,186 @@ int brlapi_write(const brlapi_writeArguments_t *s)
 }
 #endif /* WINDOWS */
 
+#ifdef BRLAPI_SHARED_WINDOW
+/* brlapi_writePacketWithDescriptor */
+/* Write a packet on the socket, passing a file descriptor along */
+static int brlapi_writePacketWithDescriptor(brlapi_fileDescriptor fd, brlapi_packetType_t type, const void *buf, size_t size, int descriptor)
+{
+  uint32_t header[2] = { htonl(size), htonl(type) };
+  struct iovec iov[2] = {
+    { .iov_base = header, .iov_len = sizeof(header) },
+    { .iov_base = (void *) buf, .iov_len = size }
+  };
+
+  union {
+    struct cmsghdr header;
+    char buffer[CMSG_SPACE(sizeof(int))];
+  } control;
+
+  struct msghdr msg = {
+    .msg_iov = iov,
+    .msg_iovlen = 2,
+    .msg_control = control.buffer,
+    .msg_controllen = sizeof(control.buffer)
+  };
+
+  struct cmsghdr *cmsg;
+  ssize_t res;
+
+  memset(&control, 0, sizeof(control));
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &descriptor, sizeof(int));
+
+  do {
+    res = sendmsg(fd, &msg, 0);
+  } while ((res == -1) && (errno == EINTR));
+
+  if (res == -1) {
+    LibcError("sendmsg in writePacketWithDescriptor");
+    return -1;
+  }
+
+  /* the descriptor went with the first byte, send what may remain */
+  if (res < sizeof(header)) {
+    if (brlapi_writeFile(fd, (unsigned char *) header + res, sizeof(header) - res) < 0) goto error;
+    res = 0;
+  } else {
+    res -= sizeof(header);
+  }
+
+  if (res < size)
+    if (brlapi_writeFile(fd, (const unsigned char *) buf + res, size - res) < 0) goto error;
+
+  return 0;
+
+error:
+  LibcError("write in writePacketWithDescriptor");
+  return -1;
+}
+#endif /* BRLAPI_SHARED_WINDOW */
+
+/* Function : brlapi_openSharedWindow */
+/* Makes the server read the braille window from shared memory */
+int BRLAPI_STDCALL brlapi__openSharedWindow(brlapi_handle_t *handle)
+{
+#ifdef BRLAPI_SHARED_WINDOW
+  brlapi_packet_t packet;
+  brlapi_sharedWindowPacket_t *sw = &packet.sharedWindow;
+  unsigned int cells;
+  size_t size;
+  int fd;
+  void *address;
+  int res = -1;
+
+  pthread_mutex_lock(&handle->state_mutex);
+
+  if (!(handle->state & STCONTROLLINGTTY)) {
+    brlapi_errno = BRLAPI_ERROR_ILLEGAL_INSTRUCTION;
+    goto out;
+  }
+
+  if ((handle->serverVersion < 9) || (handle->addrfamily != PF_LOCAL)) {
+    brlapi_errno = BRLAPI_ERROR_OPNOTSUPP;
+    goto out;
+  }
+
+  if (handle->sharedWindow) {
+    res = 0;
+    goto out;
+  }
+
+  if (!(cells = handle->brlx * handle->brly)) {
+    brlapi_errno = BRLAPI_ERROR_INVALID_PARAMETER;
+    goto out;
+  }
+  size = BRLAPI_SHAREDWINDOW_SIZE(cells);
+
+  if ((fd = memfd_create("brlapi-window", MFD_CLOEXEC | MFD_ALLOW_SEALING)) == -1) {
+    LibcError("memfd_create");
+    goto out;
+  }
+
+  /* the server refuses windows which could be shrunk under its feet */
+  if ((ftruncate(fd, size) == -1) ||
+      (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1)) {
+    LibcError("ftruncate/fcntl on shared window");
+    goto outfd;
+  }
+
+  if ((address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    LibcError("mmap");
+    goto outfd;
+  }
+
+  {
+    brlapi_sharedWindowHeader_t *header = address;
+    uint32_t *text = (uint32_t *) (header + 1);
+    unsigned char *andMask = (unsigned char *) (text + cells);
+    unsigned int i;
+
+    header->sequence = 0;
+    header->cursor = BRLAPI_CURSOR_OFF;
+    for (i=0; i<cells; i+=1) text[i] = ' ';
+    memset(andMask, 0XFF, cells);
+    memset(andMask + cells, 0X00, cells);
+  }
+
+  sw->magic = htonl(BRLAPI_SHAREDWINDOW_MAGIC);
+  sw->cells = htonl(cells);
+
+  pthread_mutex_lock(&handle->req_mutex);
+  pthread_mutex_lock(&handle->fileDescriptor_mutex);
+  res = brlapi_writePacketWithDescriptor(handle->fileDescriptor, BRLAPI_PACKET_SHAREDWINDOW, sw, sizeof(*sw), fd);
+  pthread_mutex_unlock(&handle->fileDescriptor_mutex);
+  if (res >= 0) res = brlapi__waitForAck(handle);
+  pthread_mutex_unlock(&handle->req_mutex);
+
+  if (res < 0) {
+    munmap(address, size);
+  } else {
+    pthread_mutex_lock(&handle->fileDescriptor_mutex);
+    handle->sharedWindow = address;
+    handle->sharedWindowSize = size;
+    handle->sharedWindowCells = cells;
+    pthread_mutex_unlock(&handle->fileDescriptor_mutex);
+  }
+
+outfd:
+  close(fd);
+out:
+  pthread_mutex_unlock(&handle->state_mutex);
+  return res;
+#else /* BRLAPI_SHARED_WINDOW */
+  brlapi_errno = BRLAPI_ERROR_OPNOTSUPP;
+  return -1;
+#endif /* BRLAPI_SHARED_WINDOW */
+}
+
+int BRLAPI_STDCALL brlapi_openSharedWindow(void)
+{
+  return brlapi__openSharedWindow(&defaultHandle);
+}
+
+/* Function : brlapi__getBufferedKeys */
+/* Takes up to max keys which were already received */
+static size_t brlapi__getBufferedKeys(brlapi_handle_t *handle, brlapi_keyCode_t *codes, size_t max)
+{
+  size_t count = 0;
+
+  pthread_mutex_lock(&handle->read_mutex);
+  while ((count < max) && (handle->keybuf_nb > 0)) {
+    codes[count++] = handle->keybuf[handle->keybuf_next];
+    handle->keybuf_next = (handle->keybuf_next+1)%BRL_KEYBUF_SIZE;
+    handle->keybuf_nb--;
+  }
+  pthread_mutex_unlock(&handle->read_mutex);
+
+  return count;
+}
+
 /* Function : brlapi_readKey */
 /* Reads a key from the braille keyboard */
 int BRLAPI_STDCALL brlapi__readKeyWithTimeout(brlapi_handle_t *handle, int timeout_ms, brlapi_keyCode_t *code)
@@ -2257,20 +2897,14 @@ int BRLAPI_STDCALL brlapi__readKeyWithTimeout(brlapi_handle_t *handle, int timeo
   }
   pthread_mutex_unlock(&handle->state_mutex);
 
-  pthread_mutex_lock(&handle->read_mutex);
-  if (handle->keybuf_nb>0) {
-    *code=handle->keybuf[handle->keybuf_next];
-    handle->keybuf_next=(handle->keybuf_next+1)%BRL_KEYBUF_SIZE;
-    handle->keybuf_nb--;
-    pthread_mutex_unlock(&handle->read_mutex);
-    return 1;
-  }
-  pthread_mutex_unlock(&handle->read_mutex);
+  if (brlapi__getBufferedKeys(handle, code, 1)) return 1;
 
   pthread_mutex_lock(&handle->key_mutex);
   res = brlapi__waitForPacket(handle,BRLAPI_PACKET_KEY, buf, sizeof(buf), TRY_WAIT_FOR_EXPECTED_PACKET, timeout_ms);
   pthread_mutex_unlock(&handle->key_mutex);
   if (res == -3) {
+    /* Several keys may have been received at once */
+    if (brlapi__getBufferedKeys(handle, code, 1)) return 1;
     if (timeout_ms == 0) return 0;
     brlapi_libcerrno = EINTR;
     brlapi_errno = BRLAPI_ERROR_LIBCERR;
@@ -2291,6 +2925,34 @@ int BRLAPI_STDCALL brlapi_readKeyWithTimeout(int timeout_ms, brlapi_keyCode_t *c
   return brlapi__readKeyWithTimeout(&defaultHandle, timeout_ms, code);
 }
 
+/* Function : brlapi_readKeys */
+/* Reads all the keys which are already available, waiting for the first one */
+ssize_t BRLAPI_STDCALL brlapi__readKeys(brlapi_handle_t *handle, brlapi_keyCode_t *codes, size_t max, int timeout_ms)
+{
+  size_t count;
+  int res;
+
+  if (!max) return 0;
+  res = brlapi__readKeyWithTimeout(handle, timeout_ms, &codes[0]);
+  if (res <= 0) return res;
+  count = 1;
+
+  /* Errors are left for the next call since we already have some keys */
+  while (count < max) {
+    count += brlapi__getBufferedKeys(handle, &codes[count], max-count);
+    if (count == max) break;
+    if (brlapi__readKeyWithTimeout(handle, 0, &codes[count]) <= 0) break;
+    count++;
+  }
+
+  return count;
+}
+
+ssize_t BRLAPI_STDCALL brlapi_readKeys(brlapi_keyCode_t *codes, size_t max, int timeout_ms)
+{
+  return brlapi__readKeys(&defaultHandle, codes, max, timeout_ms);
+}
+
 int BRLAPI_STDCALL brlapi__readKey(brlapi_handle_t *handle, int block, brlapi_keyCode_t *code)
 {
   return brlapi__readKeyWithTimeout(handle, block ? -1 : 0, code);
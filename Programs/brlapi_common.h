@@ -45,6 +45,11 @@
 #define PF_LOCAL PF_UNIX
 #endif /* !defined(PF_LOCAL) && defined(PF_UNIX) */
 
+#if defined(HAVE_MEMFD_CREATE) && defined(SCM_RIGHTS) && defined(F_SEAL_SHRINK)
+#define BRLAPI_SHARED_WINDOW
+#include <sys/mman.h>
+#endif /* shared window support */
+
 #ifndef MIN
 #define MIN(a, b) (((a) < (b))? (a): (b))
 #endif /* MIN */
@@ -87,13 +92,15 @@ static ssize_t brlapi_writeFile(brlapi_fileDescriptor fd, const void *buffer, si
     CloseHandle(overl.hEvent);
 #else /* __MINGW32__ */
     res=send(fd,buf+n,size-n,0);
-    if ((res<0) &&
-        (errno!=EINTR) &&
+    if (res<0) {
+      if ((errno!=EINTR) &&
 #ifdef EWOULDBLOCK
-        (errno!=EWOULDBLOCK) &&
+          (errno!=EWOULDBLOCK) &&
 #endif /* EWOULDBLOCK */
-        (errno!=EAGAIN)) { /* EAGAIN shouldn't happen, but who knows... */
-      return res;
+          (errno!=EAGAIN)) { /* EAGAIN shouldn't happen, but who knows... */
+        return res;
+      }
+      res = 0; /* nothing was written - try again */
     }
 #endif /* __MINGW32__ */
   }
@@ -164,6 +171,9 @@ typedef struct {
 #ifdef __MINGW32__
   OVERLAPPED overl;
 #endif /* __MINGW32__ */
+#ifdef BRLAPI_SHARED_WINDOW
+  int passedDescriptor; /* Descriptor received along with the packet, or -1 */
+#endif /* BRLAPI_SHARED_WINDOW */
 } Packet;
 
 /* Function: brlapi_resetPacket */
@@ -196,10 +206,63 @@ static int brlapi_initializePacket(Packet *packet)
     return -1;
   }
 #endif /* __MINGW32__ */
+#ifdef BRLAPI_SHARED_WINDOW
+  packet->passedDescriptor = -1;
+#endif /* BRLAPI_SHARED_WINDOW */
   brlapi_resetPacket(packet);
   return 0;
 }
 
+#ifdef BRLAPI_SHARED_WINDOW
+/* Function: brlapi_forgetPassedDescriptor */
+/* Closes the descriptor received along with a packet, if it wasn't taken */
+static void brlapi_forgetPassedDescriptor(Packet *packet)
+{
+  if (packet->passedDescriptor != -1) {
+    close(packet->passedDescriptor);
+    packet->passedDescriptor = -1;
+  }
+}
+
+/* Function: brlapi_receiveWithDescriptor */
+/* Reads like read(), but also gets a descriptor passed as ancillary data */
+static ssize_t brlapi_receiveWithDescriptor(Packet *packet, int fd, void *buffer, size_t size)
+{
+  union {
+    struct cmsghdr header;
+    char buffer[CMSG_SPACE(sizeof(int))];
+  } control;
+
+  struct iovec iov = {
+    .iov_base = buffer,
+    .iov_len = size
+  };
+
+  struct msghdr msg = {
+    .msg_iov = &iov,
+    .msg_iovlen = 1,
+    .msg_control = control.buffer,
+    .msg_controllen = sizeof(control.buffer)
+  };
+
+  ssize_t res = recvmsg(fd, &msg, 0);
+
+  if (res > 0) {
+    struct cmsghdr *cmsg;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if ((cmsg->cmsg_level == SOL_SOCKET) && (cmsg->cmsg_type == SCM_RIGHTS) &&
+          (cmsg->cmsg_len == CMSG_LEN(sizeof(int)))) {
+        brlapi_forgetPassedDescriptor(packet);
+        memcpy(&packet->passedDescriptor, CMSG_DATA(cmsg), sizeof(int));
+      }
+    }
+  }
+
+  return res;
+}
+#endif /* BRLAPI_SHARED_WINDOW */
+
 /* Function : readPacket */
 /* Reads a packet for the given connection */
 /* Returns -2 on EOF, -1 on error, 0 if the reading is not complete, */
@@ -222,6 +285,11 @@ read:
 #else /* __MINGW32__ */
   int res;
 read:
+#ifdef BRLAPI_SHARED_WINDOW
+  if ((packet->state == READING_HEADER) && !packet->readBytes)
+    res = brlapi_receiveWithDescriptor(packet, descriptor, packet->p, packet->n);
+  else
+#endif /* BRLAPI_SHARED_WINDOW */
   res = read(descriptor, packet->p, packet->n);
   if (res==-1) {
     switch (errno) {
@@ -492,6 +560,7 @@ static const brlapi_packetTypeEntry_t brlapi_packetTypeTable[] = {
   { BRLAPI_PACKET_SETFOCUS, "SetFocus" },
   { BRLAPI_PACKET_LEAVETTYMODE, "LeaveTtyMode" },
   { BRLAPI_PACKET_KEY, "Key" },
+  { BRLAPI_PACKET_KEYS, "Keys" },
   { BRLAPI_PACKET_IGNOREKEYRANGES, "IgnoreKeyRanges" },
   { BRLAPI_PACKET_ACCEPTKEYRANGES, "AcceptKeyRanges" },
   { BRLAPI_PACKET_WRITE, "Write" },
@@ -503,6 +572,9 @@ static const brlapi_packetTypeEntry_t brlapi_packetTypeTable[] = {
   { BRLAPI_PACKET_PARAM_VALUE, "ParameterValue" },
   { BRLAPI_PACKET_PARAM_REQUEST, "ParameterRequest" },
   { BRLAPI_PACKET_SYNCHRONIZE, "Synchronize" },
+  { BRLAPI_PACKET_SHAREDWINDOW, "SharedWindow" },
+  { BRLAPI_PACKET_SHAREDUPDATE, "SharedUpdate" },
+  { BRLAPI_PACKET_WRITEPATCH, "WritePatch" },
   { BRLAPI_PACKET_ACK, "Ack" },
   { BRLAPI_PACKET_ERROR, "Error" },
   { BRLAPI_PACKET_EXCEPTION, "Exception" },
@@ -687,6 +759,13 @@ static const brlapi_param_properties_t brlapi_param_properties[BRLAPI_PARAM_COUN
     .canWrite = 1,
   },
 
+  [BRLAPI_PARAM_KEY_BATCH_DELAY] = {
+    .type = BRLAPI_PARAM_TYPE_UINT32,
+    .canRead = 1,
+    .canWatch = 1,
+    .canWrite = 1,
+  },
+
 //Braille Rendering Parameters
   [BRLAPI_PARAM_COMPUTER_BRAILLE_CELL_SIZE] = {
     .type = BRLAPI_PARAM_TYPE_UINT8,
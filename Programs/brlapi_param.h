@@ -52,6 +52,7 @@ typedef enum {
 
 //Input Parameters
   BRLAPI_PARAM_RETAIN_DOTS = 10,		/**< Pass dot combinations (rather than characters): boolean */
+  BRLAPI_PARAM_KEY_BATCH_DELAY = 32,		/**< How long (in milliseconds) the server may hold keys back in order to deliver them together: uint32_t (0 means no delay) */
 
 //Braille Rendering Parameters
   BRLAPI_PARAM_COMPUTER_BRAILLE_CELL_SIZE = 11,	/**< Number of dots used to render a computer braille character: uint8_t (8 or 6) */
@@ -100,7 +101,7 @@ typedef enum {
 
  /* TODO: help strings */
 
-  BRLAPI_PARAM_COUNT = 32 /** Number of parameters */
+  BRLAPI_PARAM_COUNT = 33 /** Number of parameters */
 } brlapi_param_t;
 
 /* brlapi_param_subparam_t */
@@ -171,6 +172,10 @@ typedef brlapi_param_bool_t brlapi_param_deviceOnline_t;
 /** Type to be used for BRLAPI_PARAM_RETAIN_DOTS */
 typedef brlapi_param_bool_t brlapi_param_retainDots_t;
 
+/* brlapi_param_keyBatchDelay_t */
+/** Type to be used for BRLAPI_PARAM_KEY_BATCH_DELAY */
+typedef uint32_t brlapi_param_keyBatchDelay_t;
+
 /* brlapi_param_computerBrailleCellSize_t */
 /** Type to be used for BRLAPI_PARAM_COMPUTER_BRAILLE_CELL_SIZE */
 typedef uint8_t brlapi_param_computerBrailleCellSize_t;
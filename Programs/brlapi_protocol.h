@@ -49,7 +49,7 @@ extern "C" {
  *
  * @{ */
 
-#define BRLAPI_PROTOCOL_VERSION ((uint32_t) 8) /** Communication protocol version */
+#define BRLAPI_PROTOCOL_VERSION ((uint32_t) 9) /** Communication protocol version */
 
 /** Maximum packet size for packets exchanged on sockets and with braille
  * terminal */
@@ -79,6 +79,10 @@ extern "C" {
 #define BRLAPI_PACKET_PARAM_VALUE     (('P'<<8) + 'V') /**< Parameter value  */
 #define BRLAPI_PACKET_PARAM_REQUEST   (('P'<<8) + 'R') /**< Parameter request*/
 #define BRLAPI_PACKET_PARAM_UPDATE    (('P'<<8) + 'U') /**< Parameter update */
+#define BRLAPI_PACKET_SHAREDWINDOW    (('S'<<8) + 'W') /**< Shared window  */
+#define BRLAPI_PACKET_SHAREDUPDATE    (('S'<<8) + 'U') /**< Shared update  */
+#define BRLAPI_PACKET_KEYS            (('K'<<8) + 'S') /**< Braille keys   */
+#define BRLAPI_PACKET_WRITEPATCH      (('W'<<8) + 'P') /**< Window patch   */
 
 /** Magic number to give when sending a BRLPACKET_ENTERRAWMODE or BRLPACKET_SUSPEND packet */
 #define BRLAPI_DEVICE_MAGIC (0xdeadbeefL)
@@ -167,6 +171,74 @@ typedef struct {
   uint32_t subparam_lo; /** Which sub-parameter being transmitted, lo 32bits */
 } brlapi_paramRequestPacket_t;
 
+/** Magic number to give when sending a BRLAPI_PACKET_SHAREDWINDOW packet */
+#define BRLAPI_SHAREDWINDOW_MAGIC (0X53484D57L)
+
+/** Structure of shared window packets
+ *
+ * The shared memory object itself is passed along as ancillary data
+ * (SCM_RIGHTS) of the same message. */
+typedef struct {
+  uint32_t magic; /** BRLAPI_SHAREDWINDOW_MAGIC */
+  uint32_t cells; /** Number of cells in the shared window */
+} brlapi_sharedWindowPacket_t;
+
+/** Structure of the beginning of a shared window
+ *
+ * It is in host byte order, and is followed by the text of the cells (one
+ * uint32_t Unicode character per cell), then by their and mask, then by their
+ * or mask (one byte per cell each). The client increments \e sequence before
+ * and after modifying the window, so that it is odd while the window is being
+ * modified. */
+typedef struct {
+  uint32_t sequence; /** Odd while the window is being modified */
+  int32_t cursor; /** Cursor position */
+} brlapi_sharedWindowHeader_t;
+
+/** Size of a shared window with the given number of cells */
+#define BRLAPI_SHAREDWINDOW_SIZE(cells) \
+  (sizeof(brlapi_sharedWindowHeader_t) + (cells) * (sizeof(uint32_t) + 2))
+
+/** Flags for shared window updates */
+#define BRLAPI_SUF_CURSOR        0X01    /**< Cursor position changed        */
+
+/** Structure of shared window update packets */
+typedef struct {
+  uint32_t flags; /** Flags to tell what changed besides the region */
+  uint32_t regionBegin; /** First modified cell, starting from 1 */
+  uint32_t regionSize; /** Number of modified cells, may be 0 */
+} brlapi_sharedUpdatePacket_t;
+
+/** Flags for window patches */
+#define BRLAPI_WPF_CURSOR        0X01    /**< Cursor position changed        */
+
+/** Structure of window patch packets
+ *
+ * \e data holds \e runs runs of modified cells, each of them made of the
+ * first cell (starting from 1) and the number of cells as two uint32_t, then
+ * of the text of the cells (one uint32_t Unicode character per cell), then of
+ * their and mask, then of their or mask (one byte per cell each), and is
+ * padded with zeroes to a multiple of 4 bytes. All integers are in network
+ * byte order. */
+typedef struct {
+  uint32_t flags; /** Flags to tell what changed besides the runs */
+  uint32_t cursor; /** Cursor position, if BRLAPI_WPF_CURSOR is set */
+  uint32_t runs; /** Number of runs */
+  unsigned char data; /** Runs */
+} brlapi_writePatchPacket_t;
+
+/** Size of a run of the given number of cells in a window patch packet */
+#define BRLAPI_WRITEPATCH_RUN_SIZE(cells) \
+  (((2 + (cells)) * sizeof(uint32_t) + 2 * (cells) + 3) & ~3)
+
+/** Maximum number of keys in a BRLAPI_PACKET_KEYS packet
+ *
+ * Such a packet is a sequence of key codes, each of them sent as two
+ * uint32_t (high half first) in network byte order, like the content of a
+ * BRLAPI_PACKET_KEY packet. Servers only send it to clients which announced
+ * at least protocol version 9. */
+#define BRLAPI_MAXKEYSPERPACKET (BRLAPI_MAXPACKETSIZE / (2 * sizeof(uint32_t)))
+
 /** Type for packets.  Should be used instead of a mere char[], since it has
  * correct alignment requirements. */
 typedef union {
@@ -179,6 +251,9 @@ typedef union {
 	brlapi_writeArgumentsPacket_t writeArguments;
 	brlapi_paramValuePacket_t paramValue;
 	brlapi_paramRequestPacket_t paramRequest;
+	brlapi_sharedWindowPacket_t sharedWindow;
+	brlapi_sharedUpdatePacket_t sharedUpdate;
+	brlapi_writePatchPacket_t writePatch;
 	uint32_t uint32;
 } brlapi_packet_t;
 
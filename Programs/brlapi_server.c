@@ -105,6 +105,8 @@ Samuel Thibault <samuel.thibault@ens-lyon.org>"
 #include "scr.h"
 #include "charset.h"
 #include "async_signal.h"
+#include "async_alarm.h"
+#include "async_handle.h"
 #include "thread.h"
 #include "blink.h"
 
@@ -162,6 +164,12 @@ static brlapi_error_t brlapiserver_error;
 #define BRLAPI(fun) brlapiserver_ ## fun
 #include "brlapi_common.h"
 
+/** maximum number of keys held back for a connection */
+#define KEY_BATCH_SIZE 32
+
+/** longest time (in milliseconds) keys may be held back for a connection */
+#define MAXIMUM_KEY_BATCH_DELAY 1000
+
 /** ask for \e brltty commands */
 #define BRL_COMMANDS 0
 /** ask for raw driver keycodes */
@@ -187,7 +195,11 @@ typedef struct Subscription {
   brlapi_param_t parameter;
   brlapi_param_subparam_t subparam;
   brlapi_param_flags_t flags;
-  struct Subscription *prev, *next;
+  struct Connection *connection;
+  struct Subscription *prev, *next; /* the connection's subscriptions */
+  struct Subscription **prevSubscriber, *nextSubscriber; /* the parameter's global subscribers */
+  void *pendingUpdate; /* latest update not yet sent, NULL if none */
+  size_t pendingSize;
 } Subscription;
 
 typedef struct Connection {
@@ -208,6 +220,23 @@ typedef struct Connection {
   time_t upTime;
   Packet packet;
   struct Subscription subscriptions;
+  unsigned int pendingParamUpdates; /* subscriptions with a pending update */
+  unsigned long int paramUpdateSerial; /* the last global update sent */
+  brlapi_param_keyBatchDelay_t keyBatchDelay; /* 0 if keys are not batched */
+  struct {
+    brlapi_keyCode_t codes[KEY_BATCH_SIZE];
+    unsigned int count;
+    TimeValue deadline; /* when the first pending key must be sent */
+  } keyBatch;
+#ifdef BRLAPI_SHARED_WINDOW
+  struct {
+    const volatile brlapi_sharedWindowHeader_t *header; /* NULL if none */
+    size_t size;
+    unsigned int cells;
+    unsigned int updateBegin, updateEnd; /* cells not yet copied */
+    unsigned char updateCursor; /* cursor not yet copied */
+  } sharedWindow;
+#endif /* BRLAPI_SHARED_WINDOW */
 } Connection;
 
 typedef struct Tty {
@@ -222,6 +251,7 @@ typedef struct Tty {
 typedef struct {
   unsigned local_subscriptions;
   unsigned global_subscriptions;
+  Subscription *globalSubscribers;
 } ParamState;
 
 static ParamState paramState[BRLAPI_PARAM_COUNT];
@@ -259,6 +289,15 @@ static Connection *suspendConnection = NULL;
 pthread_mutex_t apiParamMutex;
 /* Which connection is currently modifying a parameter */
 static Connection *paramUpdateConnection;
+/* Distinguishes global parameter updates from one another */
+static unsigned long int paramUpdateSerial = 0;
+
+#ifndef __MINGW32__
+/* Wakes up the server thread when a connection gets pending parameter updates */
+static FileDescriptor paramWakeupPipe[2] = {
+  INVALID_FILE_DESCRIPTOR, INVALID_FILE_DESCRIPTOR
+};
+#endif /* __MINGW32__ */
 
 /* mutex lock order is as follows:
  * 1. apiParamMutex
@@ -536,6 +575,17 @@ static void writeKey(FileDescriptor fd, brlapi_keyCode_t key) {
   brlapiserver_writePacket(fd,BRLAPI_PACKET_KEY,&buf,sizeof(buf));
 }
 
+static void writeKeys(FileDescriptor fd, const brlapi_keyCode_t *keys, unsigned int count) {
+  uint32_t buf[KEY_BATCH_SIZE * 2];
+  unsigned int i;
+  for (i=0; i<count; i++) {
+    buf[2*i] = htonl(keys[i] >> 32);
+    buf[2*i+1] = htonl(keys[i] & 0xffffffff);
+  }
+  logMessage(LOG_CATEGORY(SERVER_EVENTS), "writing %u keys to fd %"PRIfd,count,fd);
+  brlapiserver_writePacket(fd,BRLAPI_PACKET_KEYS,&buf,count*2*sizeof(*buf));
+}
+
 typedef int(*PacketHandler)(Connection *, brlapi_packetType_t, brlapi_packet_t *, size_t);
 
 typedef struct { /* packet handlers */
@@ -556,6 +606,9 @@ typedef struct { /* packet handlers */
   PacketHandler parameterValue;
   PacketHandler parameterRequest;
   PacketHandler sync;
+  PacketHandler sharedWindow;
+  PacketHandler sharedUpdate;
+  PacketHandler writePatch;
 } PacketHandlers;
 
 /****************************************************************************/
@@ -628,6 +681,70 @@ static void getDots(const BrailleWindow *brailleWindow, unsigned char *buf)
   }
 }
 
+#ifdef BRLAPI_SHARED_WINDOW
+/* Function : closeSharedWindow */
+/* Unmaps the shared window of a connection, if any */
+static void closeSharedWindow(Connection *c)
+{
+  lockMutex(&c->brailleWindowMutex);
+  if (c->sharedWindow.header) {
+    munmap((void *) c->sharedWindow.header, c->sharedWindow.size);
+    c->sharedWindow.header = NULL;
+  }
+  c->sharedWindow.updateBegin = c->sharedWindow.updateEnd = 0;
+  c->sharedWindow.updateCursor = 0;
+  unlockMutex(&c->brailleWindowMutex);
+}
+
+/* How many times to try reading a shared window which is being modified */
+#define SHARED_WINDOW_READ_ATTEMPTS 8
+
+/* Function : readSharedWindow */
+/* Copies the pending part of the shared window into the braille window. */
+/* If the client keeps modifying it, this is left pending: the client will */
+/* anyway send another update once it is done. */
+/* Must be called with the braille window mutex held */
+static void readSharedWindow(Connection *c)
+{
+  const volatile brlapi_sharedWindowHeader_t *header = c->sharedWindow.header;
+  if (!header) return;
+
+  const uint32_t *text = (const uint32_t *) (header + 1);
+  const unsigned char *andAttr = (const unsigned char *) (text + c->sharedWindow.cells);
+  const unsigned char *orAttr = andAttr + c->sharedWindow.cells;
+  unsigned int end = MIN(c->sharedWindow.updateEnd, displaySize);
+  unsigned int begin = MIN(c->sharedWindow.updateBegin, end);
+  int attempts = SHARED_WINDOW_READ_ATTEMPTS;
+
+  while (attempts--) {
+    uint32_t sequence = header->sequence;
+
+    if (!(sequence & 1)) {
+      unsigned int i;
+      int32_t cursor;
+
+      __sync_synchronize();
+      for (i=begin; i<end; i+=1) c->brailleWindow.text[i] = text[i];
+      memcpy(c->brailleWindow.andAttr+begin, andAttr+begin, end-begin);
+      memcpy(c->brailleWindow.orAttr+begin, orAttr+begin, end-begin);
+      cursor = header->cursor;
+      __sync_synchronize();
+
+      if (header->sequence == sequence) {
+        if (c->sharedWindow.updateCursor)
+          c->brailleWindow.cursor = ((cursor >= 0) && (cursor <= displaySize))? cursor: 0;
+
+        c->sharedWindow.updateBegin = c->sharedWindow.updateEnd = 0;
+        c->sharedWindow.updateCursor = 0;
+        return;
+      }
+    }
+  }
+
+  logMessage(LOG_CATEGORY(SERVER_EVENTS), "fd %"PRIfd" shared window busy", c->fd);
+}
+#endif /* BRLAPI_SHARED_WINDOW */
+
 /****************************************************************************/
 /** CONNECTIONS MANAGING                                                   **/
 /****************************************************************************/
@@ -662,6 +779,8 @@ static Connection *createConnection(FileDescriptor fd, time_t currentTime)
 
   c->how = 0;
   c->retainDots = 1;
+  c->keyBatchDelay = 0;
+  c->keyBatch.count = 0;
   c->acceptedKeys = NULL;
   c->upTime = currentTime;
   c->brailleWindow.text = NULL;
@@ -671,6 +790,13 @@ static Connection *createConnection(FileDescriptor fd, time_t currentTime)
     goto outmalloc;
   c->subscriptions.next = &c->subscriptions;
   c->subscriptions.prev = &c->subscriptions;
+  c->pendingParamUpdates = 0;
+  c->paramUpdateSerial = 0;
+#ifdef BRLAPI_SHARED_WINDOW
+  c->sharedWindow.header = NULL;
+  c->sharedWindow.updateBegin = c->sharedWindow.updateEnd = 0;
+  c->sharedWindow.updateCursor = 0;
+#endif /* BRLAPI_SHARED_WINDOW */
   return c;
 
 outmalloc:
@@ -683,22 +809,45 @@ out:
   return NULL;
 }
 
+/* Function : discardParamUpdate */
+/* Forgets the update which was being held back for a subscription */
+/* Must be called with apiParamMutex held */
+static void discardParamUpdate(Connection *c, Subscription *s)
+{
+  if (s->pendingUpdate) {
+    free(s->pendingUpdate);
+    s->pendingUpdate = NULL;
+    c->pendingParamUpdates -= 1;
+  }
+}
+
+/* Function : freeSubscription */
+/* Unlinks a subscription from its connection and parameter, and frees it */
+/* Must be called with apiParamMutex held */
+static void freeSubscription(Connection *c, Subscription *s)
+{
+  if (s->flags & BRLAPI_PARAMF_GLOBAL) {
+    paramState[s->parameter].global_subscriptions--;
+    if ((*s->prevSubscriber = s->nextSubscriber))
+      s->nextSubscriber->prevSubscriber = s->prevSubscriber;
+  } else {
+    paramState[s->parameter].local_subscriptions--;
+  }
+
+  s->next->prev = s->prev;
+  s->prev->next = s->next;
+  discardParamUpdate(c, s);
+  free(s);
+}
+
 /* Function : freeConnection */
 /* Frees all resources associated to a connection */
 static void freeConnection(Connection *c)
 {
-  struct Subscription *s, *next;
-
   if (c->fd != INVALID_FILE_DESCRIPTOR) {
     lockMutex(&apiParamMutex);
-    for (s=c->subscriptions.next; s!=&c->subscriptions; s=next) {
-      if (s->flags & BRLAPI_PARAMF_GLOBAL)
-	paramState[s->parameter].global_subscriptions--;
-      else
-	paramState[s->parameter].local_subscriptions--;
-      next = s->next;
-      free(s);
-    }
+    while (c->subscriptions.next != &c->subscriptions)
+      freeSubscription(c, c->subscriptions.next);
     unlockMutex(&apiParamMutex);
 
     if (c->auth != 1) unauthConnections--;
@@ -711,6 +860,11 @@ static void freeConnection(Connection *c)
   pthread_mutex_destroy(&c->acceptedKeysMutex);
   unsetAddressName(&c->acceptedKeysMutex);
 
+#ifdef BRLAPI_SHARED_WINDOW
+  closeSharedWindow(c);
+  brlapi_forgetPassedDescriptor(&c->packet);
+#endif /* BRLAPI_SHARED_WINDOW */
+
   freeBrailleWindow(&c->brailleWindow);
   freeKeyrangeList(&c->acceptedKeys);
   free(c);
@@ -969,6 +1123,8 @@ static int handleSetFocus(Connection *c, brlapi_packetType_t type, brlapi_packet
   return 0;
 }
 
+static void flushKeyBatch(Connection *c);
+
 /* Function doLeaveTty */
 /* handles a connection leaving its tty */
 static void doLeaveTty(Connection *c)
@@ -978,9 +1134,13 @@ static void doLeaveTty(Connection *c)
   c->tty = NULL;
   lockMutex(&apiConnectionsMutex);
   __removeConnection(c);
+  flushKeyBatch(c);
   __addConnection(c,notty.connections);
   unlockMutex(&apiConnectionsMutex);
   freeKeyrangeList(&c->acceptedKeys);
+#ifdef BRLAPI_SHARED_WINDOW
+  closeSharedWindow(c);
+#endif /* BRLAPI_SHARED_WINDOW */
   freeBrailleWindow(&c->brailleWindow);
 }
 
@@ -1157,6 +1317,13 @@ static int handleWrite(Connection *c, brlapi_packetType_t type, brlapi_packet_t
 
   unsigned int rsiz_filled = fill ? displaySize - rbeg + 1 : rsiz;
 
+#ifdef BRLAPI_SHARED_WINDOW
+  /* Apply previous shared window updates before this one */
+  lockMutex(&c->brailleWindowMutex);
+  readSharedWindow(c);
+  unlockMutex(&c->brailleWindowMutex);
+#endif /* BRLAPI_SHARED_WINDOW */
+
   if (text) {
     int isUTF8 = 0;
     int isLatin1 = 0;
@@ -1309,6 +1476,153 @@ static int handleWrite(Connection *c, brlapi_packetType_t type, brlapi_packet_t
   return 0;
 }
 
+static int handleWritePatch(Connection *c, brlapi_packetType_t type, brlapi_packet_t *packet, size_t size)
+{
+  brlapi_writePatchPacket_t *wp = &packet->writePatch;
+  const unsigned char *runs = &wp->data;
+  size_t remaining;
+  unsigned int flags, count, i;
+  int cursor = -1;
+  const unsigned char *p;
+
+  CHECKEXC(size>=offsetof(brlapi_writePatchPacket_t, data), BRLAPI_ERROR_INVALID_PACKET, "packet too small");
+  CHECKEXC(!c->raw,BRLAPI_ERROR_ILLEGAL_INSTRUCTION,"not allowed in raw mode");
+  CHECKEXC(c->tty,BRLAPI_ERROR_ILLEGAL_INSTRUCTION,"not allowed out of tty mode");
+  flags = ntohl(wp->flags);
+  count = ntohl(wp->runs);
+  if (flags & BRLAPI_WPF_CURSOR) {
+    cursor = ntohl(wp->cursor);
+    CHECKEXC((cursor>=0) && (cursor<=displaySize), BRLAPI_ERROR_INVALID_PACKET, "wrong cursor");
+  }
+
+  /* Check all the runs first, so that the patch is applied entirely or not at all */
+  remaining = size - offsetof(brlapi_writePatchPacket_t, data);
+  for (i=0, p=runs; i<count; i+=1) {
+    uint32_t run[2];
+    size_t runSize;
+    CHECKEXC(remaining>=sizeof(run), BRLAPI_ERROR_INVALID_PACKET, "packet too small for run");
+    memcpy(run, p, sizeof(run));
+    run[0] = ntohl(run[0]);
+    run[1] = ntohl(run[1]);
+    CHECKEXC((run[0]>=1) && (run[1]>=1) && (run[1]<=displaySize) && (run[0]-1<=displaySize-run[1]),
+             BRLAPI_ERROR_INVALID_PARAMETER, "invalid run");
+    runSize = BRLAPI_WRITEPATCH_RUN_SIZE(run[1]);
+    CHECKEXC(remaining>=runSize, BRLAPI_ERROR_INVALID_PACKET, "packet too small for run");
+    p += runSize; remaining -= runSize;
+  }
+  CHECKEXC(remaining==0, BRLAPI_ERROR_INVALID_PACKET, "packet too big");
+
+  lockMutex(&c->brailleWindowMutex);
+#ifdef BRLAPI_SHARED_WINDOW
+  /* Apply previous shared window updates before this one */
+  readSharedWindow(c);
+#endif /* BRLAPI_SHARED_WINDOW */
+
+  for (i=0, p=runs; i<count; i+=1) {
+    uint32_t run[2], character;
+    unsigned int j;
+    memcpy(run, p, sizeof(run));
+    unsigned int begin = ntohl(run[0]) - 1;
+    unsigned int cells = ntohl(run[1]);
+    const unsigned char *text = p + sizeof(run);
+    const unsigned char *andAttr = text + cells*sizeof(character);
+
+    for (j=0; j<cells; j+=1) {
+      memcpy(&character, text + j*sizeof(character), sizeof(character));
+      c->brailleWindow.text[begin+j] = ntohl(character);
+    }
+    memcpy(c->brailleWindow.andAttr+begin, andAttr, cells);
+    memcpy(c->brailleWindow.orAttr+begin, andAttr+cells, cells);
+    p += BRLAPI_WRITEPATCH_RUN_SIZE(cells);
+  }
+  if (cursor >= 0) c->brailleWindow.cursor = cursor;
+
+  c->brlbufstate = TODISPLAY;
+  unlockMutex(&c->brailleWindowMutex);
+  flushOutput();
+  return 0;
+}
+
+#ifdef BRLAPI_SHARED_WINDOW
+static int handleSharedWindow(Connection *c, brlapi_packetType_t type, brlapi_packet_t *packet, size_t size)
+{
+  brlapi_sharedWindowPacket_t *sw = &packet->sharedWindow;
+  int descriptor = c->packet.passedDescriptor;
+  unsigned int cells;
+  size_t windowSize;
+  struct stat st;
+  int seals;
+  void *address;
+
+  CHECKERR(size==sizeof(*sw), BRLAPI_ERROR_INVALID_PACKET, "wrong packet size");
+  CHECKERR(ntohl(sw->magic)==BRLAPI_SHAREDWINDOW_MAGIC, BRLAPI_ERROR_INVALID_PARAMETER, "wrong magic number");
+  CHECKERR(!c->raw, BRLAPI_ERROR_ILLEGAL_INSTRUCTION, "not allowed in raw mode");
+  CHECKERR(c->tty, BRLAPI_ERROR_ILLEGAL_INSTRUCTION, "not allowed out of tty mode");
+  CHECKERR(descriptor != -1, BRLAPI_ERROR_INVALID_PACKET, "no shared memory descriptor");
+
+  cells = ntohl(sw->cells);
+  CHECKERR(cells == displaySize, BRLAPI_ERROR_INVALID_PARAMETER, "wrong number of cells");
+  windowSize = BRLAPI_SHAREDWINDOW_SIZE(cells);
+
+  /* The client must not be able to shrink it under our feet */
+  CHECKERR((fstat(descriptor, &st) != -1) && (st.st_size >= windowSize), BRLAPI_ERROR_INVALID_PARAMETER, "shared memory too small");
+  seals = fcntl(descriptor, F_GET_SEALS);
+  CHECKERR((seals != -1) && (seals & F_SEAL_SHRINK), BRLAPI_ERROR_INVALID_PARAMETER, "shared memory not sealed");
+
+  address = mmap(NULL, windowSize, PROT_READ, MAP_SHARED, descriptor, 0);
+  if (address == MAP_FAILED) {
+    logSystemError("mmap");
+    WERR(c->fd, BRLAPI_ERROR_NOMEM, "cannot map shared window");
+    return 0;
+  }
+
+  closeSharedWindow(c);
+  lockMutex(&c->brailleWindowMutex);
+  c->sharedWindow.header = address;
+  c->sharedWindow.size = windowSize;
+  c->sharedWindow.cells = cells;
+  unlockMutex(&c->brailleWindowMutex);
+  logMessage(LOG_CATEGORY(SERVER_EVENTS), "fd %"PRIfd" uses a shared window of %u cells", c->fd, cells);
+
+  writeAck(c->fd);
+  return 0;
+}
+
+static int handleSharedUpdate(Connection *c, brlapi_packetType_t type, brlapi_packet_t *packet, size_t size)
+{
+  brlapi_sharedUpdatePacket_t *su = &packet->sharedUpdate;
+  unsigned int flags, rbeg, rsiz;
+
+  CHECKEXC(size==sizeof(*su), BRLAPI_ERROR_INVALID_PACKET, "wrong packet size");
+  CHECKEXC(!c->raw, BRLAPI_ERROR_ILLEGAL_INSTRUCTION, "not allowed in raw mode");
+  CHECKEXC(c->tty, BRLAPI_ERROR_ILLEGAL_INSTRUCTION, "not allowed out of tty mode");
+  CHECKEXC(c->sharedWindow.header, BRLAPI_ERROR_ILLEGAL_INSTRUCTION, "no shared window");
+
+  flags = ntohl(su->flags);
+  rbeg = ntohl(su->regionBegin);
+  rsiz = ntohl(su->regionSize);
+  CHECKEXC(!rsiz || ((rbeg >= 1) && (rsiz <= c->sharedWindow.cells) && (rbeg-1 <= c->sharedWindow.cells - rsiz)),
+           BRLAPI_ERROR_INVALID_PARAMETER, "invalid region");
+
+  lockMutex(&c->brailleWindowMutex);
+  if (rsiz) {
+    if (c->sharedWindow.updateBegin == c->sharedWindow.updateEnd) {
+      c->sharedWindow.updateBegin = rbeg-1;
+      c->sharedWindow.updateEnd = rbeg-1 + rsiz;
+    } else {
+      c->sharedWindow.updateBegin = MIN(c->sharedWindow.updateBegin, rbeg-1);
+      c->sharedWindow.updateEnd = MAX(c->sharedWindow.updateEnd, rbeg-1 + rsiz);
+    }
+  }
+  if (flags & BRLAPI_SUF_CURSOR) c->sharedWindow.updateCursor = 1;
+  readSharedWindow(c);
+  c->brlbufstate = TODISPLAY;
+  unlockMutex(&c->brailleWindowMutex);
+  flushOutput();
+  return 0;
+}
+#endif /* BRLAPI_SHARED_WINDOW */
+
 static int checkDriverSpecificModePacket(Connection *c, brlapi_packet_t *packet, size_t size)
 {
   brlapi_getDriverSpecificModePacket_t *getDevicePacket = &packet->getDriverSpecificMode;
@@ -1647,6 +1961,30 @@ PARAM_WRITER(retainDots)
   return NULL;
 }
 
+/* BRLAPI_PARAM_KEY_BATCH_DELAY */
+PARAM_READER(keyBatchDelay)
+{
+  brlapi_param_keyBatchDelay_t *keyBatchDelay = data;
+  *size = sizeof(*keyBatchDelay);
+  *keyBatchDelay = c->keyBatchDelay;
+  return NULL;
+}
+
+PARAM_WRITER(keyBatchDelay)
+{
+  const brlapi_param_keyBatchDelay_t *keyBatchDelay = data;
+  PARAM_ASSERT_SIZE(keyBatchDelay);
+  if (*keyBatchDelay > MAXIMUM_KEY_BATCH_DELAY) return "key batch delay too long";
+  if (*keyBatchDelay && (c->clientVersion < 9)) return "key batches need protocol version 9";
+
+  /* Keys already held back are still sent at their original deadline. */
+  lockMutex(&apiConnectionsMutex);
+    c->keyBatchDelay = *keyBatchDelay;
+  unlockMutex(&apiConnectionsMutex);
+
+  return NULL;
+}
+
 /* BRLAPI_PARAM_COMPUTER_BRAILLE_CELL_SIZE */
 PARAM_READER(computerBrailleCellSize)
 {
@@ -2107,6 +2445,12 @@ static const ParamDispatch paramDispatch[BRLAPI_PARAM_COUNT] = {
     .write = param_retainDots_write,
   },
 
+  [BRLAPI_PARAM_KEY_BATCH_DELAY] = {
+    .local = 1,
+    .read = param_keyBatchDelay_read,
+    .write = param_keyBatchDelay_write,
+  },
+
 //Braille Rendering Parameters
   [BRLAPI_PARAM_COMPUTER_BRAILLE_CELL_SIZE] = {
     .global = 1,
@@ -2305,39 +2649,128 @@ static int handleParamValue(Connection *c, brlapi_packetType_t type, brlapi_pack
 }
 
 
-/* sendConnectionParamUpdate: Send the parameter update to a connection */
-static void sendConnectionParamUpdate(Connection *c, brlapi_param_t param, brlapi_param_subparam_t subparam, brlapi_param_flags_t flags, brlapi_paramValuePacket_t *paramValue, size_t size)
+/* findSubscription: Find the subscription of a connection an update is for */
+static Subscription *findSubscription(Connection *c, brlapi_param_t param, brlapi_param_subparam_t subparam, brlapi_param_flags_t flags)
 {
-  struct Subscription *s;
+  Subscription *s;
 
   for (s=c->subscriptions.next; s!=&c->subscriptions; s=s->next) {
     if (s->parameter == param
 	&& s->subparam == subparam
 	&& (s->flags & BRLAPI_PARAMF_GLOBAL) == (flags & BRLAPI_PARAMF_GLOBAL)
 	&& ((s->flags & BRLAPI_PARAMF_SELF) || (paramUpdateConnection != c)))
-    {
-      logMessage(LOG_CATEGORY(SERVER_EVENTS), "writing parameter %"PRIx32" update to fd %"PRIfd,param,c->fd);
-      brlapiserver_writePacket(c->fd,BRLAPI_PACKET_PARAM_UPDATE,paramValue,size);
-      break;
+      return s;
+  }
+
+  return NULL;
+}
+
+#ifndef __MINGW32__
+/* canWriteConnection: Whether the client has drained what was sent to it */
+static int canWriteConnection(Connection *c)
+{
+  fd_set writeFds;
+  struct timeval timeout = { .tv_sec = 0, .tv_usec = 0 };
+
+  FD_ZERO(&writeFds);
+  FD_SET(c->fd, &writeFds);
+  return select(c->fd+1, NULL, &writeFds, NULL, &timeout) > 0;
+}
+
+static void wakeServerThread(void)
+{
+  static const unsigned char byte = 0;
+
+  if (paramWakeupPipe[1] != INVALID_FILE_DESCRIPTOR) {
+    if (write(paramWakeupPipe[1], &byte, 1) == -1) {
+      if (errno != EAGAIN) logSystemError("parameter wakeup write");
     }
   }
 }
+#endif /* __MINGW32__ */
 
-/* sendParamUpdate: Send the parameter update to connections bound to a given tree of ttys */
-static void sendParamUpdate(Tty *tty, brlapi_param_t param, brlapi_param_subparam_t subparam, brlapi_param_flags_t flags, brlapi_paramValuePacket_t *paramValue, size_t size)
+/* flushParamUpdates: Send the held back updates the client can now take */
+/* Must be called with apiParamMutex held */
+static void flushParamUpdates(Connection *c)
 {
-  Connection *c;
-  Tty *t;
+  Subscription *s;
 
-  for (c = tty->connections->next; c!=tty->connections; c = c->next)
-    sendConnectionParamUpdate(c, param, subparam, flags, paramValue, size);
-  for (t = tty->subttys; t; t = t->next)
-    sendParamUpdate(t, param, subparam, flags, paramValue, size);
+  for (s=c->subscriptions.next; s!=&c->subscriptions; s=s->next) {
+    if (!c->pendingParamUpdates) break;
+    if (!s->pendingUpdate) continue;
+
+#ifndef __MINGW32__
+    if (!canWriteConnection(c)) break;
+#endif /* __MINGW32__ */
+
+    logMessage(LOG_CATEGORY(SERVER_EVENTS), "writing pending parameter %"PRIx32" update to fd %"PRIfd,s->parameter,c->fd);
+    brlapiserver_writePacket(c->fd,BRLAPI_PACKET_PARAM_UPDATE,s->pendingUpdate,s->pendingSize);
+    discardParamUpdate(c, s);
+  }
+}
+
+/* writeParamUpdate: Send a parameter update to a connection */
+/* While the client isn't keeping up, only the latest value of each */
+/* subscription is kept, and it's sent once the client has drained */
+/* Must be called with apiParamMutex held */
+static void writeParamUpdate(Connection *c, Subscription *s, brlapi_paramValuePacket_t *paramValue, size_t size)
+{
+#ifndef __MINGW32__
+  if (c->pendingParamUpdates) flushParamUpdates(c);
+
+  if (c->pendingParamUpdates || !canWriteConnection(c)) {
+    void *update = realloc(s->pendingUpdate, size);
+
+    if (update) {
+      if (!s->pendingUpdate) {
+        if (!c->pendingParamUpdates++) wakeServerThread();
+      } else {
+        logMessage(LOG_CATEGORY(SERVER_EVENTS), "coalescing parameter %"PRIx32" update to fd %"PRIfd,s->parameter,c->fd);
+      }
+
+      memcpy(update, paramValue, size);
+      s->pendingUpdate = update;
+      s->pendingSize = size;
+      return;
+    }
+  }
+#endif /* __MINGW32__ */
+
+  logMessage(LOG_CATEGORY(SERVER_EVENTS), "writing parameter %"PRIx32" update to fd %"PRIfd,s->parameter,c->fd);
+  brlapiserver_writePacket(c->fd,BRLAPI_PACKET_PARAM_UPDATE,paramValue,size);
+}
+
+/* sendParamUpdate: Send the parameter update to the connections which watch it globally */
+static void sendParamUpdate(brlapi_param_t param, brlapi_param_subparam_t subparam, brlapi_paramValuePacket_t *paramValue, size_t size)
+{
+  Subscription *s;
+
+  paramUpdateSerial += 1;
+
+  for (s=paramState[param].globalSubscribers; s; s=s->nextSubscriber) {
+    Connection *c = s->connection;
+
+    if (s->subparam != subparam) continue;
+    if (!(s->flags & BRLAPI_PARAMF_SELF) && (paramUpdateConnection == c)) continue;
+
+    /* a connection with several matching subscriptions only gets it once */
+    if (c->paramUpdateSerial == paramUpdateSerial) continue;
+    c->paramUpdateSerial = paramUpdateSerial;
+
+    writeParamUpdate(c, s, paramValue, size);
+  }
 }
 
 /* handleParamUpdate: Prepare and send the parameter update to all connections */
 static void __handleParamUpdate(Connection *dest, brlapi_param_t param, brlapi_param_subparam_t subparam, brlapi_param_flags_t flags, const void *data, size_t size)
 {
+  Subscription *s = NULL;
+
+  if (!(flags & BRLAPI_PARAMF_GLOBAL)) {
+    /* don't even serialize the value if the connection doesn't watch it */
+    if (!(s = findSubscription(dest, param, subparam, flags))) return;
+  }
+
   brlapi_packet_t response;
   brlapi_paramValuePacket_t *paramValue = &response.paramValue;
   unsigned char *p = paramValue->data;
@@ -2348,12 +2781,11 @@ static void __handleParamUpdate(Connection *dest, brlapi_param_t param, brlapi_p
   memcpy(p, data, size);
   _brlapi_htonParameter(param, paramValue, size);
   size += sizeof(flags) + sizeof(param) + sizeof(subparam);
-  if (!(flags & BRLAPI_PARAMF_GLOBAL)) {
-    sendConnectionParamUpdate(dest,param,subparam,flags,paramValue,size);
+  if (s) {
+    writeParamUpdate(dest,s,paramValue,size);
   } else {
     lockMutex(&apiConnectionsMutex);
-    sendParamUpdate(&ttys,param,subparam,flags,paramValue,size);
-    sendParamUpdate(&notty,param,subparam,flags,paramValue,size);
+    sendParamUpdate(param,subparam,paramValue,size);
     unlockMutex(&apiConnectionsMutex);
   }
 }
@@ -2454,18 +2886,31 @@ static int handleParamRequest(Connection *c, brlapi_packetType_t type, brlapi_pa
 
     struct Subscription *s;
     lockMutex(&apiConnectionsMutex);
-    if (flags & BRLAPI_PARAMF_GLOBAL)
-      paramState[param].global_subscriptions++;
-    else
-      paramState[param].local_subscriptions++;
     s = malloc(sizeof(*s));
+    if (!s) {
+      WERR(c->fd, BRLAPI_ERROR_NOMEM, "no memory for subscription");
+      unlockMutex(&apiConnectionsMutex);
+      unlockMutex(&apiParamMutex);
+      return 0;
+    }
     s->parameter = param;
     s->subparam = subparam;
     s->flags = flags;
+    s->connection = c;
+    s->pendingUpdate = NULL;
     s->next = c->subscriptions.next;
     s->prev = &c->subscriptions;
     s->next->prev = s;
     s->prev->next = s;
+    if (flags & BRLAPI_PARAMF_GLOBAL) {
+      Subscription **head = &paramState[param].globalSubscribers;
+      paramState[param].global_subscriptions++;
+      if ((s->nextSubscriber = *head)) s->nextSubscriber->prevSubscriber = &s->nextSubscriber;
+      s->prevSubscriber = head;
+      *head = s;
+    } else {
+      paramState[param].local_subscriptions++;
+    }
     unlockMutex(&apiConnectionsMutex);
   } else if (flags & BRLAPI_PARAMF_UNSUBSCRIBE) {
     /* unsubscribe from parameter updates */
@@ -2476,14 +2921,8 @@ static int handleParamRequest(Connection *c, brlapi_packetType_t type, brlapi_pa
 	  && (s->flags & BRLAPI_PARAMF_GLOBAL) == (flags & BRLAPI_PARAMF_GLOBAL))
 	break;
     }
-    if (s) {
-      if (flags & BRLAPI_PARAMF_GLOBAL)
-        paramState[param].global_subscriptions--;
-      else
-        paramState[param].local_subscriptions--;
-      s->next->prev = s->prev;
-      s->prev->next = s->next;
-      free(s);
+    if (s != &c->subscriptions) {
+      freeSubscription(c, s);
     } else {
       WERR(c->fd, BRLAPI_ERROR_INVALID_PARAMETER, "was not subscribed");
       unlockMutex(&apiParamMutex);
@@ -2530,6 +2969,12 @@ static PacketHandlers packetHandlers = {
   handleSuspendDriver, handleResumeDriver,
   handleParamValue, handleParamRequest,
   handleSync,
+#ifdef BRLAPI_SHARED_WINDOW
+  handleSharedWindow, handleSharedUpdate,
+#else /* BRLAPI_SHARED_WINDOW */
+  NULL, NULL,
+#endif /* BRLAPI_SHARED_WINDOW */
+  handleWritePatch,
 };
 
 static void handleNewConnection(Connection *c)
@@ -2700,11 +3145,15 @@ static int processRequest(Connection *c, PacketHandlers *handlers)
   size = c->packet.header.size;
   type = c->packet.header.type;
 
-  if (c->auth!=1) return handleUnauthorizedConnection(c, type, packet, size);
+  if (c->auth!=1) {
+    res = handleUnauthorizedConnection(c, type, packet, size);
+    goto done;
+  }
 
+  res = 0;
   if (size>BRLAPI_MAXPACKETSIZE) {
     logMessage(LOG_WARNING, "Discarding too large packet of type %s on fd %"PRIfd,brlapiserver_getPacketTypeName(type), c->fd);
-    return 0;
+    goto done;
   }
   switch (type) {
     case BRLAPI_PACKET_GETDRIVERNAME: p = handlers->getDriverName; break;
@@ -2724,6 +3173,9 @@ static int processRequest(Connection *c, PacketHandlers *handlers)
     case BRLAPI_PACKET_PARAM_VALUE: p = handlers->parameterValue; break;
     case BRLAPI_PACKET_PARAM_REQUEST: p = handlers->parameterRequest; break;
     case BRLAPI_PACKET_SYNCHRONIZE: p = handlers->sync; break;
+    case BRLAPI_PACKET_SHAREDWINDOW: p = handlers->sharedWindow; break;
+    case BRLAPI_PACKET_SHAREDUPDATE: p = handlers->sharedUpdate; break;
+    case BRLAPI_PACKET_WRITEPATCH: p = handlers->writePatch; break;
   }
   if (p!=NULL) {
     logRequest(type, c->fd);
@@ -2731,7 +3183,13 @@ static int processRequest(Connection *c, PacketHandlers *handlers)
   } else {
     WEXC(c->fd,BRLAPI_ERROR_UNKNOWN_INSTRUCTION, type, packet, size, "unknown packet type %x", type);
   }
-  return 0;
+
+done:
+#ifdef BRLAPI_SHARED_WINDOW
+  /* Descriptors which were not taken by the handler are not needed */
+  brlapi_forgetPassedDescriptor(&c->packet);
+#endif /* BRLAPI_SHARED_WINDOW */
+  return res;
 }
 
 /****************************************************************************/
@@ -3471,7 +3929,7 @@ static void closeSockets(void *arg)
 #ifdef __MINGW32__
 static void addTtyFds(HANDLE **lpHandles, int *nbAlloc, int *nbHandles, Tty *tty) {
 #else /* __MINGW32__ */
-static void addTtyFds(fd_set *fds, int *fdmax, Tty *tty) {
+static void addTtyFds(fd_set *fds, fd_set *writeFds, int *fdmax, Tty *tty) {
 #endif /* __MINGW32__ */
   {
     Connection *c;
@@ -3485,6 +3943,7 @@ static void addTtyFds(fd_set *fds, int *fdmax, Tty *tty) {
 #else /* __MINGW32__ */
       if (c->fd>*fdmax) *fdmax = c->fd;
       FD_SET(c->fd,fds);
+      if (c->pendingParamUpdates) FD_SET(c->fd,writeFds);
 #endif /* __MINGW32__ */
     }
   }
@@ -3494,11 +3953,26 @@ static void addTtyFds(fd_set *fds, int *fdmax, Tty *tty) {
 #ifdef __MINGW32__
       addTtyFds(lpHandles, nbAlloc, nbHandles, t);
 #else /* __MINGW32__ */
-      addTtyFds(fds,fdmax,t);
+      addTtyFds(fds,writeFds,fdmax,t);
 #endif /* __MINGW32__ */
   }
 }
 
+#ifndef __MINGW32__
+/* Function: flushTtyParamUpdates */
+/* recursively send pending parameter updates to clients which have drained */
+static void flushTtyParamUpdates(fd_set *writeFds, Tty *tty) {
+  Connection *c;
+  Tty *t;
+
+  for (c = tty->connections->next; c != tty->connections; c = c->next)
+    if (c->pendingParamUpdates && FD_ISSET(c->fd, writeFds))
+      flushParamUpdates(c);
+  for (t = tty->subttys; t; t = t->next)
+    flushTtyParamUpdates(writeFds, t);
+}
+#endif /* __MINGW32__ */
+
 /* Function: handleTtyFds */
 /* recursively handle ttys' fds */
 static void handleTtyFds(fd_set *fds, time_t currentTime, Tty *tty) {
@@ -3611,11 +4085,22 @@ THREAD_FUNCTION(runServer) {
   int nbHandles = 0;
 #else /* __MINGW32__ */
   int fdmax;
+  fd_set writeset;
 #endif /* __MINGW32__ */
 
   logMessage(LOG_CATEGORY(SERVER_EVENTS), "server thread started");
   if (!prepareThread()) goto finished;
 
+#ifndef __MINGW32__
+  if (pipe(paramWakeupPipe) != -1) {
+    setBlockingIo(paramWakeupPipe[0], 0);
+    setBlockingIo(paramWakeupPipe[1], 0);
+  } else {
+    logSystemError("parameter wakeup pipe");
+    paramWakeupPipe[0] = paramWakeupPipe[1] = INVALID_FILE_DESCRIPTOR;
+  }
+#endif /* __MINGW32__ */
+
   if (auth && !isAbsolutePath(auth)) {
     if (!(authDescriptor = authBeginServer(auth))) {
       logMessage(LOG_WARNING, "Unable to start auth server");
@@ -3741,12 +4226,20 @@ THREAD_FUNCTION(runServer) {
 #else /* __MINGW32__ */
     /* Compute sockets set and fdmax */
     FD_ZERO(&sockset);
+    FD_ZERO(&writeset);
     fdmax=0;
 
+    if (paramWakeupPipe[0] != INVALID_FILE_DESCRIPTOR) {
+      FD_SET(paramWakeupPipe[0], &sockset);
+      fdmax = paramWakeupPipe[0];
+    }
+
+    lockMutex(&apiParamMutex);
     lockMutex(&apiConnectionsMutex);
-    addTtyFds(&sockset, &fdmax, &notty);
-    addTtyFds(&sockset, &fdmax, &ttys);
+    addTtyFds(&sockset, &writeset, &fdmax, &notty);
+    addTtyFds(&sockset, &writeset, &fdmax, &ttys);
     unlockMutex(&apiConnectionsMutex);
+    unlockMutex(&apiParamMutex);
 
     {
       struct timeval tv, *timeout;
@@ -3771,12 +4264,26 @@ THREAD_FUNCTION(runServer) {
         }
       unlockMutex(&apiSocketsMutex);
 
-      if (select(fdmax+1, &sockset, NULL, NULL, timeout) < 0) {
+      if (select(fdmax+1, &sockset, &writeset, NULL, timeout) < 0) {
         if (fdmax==0) continue; /* still no server socket */
         logMessage(LOG_WARNING,"select: %s",strerror(errno));
         break;
       }
     }
+
+    if ((paramWakeupPipe[0] != INVALID_FILE_DESCRIPTOR) &&
+        FD_ISSET(paramWakeupPipe[0], &sockset)) {
+      unsigned char buffer[0X40];
+      while (read(paramWakeupPipe[0], buffer, sizeof(buffer)) > 0);
+      FD_CLR(paramWakeupPipe[0], &sockset);
+    }
+
+    lockMutex(&apiParamMutex);
+    lockMutex(&apiConnectionsMutex);
+    flushTtyParamUpdates(&writeset, &notty);
+    flushTtyParamUpdates(&writeset, &ttys);
+    unlockMutex(&apiConnectionsMutex);
+    unlockMutex(&apiParamMutex);
 #endif /* __MINGW32__ */
 
     time(&currentTime);
@@ -3877,6 +4384,15 @@ THREAD_FUNCTION(runServer) {
 #endif /* __MINGW32__ */
 
 finished:
+#ifndef __MINGW32__
+  for (i=0; i<2; i+=1) {
+    if (paramWakeupPipe[i] != INVALID_FILE_DESCRIPTOR) {
+      closeFileDescriptor(paramWakeupPipe[i]);
+      paramWakeupPipe[i] = INVALID_FILE_DESCRIPTOR;
+    }
+  }
+#endif /* __MINGW32__ */
+
   logMessage(LOG_CATEGORY(SERVER_EVENTS), "server thread finished");
   return NULL;
 }
@@ -4145,6 +4661,96 @@ static int api_writeWindow(BrailleDisplay *brl, const wchar_t *text)
   return ok;
 }
 
+/* Key batches are only handled from the core thread, with
+ * apiConnectionsMutex locked, so a single alarm serves all the connections. */
+static AsyncHandle keyBatchAlarm = NULL;
+static TimeValue keyBatchAlarmTime;
+
+static void flushKeyBatch(Connection *c)
+{
+  if (c->keyBatch.count == 1) {
+    writeKey(c->fd, c->keyBatch.codes[0]);
+  } else if (c->keyBatch.count > 1) {
+    writeKeys(c->fd, c->keyBatch.codes, c->keyBatch.count);
+  }
+  c->keyBatch.count = 0;
+}
+
+/* Function: flushDueKeyBatches */
+/* Sends the batches whose deadline has passed, and records the earliest */
+/* deadline of those which are still pending */
+static int flushDueKeyBatches(Tty *tty, const TimeValue *now, TimeValue *next)
+{
+  Connection *c;
+  Tty *t;
+  int pending = 0;
+  for (c=tty->connections->next; c!=tty->connections; c = c->next) {
+    if (!c->keyBatch.count) continue;
+    if (compareTimeValues(&c->keyBatch.deadline, now) <= 0) {
+      flushKeyBatch(c);
+    } else {
+      if (!pending || (compareTimeValues(&c->keyBatch.deadline, next) < 0))
+        *next = c->keyBatch.deadline;
+      pending = 1;
+    }
+  }
+  for (t = tty->subttys; t; t = t->next) {
+    TimeValue subNext;
+    if (flushDueKeyBatches(t, now, &subNext)) {
+      if (!pending || (compareTimeValues(&subNext, next) < 0))
+        *next = subNext;
+      pending = 1;
+    }
+  }
+  return pending;
+}
+
+static void scheduleKeyBatchAlarm(const TimeValue *deadline);
+
+ASYNC_ALARM_CALLBACK(handleKeyBatchAlarm)
+{
+  TimeValue now, next;
+  asyncDiscardHandle(keyBatchAlarm);
+  keyBatchAlarm = NULL;
+
+  getMonotonicTime(&now);
+  lockMutex(&apiConnectionsMutex);
+  if (flushDueKeyBatches(&ttys, &now, &next)) scheduleKeyBatchAlarm(&next);
+  unlockMutex(&apiConnectionsMutex);
+}
+
+static void scheduleKeyBatchAlarm(const TimeValue *deadline)
+{
+  if (keyBatchAlarm) {
+    if (compareTimeValues(deadline, &keyBatchAlarmTime) >= 0) return;
+    if (!asyncResetAlarmTo(keyBatchAlarm, deadline)) return;
+  } else if (!asyncNewAbsoluteAlarm(&keyBatchAlarm, deadline, handleKeyBatchAlarm, NULL)) {
+    return;
+  }
+  keyBatchAlarmTime = *deadline;
+}
+
+/* Function: sendKey */
+/* Sends a key to a connection, possibly holding it back for a while so */
+/* that it gets delivered along with the following ones */
+static void sendKey(Connection *c, brlapi_keyCode_t code)
+{
+  if (!c->keyBatchDelay) {
+    flushKeyBatch(c);
+    writeKey(c->fd, code);
+    return;
+  }
+
+  if (!c->keyBatch.count) {
+    getMonotonicTime(&c->keyBatch.deadline);
+    adjustTimeValue(&c->keyBatch.deadline, c->keyBatchDelay);
+    scheduleKeyBatchAlarm(&c->keyBatch.deadline);
+  }
+
+  c->keyBatch.codes[c->keyBatch.count++] = code;
+  if (c->keyBatch.count == KEY_BATCH_SIZE) flushKeyBatch(c);
+}
+
 /* Function: whoGetsKey */
 /* Returns the connection which gets that key */
 static Connection *whoGetsKey(Tty *tty, brlapi_keyCode_t code, unsigned int how, unsigned int retainDots)
@@ -4177,7 +4783,7 @@ static void broadcastKey(Tty *tty, brlapi_keyCode_t code, unsigned int how) {
   for (c=tty->connections->next; c!=tty->connections; c = c->next) {
     lockMutex(&c->acceptedKeysMutex);
     if ((c->how==how) && (inKeyrangeList(c->acceptedKeys,code) != NULL))
-      writeKey(c->fd,code);
+      sendKey(c,code);
     unlockMutex(&c->acceptedKeysMutex);
   }
   for (t = tty->subttys; t; t = t->next)
@@ -4195,7 +4801,7 @@ static int api__handleKeyEvent(brlapi_keyCode_t clientCode) {
   /* somebody gets the raw code */
   if ((c = whoGetsKey(&ttys, clientCode, BRL_KEYCODES, 0))) {
     logMessage(LOG_CATEGORY(SERVER_EVENTS), "transmitting accepted key %016"BRLAPI_PRIxKEYCODE" to fd %"PRIfd,clientCode,c->fd);
-    writeKey(c->fd,clientCode);
+    sendKey(c,clientCode);
     return 1;
   }
   return 0;
@@ -4252,7 +4858,7 @@ static int api__handleCommand(int command) {
 
     if (c) {
       logMessage(LOG_CATEGORY(SERVER_EVENTS), "transmitting accepted command %lx as client code %016"BRLAPI_PRIxKEYCODE" to fd %"PRIfd,(unsigned long)command,code,c->fd);
-      writeKey(c->fd, code);
+      sendKey(c, code);
       return 1;
     }
   }
@@ -4331,6 +4937,10 @@ int api_flushOutput(BrailleDisplay *brl) {
   c = whoFillsTty(&ttys);
   if (!offline && c) {
     lockMutex(&c->brailleWindowMutex);
+#ifdef BRLAPI_SHARED_WINDOW
+    if (c->sharedWindow.updateBegin != c->sharedWindow.updateEnd || c->sharedWindow.updateCursor)
+      readSharedWindow(c);
+#endif /* BRLAPI_SHARED_WINDOW */
     lockMutex(&apiDriverMutex);
     if (!driverConstructed && !driverConstructing) {
       if (!resumeBrailleDriver(brl)) {
@@ -4625,5 +5235,9 @@ noNottyConnections:
 /* Closes the driver */
 void api_stopServer(BrailleDisplay *brl)
 {
+  if (keyBatchAlarm) {
+    asyncCancelRequest(keyBatchAlarm);
+    keyBatchAlarm = NULL;
+  }
   terminationHandler();
 }
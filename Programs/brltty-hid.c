@@ -28,9 +28,11 @@
 #include "log.h"
 #include "strfmt.h"
 #include "parse.h"
+#include "timing.h"
 #include "io_hid.h"
 #include "hid_items.h"
 #include "hid_inspect.h"
+#include "hid_reports.h"
 
 static int opt_matchUSBDevices;
 static int opt_matchBluetoothDevices;
@@ -53,6 +55,8 @@ static int opt_showHostDevice;
 
 static int opt_listItems;
 static int opt_listReports;
+static int opt_listFields;
+static char *opt_benchmarkDecoding;
 
 static char *opt_readReport;
 static char *opt_readFeature;
@@ -195,6 +199,19 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = strtext("List each report's identifier and sizes.")
   },
 
+  { .word = "list-fields",
+    .letter = 'F',
+    .setting.flag = &opt_listFields,
+    .description = strtext("List each report's compiled fields.")
+  },
+
+  { .word = "benchmark-decoding",
+    .letter = 'B',
+    .argument = strtext("count"),
+    .setting.string = &opt_benchmarkDecoding,
+    .description = strtext("Decode each input report the specified number of times and show how long it takes.")
+  },
+
   { .word = "read-report",
     .letter = 'r',
     .argument = strtext("identifier"),
@@ -321,11 +338,18 @@ getItems (HidDevice *device) {
   return items;
 }
 
+static const HidReportTable *
+getReportTable (HidDevice *device) {
+  const HidReportTable *table = hidGetReportTable(device);
+  if (!table) logMessage(LOG_ERR, "HID report table not available");
+  return table;
+}
+
 static int
 getReportSize (HidDevice *device, HidReportIdentifier identifier, HidReportSize *size) {
-  const HidItemsDescriptor *items = getItems(device);
-  if (!items) return 0;
-  return hidReportSize(items, identifier, size);
+  const HidReportTable *table = getReportTable(device);
+  if (!table) return 0;
+  return hidGetCompiledReportSize(table, identifier, size);
 }
 
 static void
@@ -441,7 +465,7 @@ performListReports (HidDevice *device) {
     STR_BEGIN(line, sizeof(line));
     STR_PRINTF("Report %02X:", identifier);
 
-    if (hidReportSize(items, identifier, &size)) {
+    if (getReportSize(device, identifier, &size)) {
       typedef struct {
         const char *label;
         const size_t value;
@@ -482,6 +506,94 @@ performListReports (HidDevice *device) {
   return 1;
 }
 
+static int
+performListFields (HidDevice *device) {
+  const HidReportTable *table = getReportTable(device);
+  if (!table) return 0;
+  return hidListReportTable(table, listItem, NULL);
+}
+
+static int benchmarkCount;
+
+static int
+parseBenchmarkDecoding (void) {
+  benchmarkCount = 0;
+  if (!*opt_benchmarkDecoding) return 1;
+
+  static const int minimum = 1;
+
+  if (!validateInteger(&benchmarkCount, opt_benchmarkDecoding, &minimum, NULL)) {
+    logMessage(LOG_ERR, "invalid benchmark count: %s", opt_benchmarkDecoding);
+    return 0;
+  }
+
+  return 1;
+}
+
+static int
+performBenchmarkDecoding (HidDevice *device) {
+  const HidItemsDescriptor *items = getItems(device);
+  if (!items) return 0;
+
+  const HidReportTable *table = getReportTable(device);
+  if (!table) return 0;
+
+  for (unsigned int index=0; index<table->reportCount; index+=1) {
+    const HidReportLayout *report = &table->reports[index];
+    if (report->type != HID_RPT_Input) continue;
+
+    HidReportIdentifier identifier = report->identifier;
+    size_t size = ((report->bitCount + 7) / 8) + (identifier? 1: 0);
+    unsigned char buffer[size + 8];
+
+    for (unsigned int byte=0; byte<sizeof(buffer); byte+=1) {
+      buffer[byte] = byte * 0X5B;
+    }
+
+    buffer[0] = identifier;
+
+    const HidReportField *fields = hidGetReportFields(table, report);
+    const HidReportField *end = fields + report->fieldCount;
+    HidSignedValue sum = 0;
+    TimeValue start;
+
+    getMonotonicTime(&start);
+
+    for (int iteration=0; iteration<benchmarkCount; iteration+=1) {
+      for (const HidReportField *field=fields; field<end; field+=1) {
+        for (unsigned int element=0; element<field->count; element+=1) {
+          HidSignedValue value;
+          if (hidGetFieldValue(field, buffer, size, element, &value)) sum += value;
+        }
+      }
+    }
+
+    long int decodeTime = getMonotonicElapsedMicroseconds(&start);
+    HidReportSize reportSize;
+
+    getMonotonicTime(&start);
+    for (int iteration=0; iteration<benchmarkCount; iteration+=1) {
+      hidReportSize(items, identifier, &reportSize);
+    }
+    long int walkTime = getMonotonicElapsedMicroseconds(&start);
+
+    getMonotonicTime(&start);
+    for (int iteration=0; iteration<benchmarkCount; iteration+=1) {
+      hidGetCompiledReportSize(table, identifier, &reportSize);
+    }
+    long int lookupTime = getMonotonicElapsedMicroseconds(&start);
+
+    fprintf(outputStream,
+      "Report %02X: Fields:%u Decode:%ldus Size[walk]:%ldus Size[table]:%ldus Sum:%" PRId32 "\n",
+      identifier, report->fieldCount, decodeTime, walkTime, lookupTime, sum
+    );
+
+    if (!canWriteOutput()) return 0;
+  }
+
+  return 1;
+}
+
 static int
 isReportIdentifier (HidReportIdentifier *identifier, const char *string, unsigned char minimum) {
   if (strlen(string) != 2) return 0;
@@ -972,6 +1084,9 @@ parseOperands (void) {
 
     { .parse = parseInputTimeout,
     },
+
+    { .parse = parseBenchmarkDecoding,
+    },
   };
 
   const OperandEntry *operand = operandTable;
@@ -1033,6 +1148,15 @@ performActions (HidDevice *device) {
       .option.flag = &opt_listReports,
     },
 
+    { .perform = performListFields,
+      .isFlag = 1,
+      .option.flag = &opt_listFields,
+    },
+
+    { .perform = performBenchmarkDecoding,
+      .option.string = &opt_benchmarkDecoding,
+    },
+
     { .perform = performReadReport,
       .option.string = &opt_readReport,
     },
@@ -77,7 +77,7 @@ speakDone (const ScreenCharacter *line, int column, int count, int spell) {
     line = internalBuffer;
   }
 
-  speakCharacters(line, count, spell, 1);
+  speakCharacters(line, count, spell, SAY_OPT_MUTE_FIRST);
   placeBrailleWindowHorizontally(ses->spkx);
   slideBrailleWindowVertically(ses->spky);
   suppressAutospeak();
@@ -504,7 +504,7 @@ handleSpeechCommands (int command, void *data) {
     }
 
     case BRL_CMD_SPEAK_INDENT:
-      speakIndent(NULL, 0, 1);
+      speakIndent(NULL, 0, 1, SAY_OPT_CLASS_REQUESTED);
       break;
 
     default:
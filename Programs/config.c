@@ -37,6 +37,7 @@
 #include "update.h"
 #include "cmd.h"
 #include "cmd_navigation.h"
+#include "routing.h"
 #include "brl.h"
 #include "brl_utils.h"
 #include "spk.h"
@@ -236,6 +237,7 @@ static int opt_noDaemon;
 static int opt_standardError;
 static char *opt_logLevel;
 static char *opt_logFile;
+static char *opt_ioCaptureFile;
 static int opt_bootParameters = 1;
 static int opt_environmentVariables;
 static char *opt_messageTime;
@@ -704,6 +706,12 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = strtext("Parameters for the screen driver.")
   },
 
+  { .word = "predictive-routing",
+    .flags = OPT_Hidden | OPT_Config | OPT_EnvVar,
+    .setting.flag = &opt_predictiveRouting,
+    .description = strtext("Route the cursor by sending batches of arrow keys.")
+  },
+
 #ifdef HAVE_PCM_SUPPORT
   { .word = "pcm-device",
     .letter = 'p',
@@ -712,6 +720,12 @@ BEGIN_OPTION_TABLE(programOptions)
     .setting.string = &opt_pcmDevice,
     .description = strtext("PCM (soundcard digital audio) device specifier.")
   },
+
+  { .word = "pcm-low-latency",
+    .flags = OPT_Hidden | OPT_Config | OPT_EnvVar,
+    .setting.flag = &opt_pcmLowLatency,
+    .description = strtext("Keep the PCM device open, and configure it for low latency.")
+  },
 #endif /* HAVE_PCM_SUPPORT */
 
 #ifdef HAVE_MIDI_SUPPORT
@@ -763,6 +777,13 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = strtext("Path to log file.")
   },
 
+  { .word = "io-capture-file",
+    .flags = OPT_Hidden | OPT_EnvVar,
+    .argument = strtext("file"),
+    .setting.string = &opt_ioCaptureFile,
+    .description = strtext("Path to file for capturing device input/output (for replaying via replay:file=).")
+  },
+
   { .word = "verify",
     .letter = 'v',
     .setting.flag = &opt_verify,
@@ -888,6 +909,8 @@ brlttyPrepare (int argc, char *argv[]) {
     openSystemLog();
   }
 
+  if (*opt_ioCaptureFile) gioStartCapture(opt_ioCaptureFile);
+
   logProgramBanner();
   logProperty(opt_logLevel, "logLevel", gettext("Log Level"));
   logProperty(getMessagesLocale(), "messagesLocale", gettext("Messages Locale"));
@@ -1823,75 +1846,247 @@ initializeBrailleDriver (const char *code, int verify) {
   return 0;
 }
 
+/* The driver and device that were last activated are remembered in the
+ * updatable directory so that the next autodetection (e.g. at boot or after
+ * the display has been reconnected) tries them first.
+ */
+static const char lastBrailleDeviceFile[] = "braille-device";
+
+typedef struct {
+  char driver[0X10];
+  char device[0X100];
+} LastBrailleDevice;
+
+static FILE *
+openLastBrailleDevice (const char *mode) {
+  FILE *stream = NULL;
+  char *path = makeUpdatablePath(lastBrailleDeviceFile);
+
+  if (path) {
+    stream = openFile(path, mode, 1);
+    free(path);
+  }
+
+  return stream;
+}
+
 static int
-activateBrailleDriver (int verify) {
-  int oneDevice = brailleDevices[0] && !brailleDevices[1];
-  const char *const *device = (const char *const *)brailleDevices;
+loadLastBrailleDevice (LastBrailleDevice *last) {
+  int ok = 0;
+  FILE *stream = openLastBrailleDevice("r");
 
-  if (!oneDevice) verify = 0;
+  if (stream) {
+    char line[sizeof(last->driver) + sizeof(last->device) + 2];
 
-  while (*device) {
-    const char *const *autodetectableDrivers = NULL;
+    if (fgets(line, sizeof(line), stream)) {
+      char *device = strchr(line, '\t');
 
-    brailleDevice = *device;
-    logMessage(LOG_DEBUG, "checking braille device: %s", brailleDevice);
+      if (device) {
+        *device++ = 0;
+        device[strcspn(device, "\n")] = 0;
 
-    {
-      const char *dev = brailleDevice;
-      const GioPublicProperties *properties = gioGetPublicProperties(&dev);
+        if (*line && *device &&
+            (strlen(line) < sizeof(last->driver)) &&
+            (strlen(device) < sizeof(last->device))) {
+          strcpy(last->driver, line);
+          strcpy(last->device, device);
+          ok = 1;
+        }
+      }
+    }
 
-      if (properties) {
-        logMessage(LOG_DEBUG, "braille device type: %s", properties->type.name);
+    fclose(stream);
+  }
 
-        switch (properties->type.identifier) {
-          case GIO_TYPE_SERIAL: {
-            autodetectableDrivers = autodetectableBrailleDrivers_serial;
-            break;
-          }
+  return ok;
+}
 
-          case GIO_TYPE_USB: {
-            autodetectableDrivers = autodetectableBrailleDrivers_USB;
-            break;
-          }
+static void
+saveLastBrailleDevice (const LastBrailleDevice *last, int haveLast) {
+  const char *driver = braille->definition.code;
 
-          case GIO_TYPE_BLUETOOTH: {
-            if (!(autodetectableDrivers = bthGetDriverCodes(dev, BLUETOOTH_DEVICE_NAME_OBTAIN_TIMEOUT))) {
-              autodetectableDrivers = autodetectableBrailleDrivers_Bluetooth;
-            }
+  if (haveLast) {
+    if ((strcmp(driver, last->driver) == 0) &&
+        (strcmp(brailleDevice, last->device) == 0)) {
+      return;
+    }
+  }
 
-            break;
+  {
+    FILE *stream = openLastBrailleDevice("w");
+
+    if (stream) {
+      fprintf(stream, "%s\t%s\n", driver, brailleDevice);
+      if (fclose(stream) == EOF) logSystemError("fclose");
+    }
+  }
+}
+
+static const char *const *
+selectBrailleDrivers (
+  const char **buffer, const char *const *drivers,
+  const char *const *attached, const char *preferred
+) {
+  const char **next = buffer;
+
+  if (preferred) {
+    for (const char *const *driver=drivers; *driver; driver+=1) {
+      if (strcmp(*driver, preferred) == 0) {
+        *next++ = *driver;
+        break;
+      }
+    }
+  }
+
+  for (const char *const *driver=drivers; *driver; driver+=1) {
+    if (preferred && (strcmp(*driver, preferred) == 0)) continue;
+
+    if (attached) {
+      const char *const *code = attached;
+
+      while (*code) {
+        if (strcmp(*code, *driver) == 0) break;
+        code += 1;
+      }
+
+      if (!*code) continue;
+    }
+
+    *next++ = *driver;
+  }
+
+  if (attached && (next == buffer)) {
+    return selectBrailleDrivers(buffer, drivers, NULL, preferred);
+  }
+
+  *next = NULL;
+  return buffer;
+}
+
+static int
+activateBrailleDevice (const char *device, const char *preferredDriver, int verify) {
+  const char *const *autodetectableDrivers = NULL;
+  const char **attachedDrivers = NULL;
+
+  brailleDevice = device;
+  logMessage(LOG_DEBUG, "checking braille device: %s", brailleDevice);
+
+  {
+    const char *dev = brailleDevice;
+    const GioPublicProperties *properties = gioGetPublicProperties(&dev);
+
+    if (properties) {
+      logMessage(LOG_DEBUG, "braille device type: %s", properties->type.name);
+
+      switch (properties->type.identifier) {
+        case GIO_TYPE_SERIAL: {
+          autodetectableDrivers = autodetectableBrailleDrivers_serial;
+          break;
+        }
+
+        case GIO_TYPE_USB: {
+          autodetectableDrivers = autodetectableBrailleDrivers_USB;
+          attachedDrivers = usbGetAttachedDriverCodes();
+          break;
+        }
+
+        case GIO_TYPE_BLUETOOTH: {
+          if (!(autodetectableDrivers = bthGetDriverCodes(dev, BLUETOOTH_DEVICE_NAME_OBTAIN_TIMEOUT))) {
+            autodetectableDrivers = autodetectableBrailleDrivers_Bluetooth;
           }
 
-          default:
-            break;
+          break;
         }
-      } else {
-        logMessage(LOG_DEBUG, "unrecognized braille device type");
+
+        default:
+          break;
       }
+    } else {
+      logMessage(LOG_DEBUG, "unrecognized braille device type");
     }
+  }
 
-    if (!autodetectableDrivers) {
-      static const char *noDrivers[] = {NULL};
-      autodetectableDrivers = noDrivers;
-    }
+  if (!autodetectableDrivers) {
+    static const char *noDrivers[] = {NULL};
+    autodetectableDrivers = noDrivers;
+  }
+
+  {
+    size_t count = 0;
+    while (autodetectableDrivers[count]) count += 1;
 
     {
-      const DriverActivationData data = {
-        .driverType = "braille",
-        .requestedDrivers = (const char *const *)brailleDrivers,
-        .autodetectableDrivers = autodetectableDrivers,
-        .getDefaultDriver = getDefaultBrailleDriver,
-        .haveDriver = haveBrailleDriver,
-        .initializeDriver = initializeBrailleDriver
-      };
-      if (activateDriver(&data, verify)) return 1;
+      const char *drivers[count + 1];
+      int activated;
+
+      {
+        const DriverActivationData data = {
+          .driverType = "braille",
+          .requestedDrivers = (const char *const *)brailleDrivers,
+
+          .autodetectableDrivers = selectBrailleDrivers(
+            drivers, autodetectableDrivers,
+            (const char *const *)attachedDrivers, preferredDriver
+          ),
+
+          .getDefaultDriver = getDefaultBrailleDriver,
+          .haveDriver = haveBrailleDriver,
+          .initializeDriver = initializeBrailleDriver
+        };
+
+        activated = activateDriver(&data, verify);
+      }
+
+      if (attachedDrivers) free(attachedDrivers);
+      return activated;
+    }
+  }
+}
+
+static int
+activateBrailleDriver (int verify) {
+  int oneDevice = brailleDevices[0] && !brailleDevices[1];
+  const char *const *device = (const char *const *)brailleDevices;
+  const char *lastDevice = NULL;
+  int activated = 0;
+
+  LastBrailleDevice last;
+  int haveLast = loadLastBrailleDevice(&last);
+
+  if (!oneDevice) verify = 0;
+
+  if (haveLast) {
+    while (*device) {
+      if (strcmp(*device, last.device) == 0) {
+        lastDevice = *device;
+        logMessage(LOG_DEBUG, "trying last braille device first: %s -> %s",
+                   last.driver, lastDevice);
+
+        activated = activateBrailleDevice(lastDevice, last.driver, verify);
+        break;
+      }
+
+      device += 1;
+    }
+
+    device = (const char *const *)brailleDevices;
+  }
+
+  while (!activated && *device) {
+    if (*device != lastDevice) {
+      activated = activateBrailleDevice(*device, NULL, verify);
     }
 
     device += 1;
   }
 
-  brailleDevice = NULL;
-  return 0;
+  if (!activated) {
+    brailleDevice = NULL;
+    return 0;
+  }
+
+  if (braille != &noBraille) saveLastBrailleDevice(&last, haveLast);
+  return 1;
 }
 
 static void
@@ -1997,6 +2192,32 @@ static const ActivityMethods brailleDriverActivityMethods = {
 
 static ActivityObject *brailleDriverActivity = NULL;
 
+static USB_HOTPLUG_HANDLER(handleBrailleHotplug) {
+  ActivityObject *activity = brailleDriverActivity;
+
+  if (!activity) return;
+  if (isActivityStopped(activity)) return;
+
+  if (isActivityStarted(activity)) {
+    if (!parameters->arrived && parameters->opened) {
+      const char *const *code = parameters->driverCodes;
+
+      while (*code) {
+        if (strcmp(*code, braille->definition.code) == 0) {
+          logMessage(LOG_DEBUG, "braille device removed");
+          brl.hasFailed = 1;
+          break;
+        }
+
+        code += 1;
+      }
+    }
+  } else if (parameters->arrived) {
+    logMessage(LOG_DEBUG, "braille device arrived");
+    startActivity(activity);
+  }
+}
+
 static void
 writeBrailleMessage (const char *text) {
   clearStatusCells(&brl);
@@ -2018,6 +2239,8 @@ exitBrailleDriver (void *data) {
     writeBrailleMessage(text);
   }
 
+  usbSetHotplugHandler(NULL, NULL);
+
   if (brailleDriverActivity) {
     destroyActivity(brailleDriverActivity);
     brailleDriverActivity = NULL;
@@ -2035,6 +2258,7 @@ getBrailleDriverActivity (int allocate) {
       }
 
       onProgramExit("braille-driver", exitBrailleDriver, NULL);
+      usbSetHotplugHandler(handleBrailleHotplug, NULL);
     }
   }
 
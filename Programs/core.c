@@ -1037,9 +1037,8 @@ sayScreenCharacters (const ScreenCharacter *characters, size_t count, SayOptions
 }
 
 void
-speakCharacters (const ScreenCharacter *characters, size_t count, int spell, int interrupt) {
-  SayOptions sayOptions = 0;
-  if (interrupt) sayOptions |= SAY_OPT_MUTE_FIRST;
+speakCharacters (const ScreenCharacter *characters, size_t count, int spell, SayOptions options) {
+  SayOptions sayOptions = options;
 
   if (isAllSpaceCharacters(characters, count)) {
     switch (prefs.speechWhitespaceIndicator) {
@@ -1106,7 +1105,7 @@ speakCharacters (const ScreenCharacter *characters, size_t count, int spell, int
 }
 
 int
-speakIndent (const ScreenCharacter *characters, int count, int evenIfNoIndent) {
+speakIndent (const ScreenCharacter *characters, int count, int evenIfNoIndent, SayOptions options) {
   int length = scr.cols;
   ScreenCharacter buffer[length];
 
@@ -1132,7 +1131,7 @@ speakIndent (const ScreenCharacter *characters, int count, int evenIfNoIndent) {
   logMessage(LOG_CATEGORY(SPEECH_EVENTS),
              "line indent: %d", indent);
 
-  sayString(&spk, text, SAY_OPT_MUTE_FIRST);
+  sayString(&spk, text, (options | SAY_OPT_MUTE_FIRST));
   return 1;
 }
 #endif /* ENABLE_SPEECH_SUPPORT */
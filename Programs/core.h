@@ -213,8 +213,8 @@ extern int isAutospeakActive (void);
 extern unsigned int autospeakMinimumScreenContentQuality;
 
 extern void sayScreenCharacters (const ScreenCharacter *characters, size_t count, SayOptions options);
-extern void speakCharacters (const ScreenCharacter *characters, size_t count, int spell, int interrupt);
-extern int speakIndent (const ScreenCharacter *characters, int count, int evenIfNoIndent);
+extern void speakCharacters (const ScreenCharacter *characters, size_t count, int spell, SayOptions options);
+extern int speakIndent (const ScreenCharacter *characters, int count, int evenIfNoIndent, SayOptions options);
 extern void trackSpeech (void);
 
 extern void enableSpeechDriver (int sayBanner);
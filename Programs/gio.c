@@ -25,6 +25,8 @@
 #include "async_handle.h"
 #include "async_wait.h"
 #include "async_alarm.h"
+#include "timing.h"
+#include "parameters.h"
 #include "io_generic.h"
 #include "gio_internal.h"
 #include "io_serial.h"
@@ -34,6 +36,7 @@ const GioProperties *const gioProperties[] = {
   &gioProperties_usb,
   &gioProperties_bluetooth,
   &gioProperties_hid,
+  &gioProperties_replay,
   &gioProperties_null,
   NULL
 };
@@ -45,6 +48,7 @@ gioInitializeOptions (GioOptions *options) {
   options->inputTimeout = 0;
   options->outputTimeout = 0;
   options->requestTimeout = 0;
+  options->lowLatency = 0;
 }
 
 void
@@ -90,6 +94,11 @@ gioSetApplicationData (GioEndpoint *endpoint, const void *data) {
   endpoint->options.applicationData = data;
 }
 
+void
+gioAllowOutputCoalescing (GioEndpoint *endpoint) {
+  endpoint->output.canCoalesce = 1;
+}
+
 static int
 gioStartEndpoint (GioEndpoint *endpoint) {
   {
@@ -153,6 +162,16 @@ gioConnectResource (
       endpoint->input.from = 0;
       endpoint->input.to = 0;
 
+      endpoint->output.holdCount = 0;
+      endpoint->output.canCoalesce = 0;
+      endpoint->output.count = 0;
+
+      endpoint->latency.awaitingResponse = 0;
+      endpoint->latency.count = 0;
+      endpoint->latency.total = 0;
+
+      endpoint->capture.session = 0;
+
       if (descriptor && properties->private->getOptions) {
         endpoint->options = *properties->private->getOptions(descriptor);
       } else {
@@ -183,6 +202,7 @@ gioConnectResource (
 
           if (!properties->private->prepareEndpoint || properties->private->prepareEndpoint(endpoint)) {
             if (gioStartEndpoint(endpoint)) {
+              gioCaptureConnect(endpoint, properties->public->type.name);
               return endpoint;
             }
           }
@@ -213,9 +233,60 @@ gioGetApplicationData (GioEndpoint *endpoint) {
   return endpoint->options.applicationData;
 }
 
+static void
+gioNoteRequest (GioEndpoint *endpoint) {
+  if (endpoint->options.lowLatency) {
+    if (endpoint->latency.awaitingResponse) {
+      long int elapsed = getMonotonicElapsedMicroseconds(&endpoint->latency.requestTime);
+      if (elapsed <= (GIO_LATENCY_RESPONSE_TIMEOUT * 1000)) return;
+    }
+
+    getMonotonicTime(&endpoint->latency.requestTime);
+    endpoint->latency.awaitingResponse = 1;
+  }
+}
+
+static void
+gioNoteResponse (GioEndpoint *endpoint) {
+  if (endpoint->latency.awaitingResponse) {
+    long int elapsed = getMonotonicElapsedMicroseconds(&endpoint->latency.requestTime);
+    endpoint->latency.awaitingResponse = 0;
+
+    /* input that long after the last output is unsolicited (e.g. a key) */
+    if (elapsed > (GIO_LATENCY_RESPONSE_TIMEOUT * 1000)) return;
+    logMessage(LOG_CATEGORY(GENERIC_IO), "round-trip latency: %ldus", elapsed);
+
+    if (!endpoint->latency.count++) {
+      endpoint->latency.minimum = endpoint->latency.maximum = elapsed;
+    } else if (elapsed < endpoint->latency.minimum) {
+      endpoint->latency.minimum = elapsed;
+    } else if (elapsed > endpoint->latency.maximum) {
+      endpoint->latency.maximum = elapsed;
+    }
+
+    endpoint->latency.total += elapsed;
+  }
+}
+
+static void
+gioLogLatency (GioEndpoint *endpoint) {
+  unsigned int count = endpoint->latency.count;
+
+  if (count) {
+    logMessage(LOG_INFO,
+      "round-trip latency: %u samples: min:%ldus avg:%ldus max:%ldus",
+      count, endpoint->latency.minimum,
+      (endpoint->latency.total / count), endpoint->latency.maximum
+    );
+  }
+}
+
 int
 gioDisconnectResource (GioEndpoint *endpoint) {
   if (--endpoint->referenceCount > 0) return 1;
+  gioFlushOutput(endpoint);
+  gioLogLatency(endpoint);
+  gioCaptureDisconnect(endpoint);
 
   int ok = 0;
   GioDisconnectResourceMethod *method = endpoint->handleMethods->disconnectResource;
@@ -286,8 +357,8 @@ gioGetResourceObject (GioEndpoint *endpoint) {
   return NULL;
 }
 
-ssize_t
-gioWriteData (GioEndpoint *endpoint, const void *data, size_t size) {
+static ssize_t
+gioWriteHandleData (GioEndpoint *endpoint, const void *data, size_t size) {
   GioWriteDataMethod *method = endpoint->handleMethods->writeData;
 
   if (!method) {
@@ -301,6 +372,11 @@ gioWriteData (GioEndpoint *endpoint, const void *data, size_t size) {
   ssize_t result = method(endpoint->handle, data, size,
                           endpoint->options.outputTimeout);
 
+  if (result > 0) {
+    gioCaptureData(endpoint, GIO_CAPTURE_OUTPUT, data, result);
+    gioNoteRequest(endpoint);
+  }
+
   if (endpoint->options.ignoreWriteTimeouts) {
     if (result == -1) {
       if ((errno == EAGAIN)
@@ -314,6 +390,51 @@ gioWriteData (GioEndpoint *endpoint, const void *data, size_t size) {
   return result;
 }
 
+int
+gioFlushOutput (GioEndpoint *endpoint) {
+  size_t count = endpoint->output.count;
+  if (!count) return 1;
+
+  endpoint->output.count = 0;
+  return gioWriteHandleData(endpoint, endpoint->output.buffer, count) != -1;
+}
+
+void
+gioBeginOutput (GioEndpoint *endpoint) {
+  endpoint->output.holdCount += 1;
+}
+
+int
+gioEndOutput (GioEndpoint *endpoint) {
+  if (endpoint->output.holdCount) {
+    if (--endpoint->output.holdCount) return 1;
+  }
+
+  return gioFlushOutput(endpoint);
+}
+
+ssize_t
+gioWriteData (GioEndpoint *endpoint, const void *data, size_t size) {
+  if (endpoint->output.holdCount && endpoint->output.canCoalesce) {
+    size_t space = sizeof(endpoint->output.buffer) - endpoint->output.count;
+
+    if (size > space) {
+      if (!gioFlushOutput(endpoint)) return -1;
+      space = sizeof(endpoint->output.buffer);
+    }
+
+    if (size <= space) {
+      memcpy(&endpoint->output.buffer[endpoint->output.count], data, size);
+      endpoint->output.count += size;
+      return size;
+    }
+  } else if (!gioFlushOutput(endpoint)) {
+    return -1;
+  }
+
+  return gioWriteHandleData(endpoint, data, size);
+}
+
 int
 gioAwaitInput (GioEndpoint *endpoint, int timeout) {
   GioAwaitInputMethod *method = endpoint->handleMethods->awaitInput;
@@ -325,6 +446,7 @@ gioAwaitInput (GioEndpoint *endpoint, int timeout) {
   }
 
   if (endpoint->input.to - endpoint->input.from) return 1;
+  if (!gioFlushOutput(endpoint)) return 0;
 
   return method(endpoint->handle, timeout);
 }
@@ -339,6 +461,9 @@ gioReadData (GioEndpoint *endpoint, void *buffer, size_t size, int wait) {
     return -1;
   }
 
+  /* a response can't arrive before the request that's still being held */
+  if (!gioFlushOutput(endpoint)) return -1;
+
   {
     unsigned char *start = buffer;
     unsigned char *next = start;
@@ -375,7 +500,9 @@ gioReadData (GioEndpoint *endpoint, void *buffer, size_t size, int wait) {
 
         if (result > 0) {
           logBytes(LOG_CATEGORY(GENERIC_IO), "input", &endpoint->input.buffer[endpoint->input.to], result);
+          gioCaptureData(endpoint, GIO_CAPTURE_INPUT, &endpoint->input.buffer[endpoint->input.to], result);
           endpoint->input.to += result;
+          gioNoteResponse(endpoint);
           wait = 1;
         } else {
           if (!result) break;
@@ -426,6 +553,8 @@ gioReconfigureResource (
   int ok = 1;
   GioReconfigureResourceMethod *method = endpoint->handleMethods->reconfigureResource;
 
+  gioFlushOutput(endpoint);
+
   if (!method) {
     logUnsupportedOperation("reconfigureResource");
   } else if (method(endpoint->handle, parameters)) {
@@ -511,6 +640,19 @@ gioGetHidReportSize (
   return 0;
 }
 
+const HidReportTable *
+gioGetHidReportTable (GioEndpoint *endpoint) {
+  GioGetHidReportTableMethod *method = endpoint->handleMethods->getHidReportTable;
+
+  if (!method) {
+    logUnsupportedOperation("getHidReportTable");
+    errno = ENOSYS;
+    return NULL;
+  }
+
+  return method(endpoint->handle, endpoint->options.requestTimeout);
+}
+
 size_t
 gioGetHidInputSize (
   GioEndpoint *endpoint,
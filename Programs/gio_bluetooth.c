@@ -178,13 +178,20 @@ connectBluetoothResource (
   return NULL;
 }
 
+static int
+prepareBluetoothEndpoint (GioEndpoint *endpoint) {
+  gioAllowOutputCoalescing(endpoint);
+  return 1;
+}
+
 static const GioPrivateProperties gioPrivateProperties_bluetooth = {
   .isSupported = isBluetoothSupported,
 
   .getOptions = getBluetoothOptions,
   .getHandleMethods = getBluetoothMethods,
 
-  .connectResource = connectBluetoothResource
+  .connectResource = connectBluetoothResource,
+  .prepareEndpoint = prepareBluetoothEndpoint
 };
 
 const GioProperties gioProperties_bluetooth = {
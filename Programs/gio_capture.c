@@ -0,0 +1,138 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2022 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <string.h>
+#include <errno.h>
+
+#include "log.h"
+#include "file.h"
+#include "program.h"
+#include "timing.h"
+#include "io_generic.h"
+#include "gio_internal.h"
+
+static FILE *captureStream = NULL;
+static char *capturePath = NULL;
+static unsigned int captureSession = 0;
+
+static void
+gioWriteCaptureLine (GioEndpoint *endpoint, const char *keyword, int timed) {
+  fprintf(captureStream, "%s %u", keyword, endpoint->capture.session);
+
+  if (timed) {
+    long int elapsed = getMonotonicElapsedMicroseconds(&endpoint->capture.start);
+    fprintf(captureStream, " %ld.%06ld", (elapsed / 1000000), (elapsed % 1000000));
+  }
+}
+
+static void
+gioEndCaptureLine (void) {
+  fputc('\n', captureStream);
+
+  if (fflush(captureStream) == EOF) {
+    logMessage(LOG_WARNING, "I/O capture stopped: %s: %s", capturePath, strerror(errno));
+    gioStopCapture();
+  }
+}
+
+void
+gioCaptureConnect (GioEndpoint *endpoint, const char *type) {
+  endpoint->capture.session = 0;
+
+  if (captureStream) {
+    char identifier[0X100];
+
+    endpoint->capture.session = ++captureSession;
+    getMonotonicTime(&endpoint->capture.start);
+
+    gioWriteCaptureLine(endpoint, GIO_CAPTURE_CONNECT, 0);
+    fprintf(captureStream, " %s", type);
+
+    if (gioMakeResourceIdentifier(endpoint, identifier, sizeof(identifier))) {
+      fprintf(captureStream, " %s", identifier);
+    }
+
+    gioEndCaptureLine();
+  }
+}
+
+void
+gioCaptureData (GioEndpoint *endpoint, const char *keyword, const void *data, size_t size) {
+  if (captureStream && endpoint->capture.session) {
+    const unsigned char *byte = data;
+    const unsigned char *end = byte + size;
+
+    gioWriteCaptureLine(endpoint, keyword, 1);
+    while (byte < end) fprintf(captureStream, " %02X", *byte++);
+    gioEndCaptureLine();
+  }
+}
+
+void
+gioCaptureDisconnect (GioEndpoint *endpoint) {
+  if (captureStream && endpoint->capture.session) {
+    gioWriteCaptureLine(endpoint, GIO_CAPTURE_DISCONNECT, 1);
+    gioEndCaptureLine();
+  }
+}
+
+void
+gioStopCapture (void) {
+  if (captureStream) {
+    fclose(captureStream);
+    captureStream = NULL;
+  }
+
+  if (capturePath) {
+    free(capturePath);
+    capturePath = NULL;
+  }
+}
+
+static void
+exitCapture (void *data) {
+  gioStopCapture();
+}
+
+int
+gioStartCapture (const char *path) {
+  static int firstTime = 1;
+
+  gioStopCapture();
+
+  if ((capturePath = strdup(path))) {
+    if ((captureStream = openFile(path, "w", 0))) {
+      if (firstTime) {
+        firstTime = 0;
+        onProgramExit("io-capture", exitCapture, NULL);
+      }
+
+      logMessage(LOG_DEBUG, "I/O capture started: %s", path);
+      return 1;
+    }
+
+    free(capturePath);
+    capturePath = NULL;
+  } else {
+    logMallocError();
+  }
+
+  return 0;
+}
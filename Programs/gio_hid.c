@@ -92,6 +92,11 @@ getHidReportSize (
   return hidGetReportSize(handle->device, identifier, size);
 }
 
+static const HidReportTable *
+getHidReportTable (GioHandle *handle, int timeout) {
+  return hidGetReportTable(handle->device);
+}
+
 static ssize_t
 getHidReport (
   GioHandle *handle, HidReportIdentifier identifier,
@@ -159,6 +164,7 @@ static const GioHandleMethods gioHidMethods = {
   .monitorInput = monitorHidInput,
 
   .getHidReportSize = getHidReportSize,
+  .getHidReportTable = getHidReportTable,
   .getHidReport = getHidReport,
   .setHidReport = setHidReport,
   .getHidFeature = getHidFeature,
@@ -19,6 +19,8 @@
 #ifndef BRLTTY_INCLUDED_GIO_INTERNAL
 #define BRLTTY_INCLUDED_GIO_INTERNAL
 
+#include "timing_types.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -65,6 +67,10 @@ typedef int GioGetHidReportSizeMethod (
   HidReportSize *size, int timeout
 );
 
+typedef const HidReportTable *GioGetHidReportTableMethod (
+  GioHandle *handle, int timeout
+);
+
 typedef ssize_t GioGetHidReportMethod (
   GioHandle *handle, HidReportIdentifier identifier,
   unsigned char *buffer, size_t size, int timeout
@@ -103,6 +109,7 @@ typedef struct {
   GioAskResourceMethod *askResource;
 
   GioGetHidReportSizeMethod *getHidReportSize;
+  GioGetHidReportTableMethod *getHidReportTable;
   GioGetHidReportMethod *getHidReport;
   GioSetHidReportMethod *setHidReport;
   GioGetHidFeatureMethod *getHidFeature;
@@ -121,8 +128,29 @@ struct GioEndpointStruct {
     int error;
     unsigned int from;
     unsigned int to;
-    unsigned char buffer[0X40];
+    unsigned char buffer[0X200];
   } input;
+
+  struct {
+    unsigned int holdCount;
+    unsigned char canCoalesce:1;
+    size_t count;
+    unsigned char buffer[0X400];
+  } output;
+
+  struct {
+    TimeValue requestTime;
+    unsigned char awaitingResponse:1;
+    unsigned int count;
+    long int minimum;
+    long int maximum;
+    long int total;
+  } latency;
+
+  struct {
+    unsigned int session;
+    TimeValue start;
+  } capture;
 };
 
 typedef int GioIsSupportedMethod (const GioDescriptor *descriptor);
@@ -159,9 +187,28 @@ extern const GioProperties gioProperties_usb;
 extern const GioProperties gioProperties_bluetooth;
 extern const GioProperties gioProperties_hid;
 extern const GioProperties gioProperties_null;
+extern const GioProperties gioProperties_replay;
 
 extern void gioSetBytesPerSecond (GioEndpoint *endpoint, const SerialParameters *parameters);
 extern void gioSetApplicationData (GioEndpoint *endpoint, const void *data);
+extern void gioAllowOutputCoalescing (GioEndpoint *endpoint);
+
+/* An I/O capture is a text file with one line per event:
+ *   connect <session> <type> <identifier>
+ *   output <session> <seconds>.<microseconds> <hex byte> ...
+ *   input <session> <seconds>.<microseconds> <hex byte> ...
+ *   disconnect <session> <seconds>.<microseconds>
+ * Sessions are numbered from 1 (one per endpoint) and times are relative
+ * to when the session was connected.
+ */
+#define GIO_CAPTURE_CONNECT "connect"
+#define GIO_CAPTURE_OUTPUT "output"
+#define GIO_CAPTURE_INPUT "input"
+#define GIO_CAPTURE_DISCONNECT "disconnect"
+
+extern void gioCaptureConnect (GioEndpoint *endpoint, const char *type);
+extern void gioCaptureData (GioEndpoint *endpoint, const char *keyword, const void *data, size_t size);
+extern void gioCaptureDisconnect (GioEndpoint *endpoint);
 
 static inline int
 gioIsHidSupported (const GioDescriptor *descriptor) {
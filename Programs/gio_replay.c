@@ -0,0 +1,576 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2022 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <string.h>
+#include <errno.h>
+
+#include "log.h"
+#include "strfmt.h"
+#include "parse.h"
+#include "device.h"
+#include "file.h"
+#include "timing.h"
+#include "async_handle.h"
+#include "async_wait.h"
+#include "async_alarm.h"
+#include "io_generic.h"
+#include "gio_internal.h"
+
+typedef struct {
+  long int time;
+  size_t offset;
+  size_t count;
+  unsigned char isInput:1;
+} ReplayRecord;
+
+typedef struct {
+  size_t record;
+  size_t offset;
+} ReplayCursor;
+
+struct GioHandleStruct {
+  char *path;
+  unsigned int session;
+  unsigned char paced:1;
+
+  struct {
+    ReplayRecord *array;
+    size_t size;
+    size_t count;
+  } records;
+
+  struct {
+    unsigned char *array;
+    size_t size;
+    size_t count;
+  } bytes;
+
+  ReplayCursor input;
+  ReplayCursor output;
+  TimeValue startTime;
+
+  struct {
+    AsyncHandle alarm;
+    AsyncMonitorCallback *callback;
+    void *data;
+  } monitor;
+
+  struct {
+    TimeValue firstRead;
+    size_t inputBytes;
+    size_t outputBytes;
+    size_t mismatches;
+    unsigned char reading:1;
+    unsigned char finished:1;
+  } statistics;
+};
+
+static void
+logReplayStatistics (GioHandle *handle) {
+  if (!handle->statistics.finished) {
+    long int elapsed = handle->statistics.reading?
+                       getMonotonicElapsedMicroseconds(&handle->statistics.firstRead):
+                       0;
+
+    handle->statistics.finished = 1;
+
+    logMessage(LOG_INFO,
+      "replay finished: %s: session %u: input:%" PRIsize " output:%" PRIsize
+      " mismatches:%" PRIsize " time:%ldus rate:%ldB/s",
+      handle->path, handle->session,
+      handle->statistics.inputBytes, handle->statistics.outputBytes,
+      handle->statistics.mismatches, elapsed,
+      (elapsed? (long int)((handle->statistics.inputBytes * 1000000.0) / elapsed): 0)
+    );
+  }
+}
+
+static int
+findReplayRecord (GioHandle *handle, ReplayCursor *cursor, int isInput) {
+  while (cursor->record < handle->records.count) {
+    const ReplayRecord *record = &handle->records.array[cursor->record];
+
+    if ((record->isInput == isInput) && (cursor->offset < record->count)) return 1;
+    cursor->record += 1;
+    cursor->offset = 0;
+  }
+
+  return 0;
+}
+
+#define REPLAY_INPUT_FINISHED -1
+#define REPLAY_INPUT_BLOCKED -2
+
+static long int
+getReplayInputDelay (GioHandle *handle) {
+  if (!findReplayRecord(handle, &handle->input, 1)) return REPLAY_INPUT_FINISHED;
+
+  /* a response isn't available until its request has been written */
+  if (findReplayRecord(handle, &handle->output, 0)) {
+    if (handle->output.record < handle->input.record) return REPLAY_INPUT_BLOCKED;
+  }
+
+  if (!handle->paced) return 0;
+
+  {
+    long int delay = handle->records.array[handle->input.record].time
+                   - getMonotonicElapsedMicroseconds(&handle->startTime);
+
+    return (delay > 0)? delay: 0;
+  }
+}
+
+static int
+awaitReplayInput (GioHandle *handle, int timeout) {
+  long int delay = getReplayInputDelay(handle);
+
+  if (delay == 0) return 1;
+
+  if (delay == REPLAY_INPUT_FINISHED) {
+    logReplayStatistics(handle);
+  } else if ((delay > 0) && (delay <= (timeout * 1000L))) {
+    asyncWait((delay + 999) / 1000);
+    return 1;
+  }
+
+  asyncWait(timeout);
+  errno = EAGAIN;
+  return 0;
+}
+
+static void scheduleReplayMonitor (GioHandle *handle);
+
+ASYNC_ALARM_CALLBACK(handleReplayMonitorAlarm) {
+  GioHandle *handle = parameters->data;
+
+  asyncDiscardHandle(handle->monitor.alarm);
+  handle->monitor.alarm = NULL;
+
+  {
+    const AsyncMonitorCallbackParameters parameters = {
+      .data = handle->monitor.data,
+      .error = 0
+    };
+
+    if (!handle->monitor.callback(&parameters)) {
+      handle->monitor.callback = NULL;
+      handle->monitor.data = NULL;
+      return;
+    }
+  }
+
+  scheduleReplayMonitor(handle);
+}
+
+static void
+scheduleReplayMonitor (GioHandle *handle) {
+  if (handle->monitor.callback && !handle->monitor.alarm) {
+    long int delay = getReplayInputDelay(handle);
+
+    if (delay >= 0) {
+      asyncNewRelativeAlarm(&handle->monitor.alarm, ((delay + 999) / 1000),
+                            handleReplayMonitorAlarm, handle);
+    } else if (delay == REPLAY_INPUT_FINISHED) {
+      logReplayStatistics(handle);
+    }
+  }
+}
+
+static void
+cancelReplayMonitor (GioHandle *handle) {
+  if (handle->monitor.alarm) {
+    asyncCancelRequest(handle->monitor.alarm);
+    handle->monitor.alarm = NULL;
+  }
+
+  handle->monitor.callback = NULL;
+  handle->monitor.data = NULL;
+}
+
+static void
+destroyReplayHandle (GioHandle *handle) {
+  if (handle->records.array) free(handle->records.array);
+  if (handle->bytes.array) free(handle->bytes.array);
+  if (handle->path) free(handle->path);
+  free(handle);
+}
+
+static int
+disconnectReplayResource (GioHandle *handle) {
+  cancelReplayMonitor(handle);
+  logReplayStatistics(handle);
+  destroyReplayHandle(handle);
+  return 1;
+}
+
+static const char *
+makeReplayResourceIdentifier (GioHandle *handle, char *buffer, size_t size) {
+  STR_BEGIN(buffer, size);
+  STR_PRINTF("%s%c", "replay", PARAMETER_QUALIFIER_CHARACTER);
+  STR_PRINTF("file%c%s", PARAMETER_ASSIGNMENT_CHARACTER, handle->path);
+
+  STR_PRINTF("%csession%c%u",
+             DEVICE_PARAMETER_SEPARATOR, PARAMETER_ASSIGNMENT_CHARACTER,
+             handle->session);
+
+  STR_END;
+  return buffer;
+}
+
+static ssize_t
+writeReplayData (GioHandle *handle, const void *data, size_t size, int timeout) {
+  const unsigned char *byte = data;
+  const unsigned char *end = byte + size;
+
+  while (byte < end) {
+    if (!findReplayRecord(handle, &handle->output, 0)) {
+      if (!handle->statistics.mismatches++) {
+        logMessage(LOG_WARNING, "replay output beyond recording: %s: offset %" PRIsize,
+                   handle->path, handle->statistics.outputBytes);
+      }
+    } else {
+      const ReplayRecord *record = &handle->records.array[handle->output.record];
+      unsigned char expected = handle->bytes.array[record->offset + handle->output.offset];
+
+      if (*byte != expected) {
+        if (!handle->statistics.mismatches++) {
+          logMessage(LOG_WARNING,
+                     "replay output mismatch: %s: offset %" PRIsize ": %02X != %02X",
+                     handle->path, handle->statistics.outputBytes, *byte, expected);
+        }
+      }
+
+      handle->output.offset += 1;
+    }
+
+    handle->statistics.outputBytes += 1;
+    byte += 1;
+  }
+
+  scheduleReplayMonitor(handle);
+  return size;
+}
+
+static int
+awaitReplayResourceInput (GioHandle *handle, int timeout) {
+  return awaitReplayInput(handle, timeout);
+}
+
+static ssize_t
+readReplayData (
+  GioHandle *handle, void *buffer, size_t size,
+  int initialTimeout, int subsequentTimeout
+) {
+  if (!awaitReplayInput(handle, initialTimeout)) return 0;
+
+  {
+    const ReplayRecord *record = &handle->records.array[handle->input.record];
+    size_t count = record->count - handle->input.offset;
+
+    if (count > size) count = size;
+    memcpy(buffer, &handle->bytes.array[record->offset + handle->input.offset], count);
+    handle->input.offset += count;
+
+    if (!handle->statistics.reading) {
+      handle->statistics.reading = 1;
+      getMonotonicTime(&handle->statistics.firstRead);
+    }
+
+    handle->statistics.inputBytes += count;
+    return count;
+  }
+}
+
+static int
+monitorReplayInput (GioHandle *handle, AsyncMonitorCallback *callback, void *data) {
+  cancelReplayMonitor(handle);
+  if (!callback) return 1;
+
+  handle->monitor.callback = callback;
+  handle->monitor.data = data;
+  scheduleReplayMonitor(handle);
+  return 1;
+}
+
+static int
+reconfigureReplayResource (GioHandle *handle, const SerialParameters *parameters) {
+  return 1;
+}
+
+static const GioHandleMethods gioReplayMethods = {
+  .disconnectResource = disconnectReplayResource,
+
+  .makeResourceIdentifier = makeReplayResourceIdentifier,
+
+  .writeData = writeReplayData,
+  .awaitInput = awaitReplayResourceInput,
+  .readData = readReplayData,
+  .monitorInput = monitorReplayInput,
+  .reconfigureResource = reconfigureReplayResource
+};
+
+static int
+testReplayIdentifier (const char **identifier) {
+  return hasQualifier(identifier, "replay");
+}
+
+static const GioPublicProperties gioPublicProperties_replay = {
+  .testIdentifier = testReplayIdentifier,
+
+  .type = {
+    .name = "replay",
+    .identifier = GIO_TYPE_REPLAY
+  }
+};
+
+static int
+isReplaySupported (const GioDescriptor *descriptor) {
+  return 1;
+}
+
+static const GioOptions *
+getReplayOptions (const GioDescriptor *descriptor) {
+  /* use the options the driver would have used for the real resource */
+  if (descriptor->serial.parameters) return &descriptor->serial.options;
+  if (descriptor->usb.channelDefinitions) return &descriptor->usb.options;
+  if (descriptor->bluetooth.channelNumber || descriptor->bluetooth.discoverChannel) return &descriptor->bluetooth.options;
+  return &descriptor->null.options;
+}
+
+static const GioHandleMethods *
+getReplayMethods (void) {
+  return &gioReplayMethods;
+}
+
+static int
+addReplayRecord (GioHandle *handle, const char *text, int isInput) {
+  unsigned long int seconds;
+  unsigned long int microseconds;
+  int length;
+
+  if (sscanf(text, "%lu.%lu%n", &seconds, &microseconds, &length) < 2) return 0;
+  text += length;
+
+  if (handle->records.count == handle->records.size) {
+    size_t newSize = handle->records.size? handle->records.size<<1: 0X100;
+    ReplayRecord *newArray = realloc(handle->records.array, ARRAY_SIZE(newArray, newSize));
+
+    if (!newArray) {
+      logMallocError();
+      return 0;
+    }
+
+    handle->records.array = newArray;
+    handle->records.size = newSize;
+  }
+
+  {
+    ReplayRecord *record = &handle->records.array[handle->records.count];
+
+    record->time = (seconds * 1000000) + microseconds;
+    record->offset = handle->bytes.count;
+    record->count = 0;
+    record->isInput = isInput;
+
+    while (1) {
+      char *end;
+      unsigned long int byte = strtoul(text, &end, 0X10);
+
+      if (end == text) break;
+      if (byte > UINT8_MAX) return 0;
+      text = end;
+
+      if (handle->bytes.count == handle->bytes.size) {
+        size_t newSize = handle->bytes.size? handle->bytes.size<<1: 0X1000;
+        unsigned char *newArray = realloc(handle->bytes.array, newSize);
+
+        if (!newArray) {
+          logMallocError();
+          return 0;
+        }
+
+        handle->bytes.array = newArray;
+        handle->bytes.size = newSize;
+      }
+
+      handle->bytes.array[handle->bytes.count++] = byte;
+      record->count += 1;
+    }
+  }
+
+  handle->records.count += 1;
+  return 1;
+}
+
+static int
+handleReplayLine (const LineHandlerParameters *parameters) {
+  GioHandle *handle = parameters->data;
+  const char *text = parameters->line.text;
+  char keyword[0X20];
+  unsigned int session;
+  int length;
+
+  if (sscanf(text, "%31s %u%n", keyword, &session, &length) < 2) return 1;
+  if (session != handle->session) return 1;
+  text += length;
+
+  {
+    int ok = 1;
+
+    if (strcmp(keyword, GIO_CAPTURE_INPUT) == 0) {
+      ok = addReplayRecord(handle, text, 1);
+    } else if (strcmp(keyword, GIO_CAPTURE_OUTPUT) == 0) {
+      ok = addReplayRecord(handle, text, 0);
+    }
+
+    if (!ok) {
+      logMessage(LOG_WARNING, "invalid replay record: %s[%u]: %s",
+                 handle->path, parameters->line.number, parameters->line.text);
+    }
+  }
+
+  return 1;
+}
+
+typedef enum {
+  REPLAY_PARM_FILE,
+  REPLAY_PARM_SESSION,
+  REPLAY_PARM_PACE
+} ReplayDeviceParameter;
+
+static const char *const replayDeviceParameterNames[] = {
+  "file",
+  "session",
+  "pace",
+  NULL
+};
+
+static int
+loadReplayFile (GioHandle *handle) {
+  int ok = 0;
+  FILE *file = openFile(handle->path, "r", 0);
+
+  if (file) {
+    if (processLines(file, handleReplayLine, handle)) {
+      if (handle->records.count) {
+        logMessage(LOG_DEBUG, "replay loaded: %s: session %u: %" PRIsize " records",
+                   handle->path, handle->session, handle->records.count);
+        ok = 1;
+      } else {
+        logMessage(LOG_ERR, "replay session not found: %s: %u",
+                   handle->path, handle->session);
+        errno = ENOENT;
+      }
+    }
+
+    fclose(file);
+  }
+
+  return ok;
+}
+
+static GioHandle *
+connectReplayResource (
+  const char *identifier,
+  const GioDescriptor *descriptor
+) {
+  char **parameters = getDeviceParameters(replayDeviceParameterNames, identifier);
+
+  if (parameters) {
+    GioHandle *handle = malloc(sizeof(*handle));
+
+    if (handle) {
+      int ok = 1;
+      memset(handle, 0, sizeof(*handle));
+
+      handle->session = 1;
+      handle->paced = 0;
+
+      {
+        const char *parameter = parameters[REPLAY_PARM_SESSION];
+
+        if (*parameter) {
+          static const int minimum = 1;
+          int session;
+
+          if (validateInteger(&session, parameter, &minimum, NULL)) {
+            handle->session = session;
+          } else {
+            logMessage(LOG_ERR, "invalid replay session: %s", parameter);
+            ok = 0;
+          }
+        }
+      }
+
+      {
+        const char *parameter = parameters[REPLAY_PARM_PACE];
+
+        if (*parameter) {
+          unsigned int flag;
+
+          if (validateYesNo(&flag, parameter)) {
+            handle->paced = flag;
+          } else {
+            logMessage(LOG_ERR, "invalid replay pace setting: %s", parameter);
+            ok = 0;
+          }
+        }
+      }
+
+      if (ok) {
+        const char *path = parameters[REPLAY_PARM_FILE];
+
+        if (!*path) {
+          logMessage(LOG_ERR, "replay file not specified");
+        } else if ((handle->path = strdup(path))) {
+          if (loadReplayFile(handle)) {
+            getMonotonicTime(&handle->startTime);
+            deallocateStrings(parameters);
+            return handle;
+          }
+        } else {
+          logMallocError();
+        }
+      }
+
+      destroyReplayHandle(handle);
+    } else {
+      logMallocError();
+    }
+
+    deallocateStrings(parameters);
+  }
+
+  return NULL;
+}
+
+static const GioPrivateProperties gioPrivateProperties_replay = {
+  .isSupported = isReplaySupported,
+
+  .getOptions = getReplayOptions,
+  .getHandleMethods = getReplayMethods,
+
+  .connectResource = connectReplayResource
+};
+
+const GioProperties gioProperties_replay = {
+  .public = &gioPublicProperties_replay,
+  .private = &gioPrivateProperties_replay
+};
@@ -150,7 +150,17 @@ connectSerialResource (
 
 static int
 prepareSerialEndpoint (GioEndpoint *endpoint) {
-  gioSetBytesPerSecond(endpoint, &endpoint->handle->parameters);
+  GioHandle *handle = endpoint->handle;
+
+  if (endpoint->options.lowLatency) {
+    serialSetLowLatency(handle->device, 1);
+  } else if (serialGetLowLatency(handle->device)) {
+    /* requested via the device identifier */
+    endpoint->options.lowLatency = 1;
+  }
+
+  gioSetBytesPerSecond(endpoint, &handle->parameters);
+  gioAllowOutputCoalescing(endpoint);
   return 1;
 }
 
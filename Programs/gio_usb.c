@@ -42,12 +42,16 @@ struct GioHandleStruct {
   UsbChannel *channel;
   GioUsbConnectionProperties properties;
   HidItemsDescriptor *hidItems;
+  HidReportTable *hidReportTable;
+  unsigned lowLatency:1;
 };
 
 static int
 disconnectUsbResource (GioHandle *handle) {
+  if (handle->lowLatency) usbSetSerialLowLatency(handle->channel->device, 0);
   usbCloseChannel(handle->channel);
   if (handle->hidItems) free(handle->hidItems);
+  if (handle->hidReportTable) free(handle->hidReportTable);
   free(handle);
   return 1;
 }
@@ -211,14 +215,24 @@ getUsbHidItems (GioHandle *handle, int timeout) {
   return handle->hidItems;
 }
 
+static const HidReportTable *
+getUsbHidReportTable (GioHandle *handle, int timeout) {
+  if (!handle->hidReportTable) {
+    const HidItemsDescriptor *items = getUsbHidItems(handle, timeout);
+    if (items) handle->hidReportTable = hidCompileReports(items);
+  }
+
+  return handle->hidReportTable;
+}
+
 static int
 getUsbHidReportSize (
   GioHandle *handle, HidReportIdentifier identifier,
   HidReportSize *size, int timeout
 ) {
-  const HidItemsDescriptor *items = getUsbHidItems(handle, timeout);
-  if (!items) return 0;
-  return hidReportSize(items, identifier, size);
+  const HidReportTable *table = getUsbHidReportTable(handle, timeout);
+  if (!table) return 0;
+  return hidGetCompiledReportSize(table, identifier, size);
 }
 
 static ssize_t
@@ -282,6 +296,7 @@ static const GioHandleMethods gioUsbMethods = {
   .askResource = askUsbResource,
 
   .getHidReportSize = getUsbHidReportSize,
+  .getHidReportTable = getUsbHidReportTable,
   .getHidReport = getUsbHidReport,
   .setHidReport = setUsbHidReport,
   .getHidFeature = getUsbHidFeature,
@@ -374,7 +389,13 @@ prepareUsbEndpoint (GioEndpoint *endpoint) {
     const SerialParameters *parameters = channel->definition->serial;
 
     if (parameters) {
+      /* a serial adapter is a byte stream so packets can share a transfer */
       gioSetBytesPerSecond(endpoint, parameters);
+      gioAllowOutputCoalescing(endpoint);
+
+      if (endpoint->options.lowLatency) {
+        if (usbSetSerialLowLatency(channel->device, 1)) handle->lowLatency = 1;
+      }
     }
   }
 
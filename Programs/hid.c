@@ -141,6 +141,8 @@ struct HidDeviceStruct {
 
   const HidBusMethods *busMethods;
   const HidHandleMethods *handleMethods;
+
+  HidReportTable *reportTable;
 };
 
 static void
@@ -442,6 +444,7 @@ hidOpenDeviceWithParameters (HidDevice **device, const char *string) {
 void
 hidCloseDevice (HidDevice *device) {
   hidDestroyHandle(device->handle);
+  if (device->reportTable) free(device->reportTable);
   free(device);
 }
 
@@ -458,12 +461,27 @@ hidGetItems (HidDevice *device) {
   return method(device->handle);
 }
 
+const HidReportTable *
+hidGetReportTable (HidDevice *device) {
+  if (!device->reportTable) {
+    const HidItemsDescriptor *items = hidGetItems(device);
+    if (items) device->reportTable = hidCompileReports(items);
+  }
+
+  return device->reportTable;
+}
+
 int
 hidGetReportSize (
   HidDevice *device,
   HidReportIdentifier identifier,
   HidReportSize *size
 ) {
+  {
+    const HidReportTable *table = hidGetReportTable(device);
+    if (table) return hidGetCompiledReportSize(table, identifier, size);
+  }
+
   HidGetReportSizeMethod *method = device->handleMethods->getReportSize;
 
   if (!method) {
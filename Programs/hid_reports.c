@@ -0,0 +1,443 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2022 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <string.h>
+
+#include "log.h"
+#include "strfmt.h"
+#include "hid_defs.h"
+#include "hid_items.h"
+#include "hid_reports.h"
+
+#define HID_COMPILE_USAGES_MAXIMUM 0X100
+#define HID_COMPILE_STACK_DEPTH 4
+
+typedef struct {
+  HidUnsignedValue usagePage;
+  HidSignedValue logicalMinimum;
+  HidSignedValue logicalMaximum;
+  HidUnsignedValue reportSize;
+  HidUnsignedValue reportCount;
+  HidUnsignedValue reportIdentifier;
+} HidGlobalState;
+
+typedef struct {
+  HidUnsignedValue usages[HID_COMPILE_USAGES_MAXIMUM];
+  unsigned int usageCount;
+
+  HidUnsignedValue usageMinimum;
+  HidUnsignedValue usageMaximum;
+  unsigned char haveUsageMinimum:1;
+  unsigned char haveUsageMaximum:1;
+} HidLocalState;
+
+typedef struct {
+  HidReportTable *table;
+  HidReportLayout *reports;
+  HidReportField *fields;
+
+  unsigned int reportCount;
+  unsigned int fieldCount;
+
+  HidGlobalState global;
+  HidGlobalState stack[HID_COMPILE_STACK_DEPTH];
+  unsigned int stackDepth;
+  HidLocalState local;
+} HidCompileData;
+
+static HidUnsignedValue
+hidMakeUsage (const HidCompileData *hcd, const HidItem *item) {
+  if (item->valueSize == 4) return item->value.u;
+  return HID_USAGE(hcd->global.usagePage, item->value.u);
+}
+
+static HidReportLayout *
+hidGetCompileReport (HidCompileData *hcd, HidReportType type) {
+  HidReportTable *table = hcd->table;
+  HidReportIdentifier identifier = hcd->global.reportIdentifier;
+  uint16_t *index = &table->reportIndex[type][identifier];
+
+  if (!*index) {
+    HidReportLayout *report = &hcd->reports[hcd->reportCount];
+
+    memset(report, 0, sizeof(*report));
+    report->identifier = identifier;
+    report->type = type;
+
+    *index = ++hcd->reportCount;
+    return report;
+  }
+
+  return &hcd->reports[*index - 1];
+}
+
+static void
+hidAddCompileField (
+  HidCompileData *hcd, HidReportLayout *report, uint32_t bitOffset,
+  HidUnsignedValue flags, HidUnsignedValue usageMinimum, HidUnsignedValue usageMaximum,
+  uint16_t count
+) {
+  if (!hcd->fields) {
+    hcd->fieldCount += 1;
+  } else {
+    HidReportField *field = &hcd->fields[report->firstField + report->fieldCount];
+
+    field->usageMinimum = usageMinimum;
+    field->usageMaximum = usageMaximum;
+    field->logicalMinimum = hcd->global.logicalMinimum;
+    field->logicalMaximum = hcd->global.logicalMaximum;
+
+    field->bitOffset = bitOffset;
+    field->count = count;
+    field->flags = flags;
+    field->bitSize = hcd->global.reportSize;
+  }
+
+  report->fieldCount += 1;
+}
+
+static int
+hidCompileMainItem (HidCompileData *hcd, HidReportType type, HidUnsignedValue flags) {
+  HidReportLayout *report = hidGetCompileReport(hcd, type);
+  const HidLocalState *local = &hcd->local;
+
+  HidUnsignedValue size = hcd->global.reportSize;
+  HidUnsignedValue count = hcd->global.reportCount;
+  uint32_t bitOffset = report->bitCount;
+
+  if (hcd->global.reportIdentifier) bitOffset += 8;
+
+  if (!(flags & HID_USG_FLG_CONSTANT) && size && (size <= HID_FIELD_SIZE_MAXIMUM) && count) {
+    /* Fields are indexed (and counted) with 16-bit values. */
+    if (!hcd->fields) {
+      HidUnsignedValue limit = UINT16_MAX;
+      unsigned int fields = (flags & HID_USG_FLG_VARIABLE)? count: 1;
+
+      if ((count > limit) || (fields > (limit - hcd->fieldCount))) {
+        logMessage(LOG_WARNING, "too many HID report fields");
+        return 0;
+      }
+    }
+
+    if (flags & HID_USG_FLG_VARIABLE) {
+      for (unsigned int element=0; element<count; element+=1) {
+        HidUnsignedValue usage;
+
+        if (element < local->usageCount) {
+          usage = local->usages[element];
+        } else if (local->haveUsageMinimum) {
+          usage = local->usageMinimum + (element - local->usageCount);
+
+          if (local->haveUsageMaximum && (usage > local->usageMaximum)) {
+            usage = local->usageMaximum;
+          }
+        } else if (local->usageCount) {
+          usage = local->usages[local->usageCount - 1];
+        } else {
+          usage = 0;
+        }
+
+        hidAddCompileField(hcd, report, bitOffset+(element * size),
+                           flags, usage, usage, 1);
+      }
+    } else {
+      HidUnsignedValue minimum;
+      HidUnsignedValue maximum;
+
+      if (local->haveUsageMinimum) {
+        minimum = local->usageMinimum;
+        maximum = local->haveUsageMaximum? local->usageMaximum: minimum;
+      } else if (local->usageCount) {
+        minimum = local->usages[0];
+        maximum = local->usages[local->usageCount - 1];
+      } else {
+        minimum = maximum = 0;
+      }
+
+      hidAddCompileField(hcd, report, bitOffset, flags, minimum, maximum, count);
+    }
+  }
+
+  report->bitCount += size * count;
+  return 1;
+}
+
+static int
+hidCompileItems (HidCompileData *hcd, const HidItemsDescriptor *items) {
+  const unsigned char *nextByte = items->bytes;
+  size_t bytesLeft = items->count;
+
+  memset(&hcd->global, 0, sizeof(hcd->global));
+  memset(&hcd->local, 0, sizeof(hcd->local));
+  hcd->stackDepth = 0;
+
+  while (bytesLeft) {
+    HidItem item;
+
+    if (!hidNextItem(&item, &nextByte, &bytesLeft)) {
+      if (bytesLeft) return 0;
+      break;
+    }
+
+    switch (item.tag) {
+      case HID_ITM_Input:
+        if (!hidCompileMainItem(hcd, HID_RPT_Input, item.value.u)) return 0;
+        goto doLocalReset;
+
+      case HID_ITM_Output:
+        if (!hidCompileMainItem(hcd, HID_RPT_Output, item.value.u)) return 0;
+        goto doLocalReset;
+
+      case HID_ITM_Feature:
+        if (!hidCompileMainItem(hcd, HID_RPT_Feature, item.value.u)) return 0;
+        goto doLocalReset;
+
+      case HID_ITM_Collection:
+      case HID_ITM_EndCollection:
+      doLocalReset:
+        memset(&hcd->local, 0, sizeof(hcd->local));
+        break;
+
+      case HID_ITM_UsagePage:
+        hcd->global.usagePage = item.value.u;
+        break;
+
+      case HID_ITM_LogicalMinimum:
+        hcd->global.logicalMinimum = item.value.s;
+        break;
+
+      case HID_ITM_LogicalMaximum:
+        hcd->global.logicalMaximum = item.value.s;
+        break;
+
+      case HID_ITM_ReportSize:
+        hcd->global.reportSize = item.value.u;
+        break;
+
+      case HID_ITM_ReportCount:
+        hcd->global.reportCount = item.value.u;
+        break;
+
+      case HID_ITM_ReportID: {
+        HidUnsignedValue identifier = item.value.u;
+
+        if (identifier && (identifier <= UINT8_MAX)) {
+          hcd->global.reportIdentifier = identifier;
+          BITMASK_SET(hcd->table->definedIdentifiers, identifier);
+          hcd->table->hasIdentifiers = 1;
+        }
+
+        break;
+      }
+
+      case HID_ITM_Push:
+        if (hcd->stackDepth < ARRAY_COUNT(hcd->stack)) {
+          hcd->stack[hcd->stackDepth++] = hcd->global;
+        }
+        break;
+
+      case HID_ITM_Pop:
+        if (hcd->stackDepth) hcd->global = hcd->stack[--hcd->stackDepth];
+        break;
+
+      case HID_ITM_Usage: {
+        HidLocalState *local = &hcd->local;
+
+        if (local->usageCount < ARRAY_COUNT(local->usages)) {
+          local->usages[local->usageCount++] = hidMakeUsage(hcd, &item);
+        }
+
+        break;
+      }
+
+      case HID_ITM_UsageMinimum:
+        hcd->local.usageMinimum = hidMakeUsage(hcd, &item);
+        hcd->local.haveUsageMinimum = 1;
+        break;
+
+      case HID_ITM_UsageMaximum:
+        hcd->local.usageMaximum = hidMakeUsage(hcd, &item);
+        hcd->local.haveUsageMaximum = 1;
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  return 1;
+}
+
+HidReportTable *
+hidCompileReports (const HidItemsDescriptor *items) {
+  HidReportTable *compiled = NULL;
+  HidReportTable table;
+  HidReportLayout *reports;
+
+  if (!(reports = malloc(ARRAY_SIZE(reports, (HID_RPT_COUNT * (UINT8_MAX + 1)))))) {
+    logMallocError();
+    return NULL;
+  }
+
+  HidCompileData hcd = {
+    .table = &table,
+    .reports = reports
+  };
+
+  /* The first pass determines the reports and how many fields each has so
+   * that the second pass can lay the fields out contiguously by report.
+   */
+  memset(&table, 0, sizeof(table));
+
+  if (hidCompileItems(&hcd, items)) {
+    {
+      unsigned int fieldCount = 0;
+
+      for (unsigned int index=0; index<hcd.reportCount; index+=1) {
+        HidReportLayout *report = &reports[index];
+
+        report->firstField = fieldCount;
+        fieldCount += report->fieldCount;
+
+        report->fieldCount = 0;
+        report->bitCount = 0;
+      }
+    }
+
+    {
+      size_t reportsSize = ARRAY_SIZE(reports, hcd.reportCount);
+      size_t fieldsSize = ARRAY_SIZE(hcd.fields, hcd.fieldCount);
+
+      if ((compiled = malloc(sizeof(*compiled) + reportsSize + fieldsSize))) {
+        HidReportLayout *compiledReports = (HidReportLayout *)(compiled + 1);
+        HidReportField *compiledFields = (HidReportField *)((unsigned char *)compiledReports + reportsSize);
+
+        hcd.fields = compiledFields;
+        hidCompileItems(&hcd, items);
+
+        *compiled = table;
+        memcpy(compiledReports, reports, reportsSize);
+
+        compiled->reports = compiledReports;
+        compiled->fields = compiledFields;
+        compiled->reportCount = hcd.reportCount;
+        compiled->fieldCount = hcd.fieldCount;
+
+        logMessage(LOG_CATEGORY(HID_IO),
+                   "reports compiled: Reports:%u Fields:%u",
+                   compiled->reportCount, compiled->fieldCount);
+      } else {
+        logMallocError();
+      }
+    }
+  }
+
+  free(reports);
+  return compiled;
+}
+
+int
+hidGetCompiledReportSize (
+  const HidReportTable *table,
+  HidReportIdentifier identifier,
+  HidReportSize *size
+) {
+  if (identifier) {
+    if (!BITMASK_TEST(table->definedIdentifiers, identifier)) return 0;
+  } else if (table->hasIdentifiers) {
+    return 0;
+  }
+
+  {
+    size_t *sizes[] = {
+      [HID_RPT_Input] = &size->input,
+      [HID_RPT_Output] = &size->output,
+      [HID_RPT_Feature] = &size->feature,
+    };
+
+    for (HidReportType type=0; type<HID_RPT_COUNT; type+=1) {
+      const HidReportLayout *report = hidGetReportLayout(table, type, identifier);
+      size_t bytes = report? (report->bitCount + 7) / 8: 0;
+
+      if (bytes && identifier) bytes += 1;
+      *sizes[type] = bytes;
+    }
+  }
+
+  return 1;
+}
+
+int
+hidListReportTable (const HidReportTable *table, HidReportLister *listLine, void *data) {
+  static const char *const typeNames[] = {
+    [HID_RPT_Input] = "In",
+    [HID_RPT_Output] = "Out",
+    [HID_RPT_Feature] = "Ftr",
+  };
+
+  for (unsigned int index=0; index<table->reportCount; index+=1) {
+    const HidReportLayout *report = &table->reports[index];
+    const HidReportField *field = hidGetReportFields(table, report);
+    const HidReportField *end = field + report->fieldCount;
+
+    {
+      char line[0X40];
+      STR_BEGIN(line, sizeof(line));
+
+      STR_PRINTF(
+        "Report %02X %s: Bits:%"PRIu32 " Fields:%u",
+        report->identifier, typeNames[report->type],
+        report->bitCount, report->fieldCount
+      );
+
+      STR_END;
+      if (!listLine(line, data)) return 0;
+    }
+
+    while (field < end) {
+      char line[0X80];
+      STR_BEGIN(line, sizeof(line));
+
+      STR_PRINTF(
+        "  Bit:%"PRIu32 " Size:%u Count:%u",
+        field->bitOffset, field->bitSize, field->count
+      );
+
+      if (field->usageMinimum == field->usageMaximum) {
+        STR_PRINTF(" Usage:%08"PRIX32, field->usageMinimum);
+      } else {
+        STR_PRINTF(" Usages:%08"PRIX32 "-%08"PRIX32,
+                   field->usageMinimum, field->usageMaximum);
+      }
+
+      STR_PRINTF(
+        " Range:%"PRId32 "-%"PRId32 " %s",
+        field->logicalMinimum, field->logicalMaximum,
+        ((field->flags & HID_USG_FLG_VARIABLE)? "var": "array")
+      );
+
+      STR_END;
+      if (!listLine(line, data)) return 0;
+      field += 1;
+    }
+  }
+
+  return 1;
+}
@@ -129,7 +129,7 @@ ASYNC_TASK_CALLBACK(presentMessage) {
 #ifdef ENABLE_SPEECH_SUPPORT
   if (!(mgp->options & MSG_SILENT)) {
     if (isAutospeakActive()) {
-      sayString(&spk, mgp->text, SAY_OPT_MUTE_FIRST);
+      sayString(&spk, mgp->text, (SAY_OPT_MUTE_FIRST | SAY_OPT_CLASS_MESSAGE));
     }
   }
 #endif /* ENABLE_SPEECH_SUPPORT */
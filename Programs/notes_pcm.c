@@ -23,10 +23,18 @@
 
 #include "prefs.h"
 #include "log.h"
+#include "parameters.h"
+#include "program.h"
+#include "queue.h"
 #include "pcm.h"
+#include "tune.h"
 #include "notes.h"
 
 char *opt_pcmDevice;
+int opt_pcmLowLatency;
+
+/* The number of samples which are synthesized at a time. */
+#define PCM_RENDER_SAMPLES 0X100
 
 struct NoteDeviceStruct {
   PcmDevice *pcm;
@@ -40,8 +48,49 @@ struct NoteDeviceStruct {
   int blockUsed;
 
   PcmSampleMaker makeSample;
+  int frameSize;
 };
 
+static void
+pcmMakeFrames (
+  NoteDevice *device, unsigned char *bytes,
+  const int16_t *amplitudes, unsigned int count
+) {
+  if ((device->amplitudeFormat == PCM_FMT_S16N) && (device->channelCount == 1)) {
+    memcpy(bytes, amplitudes, (count * sizeof(*amplitudes)));
+    return;
+  }
+
+  {
+    const int16_t *end = amplitudes + count;
+
+    while (amplitudes < end) {
+      PcmSample *sample = (PcmSample *)bytes;
+      PcmSampleSize size = device->makeSample(sample, *amplitudes++);
+      bytes += size;
+
+      for (int channel=1; channel<device->channelCount; channel+=1) {
+        for (int byte=0; byte<size; byte+=1) {
+          *bytes++ = sample->bytes[byte];
+        }
+      }
+    }
+  }
+}
+
+static void
+pcmMakeSilence (NoteDevice *device, unsigned char *bytes, unsigned int count) {
+  static const int16_t silence[PCM_RENDER_SAMPLES] = {0};
+
+  while (count > 0) {
+    unsigned int amount = MIN(count, ARRAY_COUNT(silence));
+
+    pcmMakeFrames(device, bytes, silence, amount);
+    bytes += amount * device->frameSize;
+    count -= amount;
+  }
+}
+
 static int
 pcmFlushBytes (NoteDevice *device) {
   int ok = writePcmData(device->pcm, device->blockAddress, device->blockUsed);
@@ -50,20 +99,20 @@ pcmFlushBytes (NoteDevice *device) {
 }
 
 static int
-pcmWriteSample (NoteDevice *device, int16_t amplitude) {
-  PcmSample *sample = (PcmSample *)&device->blockAddress[device->blockUsed];
-  PcmSampleSize size = device->makeSample(sample, amplitude);
-  device->blockUsed += size;
-
-  for (int channel=1; channel<device->channelCount; channel+=1) {
-    for (int byte=0; byte<size; byte+=1) {
-      device->blockAddress[device->blockUsed++] = sample->bytes[byte];
-    }
-  }
-
-  if (device->blockUsed == device->blockSize) {
-    if (!pcmFlushBytes(device)) {
-      return 0;
+pcmWriteSamples (NoteDevice *device, const int16_t *amplitudes, unsigned int count) {
+  while (count > 0) {
+    unsigned int amount = (device->blockSize - device->blockUsed) / device->frameSize;
+    if (amount > count) amount = count;
+
+    pcmMakeFrames(device, &device->blockAddress[device->blockUsed], amplitudes, amount);
+    device->blockUsed += amount * device->frameSize;
+    amplitudes += amount;
+    count -= amount;
+
+    if (device->blockUsed == device->blockSize) {
+      if (!pcmFlushBytes(device)) {
+        return 0;
+      }
     }
   }
 
@@ -72,9 +121,13 @@ pcmWriteSample (NoteDevice *device, int16_t amplitude) {
 
 static int
 pcmFlushBlock (NoteDevice *device) {
-  while (device->blockUsed)
-    if (!pcmWriteSample(device, 0))
-      return 0;
+  if (device->blockUsed) {
+    unsigned int count = (device->blockSize - device->blockUsed) / device->frameSize;
+
+    pcmMakeSilence(device, &device->blockAddress[device->blockUsed], count);
+    device->blockUsed = device->blockSize;
+    if (!pcmFlushBytes(device)) return 0;
+  }
 
   return 1;
 }
@@ -86,7 +139,9 @@ pcmConstruct (int errorLevel) {
   if ((device = malloc(sizeof(*device)))) {
     memset(device, 0, sizeof(*device));
 
-    if ((device->pcm = openPcmDevice(errorLevel, opt_pcmDevice))) {
+    PcmLatency latency = opt_pcmLowLatency? PCM_LATENCY_LOW: PCM_LATENCY_NORMAL;
+
+    if ((device->pcm = openPcmDevice(errorLevel, opt_pcmDevice, latency))) {
       device->blockSize = getPcmBlockSize(device->pcm);
       device->sampleRate = getPcmSampleRate(device->pcm);
       device->channelCount = getPcmChannelCount(device->pcm);
@@ -96,11 +151,10 @@ pcmConstruct (int errorLevel) {
       device->makeSample = getPcmSampleMaker(device->amplitudeFormat);
 
       PcmSample sample;
-      PcmSampleSize sampleSize = device->makeSample(&sample, 0);
-      sampleSize *= device->channelCount;
+      device->frameSize = device->makeSample(&sample, 0) * device->channelCount;
 
-      if (sampleSize && device->blockSize &&
-          !(device->blockSize % sampleSize)) {
+      if (device->frameSize && device->blockSize &&
+          !(device->blockSize % device->frameSize)) {
         if ((device->blockAddress = malloc(device->blockSize))) {
           logMessage(LOG_DEBUG, "PCM enabled: BlkSz:%d Rate:%d ChnCt:%d Fmt:%d",
                      device->blockSize, device->sampleRate, device->channelCount, device->amplitudeFormat);
@@ -111,8 +165,8 @@ pcmConstruct (int errorLevel) {
       } else {
         logMessage(LOG_ERR,
                    "PCM block size not multiple of sample size:"
-                   " BlkSz:%d" " SmpSz:%u",
-                   device->blockSize, sampleSize);
+                   " BlkSz:%d" " SmpSz:%d",
+                   device->blockSize, device->frameSize);
       }
 
       closePcmDevice(device->pcm);
@@ -137,64 +191,84 @@ pcmDestruct (NoteDevice *device) {
 }
 
 static int
-pcmTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency) {
-  int32_t sampleCount = device->sampleRate * duration / 1000;
+pcmIsPersistent (void) {
+  return opt_pcmLowLatency;
+}
 
-  logMessage(LOG_DEBUG, "tone: MSecs:%u SmpCt:%"PRId32 " Freq:%"PRIfreq,
-             duration, sampleCount, frequency);
+static unsigned char
+pcmGetVolume (void) {
+  const unsigned char fullVolume = 100;
+  return MIN(fullVolume, prefs.pcmVolume);
+}
 
-  if (frequency) {
-    /* A triangle waveform sounds nice, is lightweight, and avoids
-     * relying too much on floating-point performance and/or on
-     * expensive math functions like sin(). Considerations like
-     * these are especially important on PDAs without any FPU.
-     */ 
-
-    /* We need to know the maximum amplitude based on the currently set
-     * volume percentage. This percentage then needs to be squared because
-     * we perceive loudness exponentially.
-     */
-    const unsigned char fullVolume = 100;
-    const unsigned char currentVolume = MIN(fullVolume, prefs.pcmVolume);
-    const int32_t maximumAmplitude = INT16_MAX
-                                   * (currentVolume * currentVolume)
-                                   / (fullVolume * fullVolume);
+/* A triangle waveform sounds nice, is lightweight, and avoids
+ * relying too much on floating-point performance and/or on
+ * expensive math functions like sin(). Considerations like
+ * these are especially important on PDAs without any FPU.
+ */ 
 
-    /* The calculations for triangle wave generation work out nicely and
-     * efficiently if we map a full period onto a 32-bit unsigned range.
-     */
+/* The calculations for triangle wave generation work out nicely and
+ * efficiently if we map a full period onto a 32-bit unsigned range.
+ */
 
-    /* The two high-order bits specify which quarter wave a sample is for.
-     *   00 -> ascending from the negative peak to zero
-     *   01 -> ascending from zero to the positive peak
-     *   10 -> descending from the positive peak to zero
-     *   11 -> descending from zero to the negative peak
-     * The higher bit is 0 for the ascending segment and 1 for the
-     * descending segment. The lower bit is 0 when going from a peak to
-     * zero and 1 when going from zero to a peak.
-     */
-    const uint8_t magnitudeWidth = 32 - 2;
+/* The two high-order bits specify which quarter wave a sample is for.
+ *   00 -> ascending from the negative peak to zero
+ *   01 -> ascending from zero to the positive peak
+ *   10 -> descending from the positive peak to zero
+ *   11 -> descending from zero to the negative peak
+ * The higher bit is 0 for the ascending segment and 1 for the
+ * descending segment. The lower bit is 0 when going from a peak to
+ * zero and 1 when going from zero to a peak.
+ */
+#define PCM_MAGNITUDE_WIDTH (32 - 2)
 
-    /* The amplitude is 0 when the lower bit of the quarter wave indicator
-     * is 1 and the rest of the (magnitude) bits are all 0.
-     */
-    const uint32_t zeroValue = UINT32_C(1) << magnitudeWidth;
+/* The amplitude is 0 when the lower bit of the quarter wave indicator
+ * is 1 and the rest of the (magnitude) bits are all 0.
+ */
+#define PCM_ZERO_VALUE (UINT32_C(1) << PCM_MAGNITUDE_WIDTH)
+
+typedef struct {
+  int32_t maximumAmplitude;
+  uint32_t stepsPerSample;
+  int32_t currentValue;
+  int32_t sampleCount;
+} PcmToneGenerator;
+
+static void
+pcmBeginTone (
+  PcmToneGenerator *tg, int sampleRate, unsigned char volume,
+  unsigned int duration, NoteFrequency frequency
+) {
+  tg->sampleCount = sampleRate * duration / 1000;
+
+  /* We need to know the maximum amplitude based on the currently set
+   * volume percentage. This percentage then needs to be squared because
+   * we perceive loudness exponentially.
+   */
+  {
+    const unsigned char fullVolume = 100;
+
+    tg->maximumAmplitude = INT16_MAX
+                         * (volume * volume)
+                         / (fullVolume * fullVolume);
+  }
+
+  /* The current value needs to be a signed value so that the >> operator
+   * will extend its sign bit. We start by initializing it to the value
+   * that corresponds to the start of the first logical quarter wave
+   * (the one that ascends from zero to the positive peak).
+   */
+  tg->currentValue = PCM_ZERO_VALUE;
 
+  if (frequency) {
     /* We need to know how many steps to make from one sample to the next.
      * stepsPerSample = stepsPerWave * wavesPerSecond / samplesPerSecond
      *                = stepsPerWave * frequency / sampleRate
      *                = stepsPerWave / sampleRate * frequency
      */
-    const uint32_t stepsPerSample = (NoteFrequency)UINT32_MAX 
-                                  / (NoteFrequency)device->sampleRate
-                                  * frequency;
-
-    /* The current value needs to be a signed value so that the >> operator
-     * will extend its sign bit. We start by initializing it to the value
-     * that corresponds to the start of the first logical quarter wave
-     * (the one that ascends from zero to the positive peak).
-     */
-    int32_t currentValue = zeroValue;
+    tg->stepsPerSample = (NoteFrequency)UINT32_MAX 
+                       / (NoteFrequency)sampleRate
+                       * frequency;
 
     /* Round the number of samples up to a whole number of periods:
      * partialSteps = (sampleCount * stepsPerSample) % stepsPerWave
@@ -208,20 +282,41 @@ pcmTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency) {
 
      * extraSamples = missingSteps / stepsPerSample
      */
-    sampleCount += (uint32_t)(sampleCount * -stepsPerSample) / stepsPerSample;
+    if (tg->stepsPerSample) {
+      tg->sampleCount += (uint32_t)(tg->sampleCount * -tg->stepsPerSample) / tg->stepsPerSample;
+    }
+  } else {
+    /* Silence is a wave which never leaves zero. */
+    tg->stepsPerSample = 0;
+  }
+}
+
+static unsigned int
+pcmRenderTone (PcmToneGenerator *tg, int16_t *amplitudes, unsigned int count) {
+  if (count > tg->sampleCount) count = tg->sampleCount;
+
+  /* The loop has no calls or data-dependent branches so that the
+   * compiler can vectorize it.
+   */
+  {
+    const int32_t maximumAmplitude = tg->maximumAmplitude;
+    const uint32_t stepsPerSample = tg->stepsPerSample;
+    const uint32_t currentValue = tg->currentValue;
+
+    for (unsigned int index=0; index<count; index+=1) {
+      int32_t value = currentValue + (index * stepsPerSample);
 
-    while (sampleCount > 0) {
       /* Convert the current 32-bit unsigned linear value to a 31-bit
        * triangular amplitude by inverting its low-order 31 bits if its
        * high-order (sign) bit is set.
        */
-      int32_t amplitude = currentValue ^ (currentValue >> 31);
+      int32_t amplitude = value ^ (value >> 31);
 
       /* Convert the 31-bit amplitude from unsigned to signed. */
-      amplitude -= zeroValue;
+      amplitude -= PCM_ZERO_VALUE;
 
       /* Convert the amplitude's magnitude from 30 bits to 16 bits. */
-      amplitude >>= magnitudeWidth - 16;
+      amplitude >>= PCM_MAGNITUDE_WIDTH - 16;
 
       /* Adjust the 17-bit signed amplitude (sign bit + 16-bit value) by
        * the currently set volume (15-bit value):
@@ -232,19 +327,31 @@ pcmTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency) {
       /* Convert the signed amplitude from 32 bits to 16 bits. */
       amplitude >>= 16;
 
-      if (!pcmWriteSample(device, amplitude)) break;
-      currentValue += stepsPerSample;
-      sampleCount -= 1;
-    }
-  } else {
-    /* generate silence */
-    while (sampleCount > 0) {
-      if (!pcmWriteSample(device, 0)) break;
-      sampleCount -= 1;
+      amplitudes[index] = amplitude;
     }
   }
 
-  return (sampleCount > 0) ? 0 : 1;
+  tg->currentValue += count * tg->stepsPerSample;
+  tg->sampleCount -= count;
+  return count;
+}
+
+static int
+pcmTone (NoteDevice *device, unsigned int duration, NoteFrequency frequency) {
+  PcmToneGenerator tg;
+  pcmBeginTone(&tg, device->sampleRate, pcmGetVolume(), duration, frequency);
+
+  logMessage(LOG_DEBUG, "tone: MSecs:%u SmpCt:%"PRId32 " Freq:%"PRIfreq,
+             duration, tg.sampleCount, frequency);
+
+  while (tg.sampleCount > 0) {
+    int16_t amplitudes[PCM_RENDER_SAMPLES];
+    unsigned int count = pcmRenderTone(&tg, amplitudes, ARRAY_COUNT(amplitudes));
+
+    if (!pcmWriteSamples(device, amplitudes, count)) return 0;
+  }
+
+  return 1;
 }
 
 static int
@@ -259,11 +366,246 @@ pcmFlush (NoteDevice *device) {
   return ok;
 }
 
+/* Short tunes (alerts, in particular) are rendered once, in the output
+ * format of the device, and then replayed as is. A rendition is only
+ * valid for the sample rate, the output format, and the volume that it
+ * was rendered for, so it's rendered again if any of them changes.
+ */
+typedef struct {
+  ToneElement *tones;
+  unsigned int toneCount;
+
+  int sampleRate;
+  int channelCount;
+  int blockSize;
+  PcmAmplitudeFormat amplitudeFormat;
+  unsigned char volume;
+
+  unsigned char *bytes;
+  size_t size;
+} PcmTuneEntry;
+
+static Queue *pcmTuneEntries = NULL;
+
+static void
+deallocatePcmTuneEntry (void *item, void *data) {
+  PcmTuneEntry *entry = item;
+
+  free(entry->bytes);
+  free(entry->tones);
+  free(entry);
+}
+
+static void
+exitPcmTunes (void *data) {
+  if (pcmTuneEntries) {
+    deallocateQueue(pcmTuneEntries);
+    pcmTuneEntries = NULL;
+  }
+}
+
+static Queue *
+getPcmTuneEntries (void) {
+  if (!pcmTuneEntries) {
+    if ((pcmTuneEntries = newQueue(deallocatePcmTuneEntry, NULL))) {
+      onProgramExit("pcm-tunes", exitPcmTunes, NULL);
+    }
+  }
+
+  return pcmTuneEntries;
+}
+
+typedef struct {
+  const ToneElement *tones;
+  unsigned int toneCount;
+} PcmTuneKey;
+
+static int
+testPcmTuneEntry (const void *item, void *data) {
+  const PcmTuneEntry *entry = item;
+  const PcmTuneKey *key = data;
+
+  if (entry->toneCount != key->toneCount) return 0;
+  return memcmp(entry->tones, key->tones, (key->toneCount * sizeof(*key->tones))) == 0;
+}
+
+static int
+pcmRenderTune (NoteDevice *device, PcmTuneEntry *entry, unsigned char volume) {
+  size_t frameCount = 0;
+
+  for (unsigned int index=0; index<entry->toneCount; index+=1) {
+    const ToneElement *tone = &entry->tones[index];
+    PcmToneGenerator tg;
+
+    pcmBeginTone(&tg, device->sampleRate, volume, tone->duration, tone->frequency);
+    frameCount += tg.sampleCount;
+  }
+
+  {
+    size_t size = frameCount * device->frameSize;
+    unsigned char *bytes;
+
+    /* pad to a whole number of blocks - the same as a flush would */
+    size += device->blockSize - 1;
+    size -= size % device->blockSize;
+
+    if ((bytes = malloc(size))) {
+      unsigned char *byte = bytes;
+
+      for (unsigned int index=0; index<entry->toneCount; index+=1) {
+        const ToneElement *tone = &entry->tones[index];
+        PcmToneGenerator tg;
+
+        pcmBeginTone(&tg, device->sampleRate, volume, tone->duration, tone->frequency);
+
+        while (tg.sampleCount > 0) {
+          int16_t amplitudes[PCM_RENDER_SAMPLES];
+          unsigned int count = pcmRenderTone(&tg, amplitudes, ARRAY_COUNT(amplitudes));
+
+          pcmMakeFrames(device, byte, amplitudes, count);
+          byte += count * device->frameSize;
+        }
+      }
+
+      pcmMakeSilence(device, byte, ((bytes + size - byte) / device->frameSize));
+
+      free(entry->bytes);
+      entry->bytes = bytes;
+      entry->size = size;
+
+      entry->sampleRate = device->sampleRate;
+      entry->channelCount = device->channelCount;
+      entry->blockSize = device->blockSize;
+      entry->amplitudeFormat = device->amplitudeFormat;
+      entry->volume = volume;
+
+      logMessage(LOG_DEBUG, "PCM tune rendered: Tones:%u Bytes:%zu Vol:%u",
+                 entry->toneCount, size, volume);
+      return 1;
+    } else {
+      logMallocError();
+    }
+  }
+
+  return 0;
+}
+
+static PcmTuneEntry *
+pcmGetTuneEntry (NoteDevice *device, const ToneElement *tune) {
+  PcmTuneKey key = {
+    .tones = tune,
+    .toneCount = 0
+  };
+
+  {
+    unsigned int duration = 0;
+
+    while (tune[key.toneCount].duration) {
+      duration += tune[key.toneCount].duration;
+      if (duration > PCM_TUNE_DURATION_LIMIT) return NULL;
+      key.toneCount += 1;
+    }
+  }
+
+  {
+    Queue *entries = getPcmTuneEntries();
+    if (!entries) return NULL;
+
+    Element *element = findElement(entries, testPcmTuneEntry, &key);
+    PcmTuneEntry *entry;
+
+    if (element) {
+      requeueElement(element);
+      entry = getElementItem(element);
+    } else {
+      if (!(entry = malloc(sizeof(*entry)))) {
+        logMallocError();
+        return NULL;
+      }
+
+      memset(entry, 0, sizeof(*entry));
+      entry->toneCount = key.toneCount;
+
+      {
+        size_t size = entry->toneCount * sizeof(*entry->tones);
+
+        if (!(entry->tones = malloc(size))) {
+          logMallocError();
+          free(entry);
+          return NULL;
+        }
+
+        memcpy(entry->tones, key.tones, size);
+      }
+
+      if (!enqueueItem(entries, entry)) {
+        deallocatePcmTuneEntry(entry, NULL);
+        return NULL;
+      }
+
+      while (getQueueSize(entries) > PCM_TUNE_CACHE_LIMIT) {
+        deleteElement(getQueueHead(entries));
+      }
+    }
+
+    {
+      unsigned char volume = pcmGetVolume();
+
+      if (!entry->bytes ||
+          (entry->sampleRate != device->sampleRate) ||
+          (entry->channelCount != device->channelCount) ||
+          (entry->blockSize != device->blockSize) ||
+          (entry->amplitudeFormat != device->amplitudeFormat) ||
+          (entry->volume != volume)) {
+        if (!pcmRenderTune(device, entry, volume)) return NULL;
+      }
+    }
+
+    return entry;
+  }
+}
+
+static int
+pcmTones (NoteDevice *device, const ToneElement *tune) {
+  const PcmTuneEntry *entry = pcmGetTuneEntry(device, tune);
+
+  if (!entry) {
+    while (tune->duration) {
+      if (!pcmTone(device, tune->duration, tune->frequency)) return 0;
+      tune += 1;
+    }
+  } else {
+    const unsigned char *byte = entry->bytes;
+    const unsigned char *end = byte + entry->size;
+
+    if (!pcmFlushBlock(device)) return 0;
+
+    while (byte < end) {
+      if (!writePcmData(device->pcm, byte, device->blockSize)) return 0;
+      byte += device->blockSize;
+    }
+  }
+
+  return pcmFlush(device);
+}
+
+static int
+pcmGetDelay (NoteDevice *device) {
+  int delay = getPcmOutputDelay(device->pcm);
+  if (delay < 0) return delay;
+
+  /* add what's still waiting in the block for it to be written */
+  return delay + ((device->blockUsed / device->frameSize) * 1000 / device->sampleRate);
+}
+
 const NoteMethods pcmNoteMethods = {
   .construct = pcmConstruct,
   .destruct = pcmDestruct,
+  .isPersistent = pcmIsPersistent,
 
   .tone = pcmTone,
   .note = pcmNote,
-  .flush = pcmFlush
+  .tones = pcmTones,
+  .flush = pcmFlush,
+  .getDelay = pcmGetDelay
 };
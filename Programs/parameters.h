@@ -42,6 +42,14 @@ extern "C" {
 #define SPEECH_DRIVER_THREAD_STOP_TIMEOUT 5000
 
 #define SPEECH_RESPONSE_WAIT_TIMEOUT 5000
+#define SPEECH_CACHE_TEXT_LIMIT 40
+
+#define SPEECH_CHUNK_FIRST_SIZE 100
+#define SPEECH_CHUNK_SIZE 400
+#define SPEECH_CHUNK_TRACKING_LIMIT 16
+
+#define SPEECH_DISPATCHER_SETTINGS_DELAY 50
+#define SPEECH_DISPATCHER_RECONNECT_INTERVAL 5000
 
 #define SCREEN_DRIVER_START_RETRY_INTERVAL 5000
 #define SCREEN_FREEZE_REMINDER_INTERVAL 30000
@@ -57,9 +65,13 @@ extern "C" {
 #define ROUTING_PROCESS_NICENESS 10
 #define ROUTING_POLL_INTERVAL 1
 #define ROUTING_MAXIMUM_TIMEOUT 2000
+#define ROUTING_PREDICTIVE_MARGIN 2
+#define ROUTING_PREDICTIVE_DEADLINE 10000
 
 #define TUNE_DEVICE_CLOSE_DELAY 2000
 #define TUNE_TOGGLE_REPEAT_DELAY 100
+#define PCM_TUNE_CACHE_LIMIT 64
+#define PCM_TUNE_DURATION_LIMIT 2000
 
 #define MESSAGE_HOLD_TIMEOUT 4000
 
@@ -72,13 +84,17 @@ extern "C" {
 #define GPM_CONNECTION_RESET_DELAY 5000
 
 #define GIO_USB_INPUT_MONITOR_DISABLE 0
+#define GIO_LATENCY_RESPONSE_TIMEOUT 1000
 
 #define SERIAL_DEVICE_RESTART_DELAY 500
+#define SERIAL_LOW_LATENCY_TIMER 1
 
 #define USB_INPUT_AWAIT_RETRY_INTERVAL_MINIMUM 10
 #define USB_INPUT_READ_INITIAL_TIMEOUT_DEFAULT 20
 #define USB_INPUT_INTERRUPT_DELAY_MAXIMUM 16
-#define USB_INPUT_INTERRUPT_REQUESTS_MAXIMUM 8
+#define USB_INPUT_INTERRUPT_REQUESTS_MINIMUM 4
+#define USB_INPUT_INTERRUPT_REQUESTS_MAXIMUM 16
+#define USB_INPUT_RING_SIZE 0X10000
 
 #define BLUETOOTH_DEVICE_NAME_OBTAIN_TIMEOUT 5000
 #define BLUETOOTH_CHANNEL_BUSY_RETRY_TIMEOUT 2000
@@ -87,6 +103,7 @@ extern "C" {
 
 #define LINUX_INPUT_DEVICE_OPEN_DELAY 1000
 #define LINUX_USB_INPUT_PIPE_DISABLE 0
+#define LINUX_USB_INPUT_RING_DISABLE 0
 #define LINUX_USB_INPUT_USE_SIGNAL_MONITOR 0
 #define LINUX_USB_INPUT_TREAT_INTERRUPT_AS_BULK 0
 #define LINUX_BLUETOOTH_NAME_OBTAIN_ASYNCHRONOUS 1
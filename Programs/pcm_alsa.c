@@ -25,6 +25,12 @@
 #include "timing.h"
 #include "pcm.h"
 
+#define PCM_ALSA_BUFFER_TIME 500000
+#define PCM_ALSA_PERIOD_COUNT 8
+
+#define PCM_ALSA_LOW_LATENCY_BUFFER_TIME 40000
+#define PCM_ALSA_LOW_LATENCY_PERIOD_COUNT 4
+
 struct PcmDeviceStruct {
   snd_pcm_t *handle;
   snd_pcm_hw_params_t *hardwareParameters;
@@ -32,6 +38,7 @@ struct PcmDeviceStruct {
   unsigned int sampleRate;
   unsigned int bufferTime;
   unsigned int periodTime;
+  unsigned char mmapAccess:1;
 };
 
 static void
@@ -39,6 +46,25 @@ logPcmError (int level, const char *action, int code) {
   logMessage(level, "ALSA PCM %s error: %s", action, snd_strerror(code));
 }
 
+static int
+configurePcmAccess (PcmDevice *pcm, PcmLatency latency, int errorLevel) {
+  int result;
+
+  if (latency == PCM_LATENCY_LOW) {
+    /* Writing directly into the ring buffer saves a copy per period. */
+    if (snd_pcm_hw_params_set_access(pcm->handle, pcm->hardwareParameters, SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0) {
+      pcm->mmapAccess = 1;
+      return 1;
+    }
+  }
+
+  pcm->mmapAccess = 0;
+  if ((result = snd_pcm_hw_params_set_access(pcm->handle, pcm->hardwareParameters, SND_PCM_ACCESS_RW_INTERLEAVED)) >= 0) return 1;
+
+  logPcmError(errorLevel, "set access", result);
+  return 0;
+}
+
 static int
 configurePcmSampleFormat (PcmDevice *pcm, int errorLevel) {
   static const snd_pcm_format_t formats[] = {
@@ -125,8 +151,93 @@ configurePcmChannelCount (PcmDevice *pcm, int errorLevel) {
   return 1;
 }
 
+static int
+getPcmFrameSize (PcmDevice *pcm) {
+  return getPcmChannelCount(pcm) * (snd_pcm_hw_params_get_sbits(pcm->hardwareParameters) / 8);
+}
+
+static int
+primePcmDevice (PcmDevice *pcm, int errorLevel) {
+  snd_pcm_uframes_t periodSize;
+  snd_pcm_format_t format;
+  int result;
+
+  if ((result = snd_pcm_hw_params_get_period_size(pcm->hardwareParameters, &periodSize, NULL)) < 0) {
+    logPcmError(errorLevel, "get period size", result);
+    return 0;
+  }
+
+  if ((result = snd_pcm_hw_params_get_format(pcm->hardwareParameters, &format)) < 0) {
+    logPcmError(errorLevel, "get format", result);
+    return 0;
+  }
+
+  {
+    snd_pcm_sw_params_t *softwareParameters;
+    snd_pcm_uframes_t boundary;
+
+    snd_pcm_sw_params_alloca(&softwareParameters);
+
+    if ((result = snd_pcm_sw_params_current(pcm->handle, softwareParameters)) < 0) {
+      logPcmError(errorLevel, "get software parameters", result);
+      return 0;
+    }
+
+    if ((result = snd_pcm_sw_params_get_boundary(softwareParameters, &boundary)) < 0) {
+      logPcmError(errorLevel, "get boundary", result);
+      return 0;
+    }
+
+    /* Start playing as soon as a single period has been written. */
+    if ((result = snd_pcm_sw_params_set_start_threshold(pcm->handle, softwareParameters, periodSize)) < 0) {
+      logPcmError(errorLevel, "set start threshold", result);
+      return 0;
+    }
+
+    /* Never stop on an underrun - keep playing silence instead so that
+     * the next tone doesn't have to wait for the device to be restarted.
+     */
+    if ((result = snd_pcm_sw_params_set_stop_threshold(pcm->handle, softwareParameters, boundary)) < 0) {
+      logPcmError(errorLevel, "set stop threshold", result);
+      return 0;
+    }
+
+    /* Overwrite whatever has been played with silence so that a late
+     * period never replays stale samples (which is heard as a click).
+     */
+    if ((result = snd_pcm_sw_params_set_silence_threshold(pcm->handle, softwareParameters, 0)) < 0) {
+      logPcmError(errorLevel, "set silence threshold", result);
+      return 0;
+    }
+
+    if ((result = snd_pcm_sw_params_set_silence_size(pcm->handle, softwareParameters, boundary)) < 0) {
+      logPcmError(errorLevel, "set silence size", result);
+      return 0;
+    }
+
+    if ((result = snd_pcm_sw_params(pcm->handle, softwareParameters)) < 0) {
+      logPcmError(errorLevel, "set software parameters", result);
+      return 0;
+    }
+  }
+
+  {
+    int size = periodSize * getPcmFrameSize(pcm);
+    unsigned char silence[size];
+
+    if ((result = snd_pcm_format_set_silence(format, silence, (periodSize * pcm->channelCount))) < 0) {
+      logPcmError(errorLevel, "set silence", result);
+      return 0;
+    }
+
+    if (!writePcmData(pcm, silence, size)) return 0;
+  }
+
+  return 1;
+}
+
 PcmDevice *
-openPcmDevice (int errorLevel, const char *device) {
+openPcmDevice (int errorLevel, const char *device, PcmLatency latency) {
   PcmDevice *pcm;
 
   if ((pcm = malloc(sizeof(*pcm)))) {
@@ -138,17 +249,21 @@ openPcmDevice (int errorLevel, const char *device) {
 
       if ((result = snd_pcm_hw_params_malloc(&pcm->hardwareParameters)) >= 0) {
         if ((result = snd_pcm_hw_params_any(pcm->handle, pcm->hardwareParameters)) >= 0) {
-          if ((result = snd_pcm_hw_params_set_access(pcm->handle, pcm->hardwareParameters, SND_PCM_ACCESS_RW_INTERLEAVED)) >= 0) {
+          if (configurePcmAccess(pcm, latency, errorLevel)) {
             if (configurePcmSampleFormat(pcm, errorLevel)) {
               if (configurePcmSampleRate(pcm, errorLevel)) {
                 if (configurePcmChannelCount(pcm, errorLevel)) {
-                  pcm->bufferTime = 500000;
+                  int lowLatency = latency == PCM_LATENCY_LOW;
+
+                  pcm->bufferTime = lowLatency? PCM_ALSA_LOW_LATENCY_BUFFER_TIME: PCM_ALSA_BUFFER_TIME;
                   if ((result = snd_pcm_hw_params_set_buffer_time_near(pcm->handle, pcm->hardwareParameters, &pcm->bufferTime, NULL)) >= 0) {
-                    pcm->periodTime = pcm->bufferTime / 8;
+                    pcm->periodTime = pcm->bufferTime / (lowLatency? PCM_ALSA_LOW_LATENCY_PERIOD_COUNT: PCM_ALSA_PERIOD_COUNT);
                     if ((result = snd_pcm_hw_params_set_period_time_near(pcm->handle, pcm->hardwareParameters, &pcm->periodTime, NULL)) >= 0) {
                       if ((result = snd_pcm_hw_params(pcm->handle, pcm->hardwareParameters)) >= 0) {
-                        logMessage(LOG_DEBUG, "ALSA PCM: Chan=%u Rate=%u BufTim=%u PerTim=%u", pcm->channelCount, pcm->sampleRate, pcm->bufferTime, pcm->periodTime);
-                        return pcm;
+                        if (!lowLatency || primePcmDevice(pcm, errorLevel)) {
+                          logMessage(LOG_DEBUG, "ALSA PCM: Chan=%u Rate=%u BufTim=%u PerTim=%u Mmap=%u", pcm->channelCount, pcm->sampleRate, pcm->bufferTime, pcm->periodTime, pcm->mmapAccess);
+                          return pcm;
+                        }
                       } else {
                         logPcmError(errorLevel, "set hardware parameters", result);
                       }
@@ -161,8 +276,6 @@ openPcmDevice (int errorLevel, const char *device) {
                 }
               }
             }
-          } else {
-            logPcmError(errorLevel, "set access", result);
           }
         } else {
           logPcmError(errorLevel, "get hardware parameters", result);
@@ -194,9 +307,32 @@ closePcmDevice (PcmDevice *pcm) {
   free(pcm);
 }
 
-static int
-getPcmFrameSize (PcmDevice *pcm) {
-  return getPcmChannelCount(pcm) * (snd_pcm_hw_params_get_sbits(pcm->hardwareParameters) / 8);
+static void
+resyncPcmDevice (PcmDevice *pcm) {
+  /* The stream is never stopped (see primePcmDevice) so, after an idle gap,
+   * the hardware pointer may have run past the application pointer. Writing
+   * from there would put new samples behind what's being played, so skip
+   * forward to the hardware pointer first.
+   */
+  snd_pcm_uframes_t bufferSize;
+  snd_pcm_sframes_t available;
+  int result;
+
+  if ((result = snd_pcm_hw_params_get_buffer_size(pcm->hardwareParameters, &bufferSize)) < 0) {
+    logPcmError(LOG_WARNING, "get buffer size", result);
+    return;
+  }
+
+  /* errors (e.g. an underrun) are recovered from by the write */
+  if ((available = snd_pcm_avail(pcm->handle)) < 0) return;
+
+  if ((snd_pcm_uframes_t)available > bufferSize) {
+    snd_pcm_sframes_t skipped;
+
+    if ((skipped = snd_pcm_forward(pcm->handle, (available - bufferSize))) < 0) {
+      logPcmError(LOG_WARNING, "forward", skipped);
+    }
+  }
 }
 
 int
@@ -204,10 +340,13 @@ writePcmData (PcmDevice *pcm, const unsigned char *buffer, int count) {
   int frameSize = getPcmFrameSize(pcm);
   int framesLeft = count / frameSize;
 
+  resyncPcmDevice(pcm);
+
   while (framesLeft > 0) {
     int result;
 
-    if ((result = snd_pcm_writei(pcm->handle, buffer, framesLeft)) > 0) {
+    if ((result = pcm->mmapAccess? snd_pcm_mmap_writei(pcm->handle, buffer, framesLeft):
+                                   snd_pcm_writei(pcm->handle, buffer, framesLeft)) > 0) {
       framesLeft -= result;
       buffer += result * frameSize;
     } else {
@@ -349,3 +488,16 @@ cancelPcmOutput (PcmDevice *pcm) {
   int result;
   if ((result = snd_pcm_drop(pcm->handle)) < 0) logPcmError(LOG_WARNING, "drop", result);
 }
+
+int
+getPcmOutputDelay (PcmDevice *pcm) {
+  snd_pcm_sframes_t frames;
+
+  /* not known while recovering from an underrun */
+  if (snd_pcm_delay(pcm->handle, &frames) < 0) return -1;
+
+  /* negative after an idle gap (see resyncPcmDevice) */
+  if (frames < 0) frames = 0;
+
+  return frames * 1000 / pcm->sampleRate;
+}
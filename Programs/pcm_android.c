@@ -37,7 +37,7 @@ findPcmDeviceClass (JNIEnv *env) {
 }
 
 PcmDevice *
-openPcmDevice (int errorLevel, const char *device) {
+openPcmDevice (int errorLevel, const char *device, PcmLatency latency) {
   PcmDevice *pcm = malloc(sizeof(*pcm));
 
   if (pcm) {
@@ -282,3 +282,8 @@ cancelPcmOutput (PcmDevice *pcm) {
     }
   }
 }
+
+int
+getPcmOutputDelay (PcmDevice *pcm) {
+  return -1;
+}
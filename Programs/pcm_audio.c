@@ -35,7 +35,7 @@ struct PcmDeviceStruct {
 };
 
 PcmDevice *
-openPcmDevice (int errorLevel, const char *device) {
+openPcmDevice (int errorLevel, const char *device, PcmLatency latency) {
   PcmDevice *pcm;
   if ((pcm = malloc(sizeof(*pcm)))) {
     if (!*device) device = getenv("AUDIODEV");
@@ -182,3 +182,8 @@ void
 cancelPcmOutput (PcmDevice *pcm) {
   ioctl(pcm->fileDescriptor, I_FLUSH);
 }
+
+int
+getPcmOutputDelay (PcmDevice *pcm) {
+  return -1;
+}
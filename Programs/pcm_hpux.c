@@ -50,7 +50,7 @@ getAudioAttributes (PcmDevice *pcm) {
 #endif /* HAVE_HPUX_AUDIO */
 
 PcmDevice *
-openPcmDevice (int errorLevel, const char *device) {
+openPcmDevice (int errorLevel, const char *device, PcmLatency latency) {
 #ifdef HAVE_HPUX_AUDIO
   PcmDevice *pcm;
   if ((pcm = malloc(sizeof(*pcm)))) {
@@ -190,3 +190,8 @@ awaitPcmOutput (PcmDevice *pcm) {
 void
 cancelPcmOutput (PcmDevice *pcm) {
 }
+
+int
+getPcmOutputDelay (PcmDevice *pcm) {
+  return -1;
+}
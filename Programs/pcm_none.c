@@ -22,7 +22,7 @@
 #include "pcm.h"
 
 PcmDevice *
-openPcmDevice (int errorLevel, const char *device) {
+openPcmDevice (int errorLevel, const char *device, PcmLatency latency) {
   logMessage(errorLevel, "PCM device not supported.");
   return NULL;
 }
@@ -82,3 +82,8 @@ awaitPcmOutput (PcmDevice *pcm) {
 void
 cancelPcmOutput (PcmDevice *pcm) {
 }
+
+int
+getPcmOutputDelay (PcmDevice *pcm) {
+  return -1;
+}
@@ -30,6 +30,10 @@
 #include "pcm.h"
 
 #define PCM_OSS_DEVICE_PATH "/dev/dsp"
+#define PCM_OSS_LOW_LATENCY_FRAGMENT_COUNT 4
+#define PCM_OSS_LOW_LATENCY_MILLISECONDS 40
+#define PCM_OSS_DEFAULT_FRAGMENT_SHIFT 7
+#define PCM_OSS_MINIMUM_FRAGMENT_SHIFT 4
 
 #ifndef SNDCTL_DSP_SPEED
 #define SNDCTL_DSP_SPEED SOUND_PCM_WRITE_RATE
@@ -44,13 +48,16 @@ struct PcmDeviceStruct {
   int driverVersion;
   int sampleRate;
   int channelCount;
+  PcmLatency latency;
 };
 
 PcmDevice *
-openPcmDevice (int errorLevel, const char *device) {
+openPcmDevice (int errorLevel, const char *device, PcmLatency latency) {
   PcmDevice *pcm;
   if ((pcm = malloc(sizeof(*pcm)))) {
     if (!*device) device = PCM_OSS_DEVICE_PATH;
+    pcm->latency = latency;
+
     if ((pcm->fileDescriptor = open(device, O_WRONLY|O_NONBLOCK)) != -1) {
       /* Nonblocking if snd_seq_oss is loaded with nonblock_open=1.
        * There appears to be a bug in this case as write() always
@@ -90,10 +97,46 @@ writePcmData (PcmDevice *pcm, const unsigned char *buffer, int count) {
   return writeFile(pcm->fileDescriptor, buffer, count) != -1;
 }
 
+static int
+getPcmSampleSize (PcmDevice *pcm) {
+  switch (getPcmAmplitudeFormat(pcm)) {
+    case PCM_FMT_U16B:
+    case PCM_FMT_S16B:
+    case PCM_FMT_U16L:
+    case PCM_FMT_S16L:
+      return 2;
+
+    default:
+      return 1;
+  }
+}
+
+static int
+getLowLatencyFragmentShift (PcmDevice *pcm) {
+  /* Split the latency budget across the fragments and round each one
+   * down to a power of two, which is what SNDCTL_DSP_SETFRAGMENT needs.
+   */
+  long int bytes = (long int)pcm->sampleRate * pcm->channelCount * getPcmSampleSize(pcm);
+  bytes = bytes * PCM_OSS_LOW_LATENCY_MILLISECONDS / 1000 / PCM_OSS_LOW_LATENCY_FRAGMENT_COUNT;
+
+  int shift = PCM_OSS_MINIMUM_FRAGMENT_SHIFT;
+  while ((1L << (shift + 1)) <= bytes) shift += 1;
+  return shift;
+}
+
 int
 getPcmBlockSize (PcmDevice *pcm) {
-  int fragmentCount = (1 << 0X10) - 1;
-  int fragmentShift = 7;
+  int fragmentCount;
+  int fragmentShift;
+
+  if (pcm->latency == PCM_LATENCY_LOW) {
+    fragmentCount = PCM_OSS_LOW_LATENCY_FRAGMENT_COUNT;
+    fragmentShift = getLowLatencyFragmentShift(pcm);
+  } else {
+    fragmentCount = (1 << 0X10) - 1;
+    fragmentShift = PCM_OSS_DEFAULT_FRAGMENT_SHIFT;
+  }
+
   int fragmentSize = 1 << fragmentShift;
   int fragmentSetting = (fragmentCount << 0X10) | fragmentShift;
   ioctl(pcm->fileDescriptor, SNDCTL_DSP_SETFRAGMENT, &fragmentSetting);
@@ -184,3 +227,17 @@ void
 cancelPcmOutput (PcmDevice *pcm) {
   ioctl(pcm->fileDescriptor, SNDCTL_DSP_RESET, 0);
 }
+
+int
+getPcmOutputDelay (PcmDevice *pcm) {
+#ifdef SNDCTL_DSP_GETODELAY
+  int bytes;
+
+  if (ioctl(pcm->fileDescriptor, SNDCTL_DSP_GETODELAY, &bytes) != -1) {
+    long int bytesPerSecond = (long int)pcm->sampleRate * pcm->channelCount * getPcmSampleSize(pcm);
+    if (bytesPerSecond) return bytes * 1000L / bytesPerSecond;
+  }
+#endif /* SNDCTL_DSP_GETODELAY */
+
+  return -1;
+}
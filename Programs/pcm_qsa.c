@@ -59,7 +59,7 @@ reconfigurePcmChannel (PcmDevice *pcm, int errorLevel) {
 }
 
 PcmDevice *
-openPcmDevice (int errorLevel, const char *device) {
+openPcmDevice (int errorLevel, const char *device, PcmLatency latency) {
   PcmDevice *pcm;
   if ((pcm = malloc(sizeof(*pcm)))) {
     int code;
@@ -263,3 +263,8 @@ cancelPcmOutput (PcmDevice *pcm) {
     logPcmError(LOG_WARNING, "drain", code);
   }
 }
+
+int
+getPcmOutputDelay (PcmDevice *pcm) {
+  return -1;
+}
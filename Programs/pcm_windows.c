@@ -49,7 +49,7 @@ LogWaveOutError(MMRESULT error, int errorLevel, const char *action) {
 }
 
 PcmDevice *
-openPcmDevice (int errorLevel, const char *device) {
+openPcmDevice (int errorLevel, const char *device, PcmLatency latency) {
   PcmDevice *pcm;
   MMRESULT mmres;
   WAVEOUTCAPS caps;
@@ -291,3 +291,8 @@ void
 cancelPcmOutput (PcmDevice *pcm) {
   waveOutReset(pcm->handle);
 }
+
+int
+getPcmOutputDelay (PcmDevice *pcm) {
+  return -1;
+}
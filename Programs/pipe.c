@@ -108,6 +108,7 @@ ASYNC_INPUT_CALLBACK(handleNamedPipeInput) {
   } else {
     const NamedPipeInputCallbackParameters input = {
       .buffer = parameters->buffer,
+      .size = parameters->size,
       .length = parameters->length,
       .data = obj->data
     };
@@ -27,6 +27,7 @@ typedef struct NamedPipeObjectStruct NamedPipeObject;
 
 typedef struct {
   const unsigned char *buffer;
+  size_t size;
   size_t length;
   void *data;
 } NamedPipeInputCallbackParameters;
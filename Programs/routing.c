@@ -40,6 +40,8 @@
 #include "scr.h"
 #include "routing.h"
 
+int opt_predictiveRouting = 0;
+
 typedef enum {
   CRR_DONE,
   CRR_NEAR,
@@ -79,6 +81,12 @@ typedef struct {
     long sum;
     int count;
   } time;
+
+  struct {
+    TimePeriod period;
+    unsigned int sent;
+    int needed;
+  } keys;
 } CursorRoutingData;
 
 typedef enum {
@@ -226,7 +234,14 @@ awaitCursorMotion (CursorRoutingData *crd, int direction) {
   long int timeout = crd->time.sum / crd->time.count;
 
   while (1) {
-    asyncWait(ROUTING_POLL_INTERVAL);
+    {
+      /* Sleep until the screen changes if the driver can tell us when it
+       * does - the cursor can't have moved until then.
+       */
+      long int wait = timeout + 1 - getMonotonicElapsed(&start);
+      if (wait < 1) wait = 1;
+      if (!awaitScreenUpdate(wait)) asyncWait(ROUTING_POLL_INTERVAL);
+    }
 
     TimeValue now;
     getMonotonicTime(&now);
@@ -264,7 +279,7 @@ awaitCursorMotion (CursorRoutingData *crd, int direction) {
 }
 
 static int
-moveCursor (CursorRoutingData *crd, const CursorDirectionEntry *direction) {
+moveCursor (CursorRoutingData *crd, const CursorDirectionEntry *direction, int count) {
   crd->vertical.row = crd->current.row - crd->vertical.scroll;
   if (!readRow(crd, NULL, crd->vertical.row)) return 0;
 
@@ -273,8 +288,17 @@ moveCursor (CursorRoutingData *crd, const CursorDirectionEntry *direction) {
   sigprocmask(SIG_BLOCK, &crd->signal.mask, &oldMask);
 #endif /* SIGUSR1 */
 
-  logRouting("move: %s", direction->name);
-  insertScreenKey(direction->key);
+  if (count == 1) {
+    logRouting("move: %s", direction->name);
+  } else {
+    logRouting("move: %s x%d", direction->name, count);
+  }
+
+  for (int index=0; index<count; index+=1) {
+    insertScreenKey(direction->key);
+  }
+
+  crd->keys.sent += count;
 
 #ifdef SIGUSR1
   sigprocmask(SIG_SETMASK, &oldMask, NULL);
@@ -286,12 +310,18 @@ moveCursor (CursorRoutingData *crd, const CursorDirectionEntry *direction) {
 static RoutingResult
 adjustCursorPosition (CursorRoutingData *crd, int where, int trgy, int trgx, const CursorAxisEntry *axis) {
   logRouting("to: [%d,%d]", trgx, trgy);
+  int predict = opt_predictiveRouting;
 
   while (1) {
     int dify = trgy - crd->current.row;
     int difx = (trgx < 0)? 0: (trgx - crd->current.column);
     int dir;
 
+    if (opt_predictiveRouting && afterTimePeriod(&crd->keys.period, NULL)) {
+      logRouting("deadline reached");
+      return CRR_FAIL;
+    }
+
     /* determine which direction the cursor needs to move in */
     if (dify) {
       dir = (dify > 0)? 1: -1;
@@ -301,8 +331,38 @@ adjustCursorPosition (CursorRoutingData *crd, int where, int trgy, int trgx, con
       return CRR_DONE;
     }
 
+    /* Once the application's response time has been measured (by at least
+     * one single step), move most of the way in one batch of keys. The last
+     * few positions are still approached one step at a time so that any
+     * cells which don't take exactly one key (tabs, wide characters,
+     * wrapped lines) can be corrected.
+     */
+    if (predict && (crd->time.count > 1)) {
+      int distance = dify? ((trgx < 0)? dify: 0): difx;
+      int count = (distance * dir) - ROUTING_PREDICTIVE_MARGIN;
+
+      if (count > 1) {
+        if (!moveCursor(crd, ((dir > 0)? axis->forward: axis->backward), count)) return CRR_FAIL;
+        if (!awaitCursorMotion(crd, dir)) return CRR_FAIL;
+
+        int moved = dify? (crd->current.row - crd->previous.row):
+                          (crd->current.column - crd->previous.column);
+
+        if (!moved && (crd->current.row == crd->previous.row)) return CRR_NEAR;
+
+        if ((moved * dir) != count) {
+          logRouting("prediction missed: expected %d, moved %d", count, moved * dir);
+          predict = 0;
+        } else if (!dify && (crd->current.row != trgy)) {
+          predict = 0;
+        }
+
+        continue;
+      }
+    }
+
     /* tell the cursor to move in the needed direction */
-    if (!moveCursor(crd, ((dir > 0)? axis->forward: axis->backward))) return CRR_FAIL;
+    if (!moveCursor(crd, ((dir > 0)? axis->forward: axis->backward), 1)) return CRR_FAIL;
     if (!awaitCursorMotion(crd, dir)) return CRR_FAIL;
 
     if (crd->current.row != crd->previous.row) {
@@ -340,7 +400,7 @@ adjustCursorPosition (CursorRoutingData *crd, int where, int trgy, int trgx, con
      * try going back to the previous position since it was obviously
      * the nearest ever reached.
      */
-    if (!moveCursor(crd, ((dir > 0)? axis->backward: axis->forward))) return CRR_FAIL;
+    if (!moveCursor(crd, ((dir > 0)? axis->backward: axis->forward), 1)) return CRR_FAIL;
     return awaitCursorMotion(crd, -dir)? CRR_NEAR: CRR_FAIL;
   }
 }
@@ -377,10 +437,21 @@ routeCursor (const RoutingParameters *parameters) {
   crd.vertical.buffer = NULL;
   crd.time.sum = ROUTING_MAXIMUM_TIMEOUT;
   crd.time.count = 1;
+  crd.keys.sent = 0;
+  crd.keys.needed = 0;
+  startTimePeriod(&crd.keys.period, ROUTING_PREDICTIVE_DEADLINE);
 
   if (getCurrentPosition(&crd)) {
     logRouting("from: [%d,%d]", crd.current.column, crd.current.row);
 
+    {
+      crd.keys.needed += abs(parameters->row - crd.current.row);
+
+      if (parameters->column >= 0) {
+        crd.keys.needed += abs(parameters->column - crd.current.column);
+      }
+    }
+
     if (parameters->column < 0) {
       adjustCursorVertically(&crd, 0, parameters->row);
     } else {
@@ -396,6 +467,15 @@ routeCursor (const RoutingParameters *parameters) {
     }
   }
 
+  {
+    long int elapsed;
+    afterTimePeriod(&crd.keys.period, &elapsed);
+
+    logRouting("keys: sent=%u needed=%d time=%ldms average=%ldms",
+               crd.keys.sent, crd.keys.needed, elapsed,
+               (crd.time.sum / crd.time.count));
+  }
+
   if (crd.vertical.buffer) free(crd.vertical.buffer);
 
   if (crd.screen.number != parameters->screen) return ROUTING_STATUS_FAILURE;
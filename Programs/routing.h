@@ -32,6 +32,8 @@ typedef enum {
   ROUTING_STATUS_FAILURE
 } RoutingStatus;
 
+extern int opt_predictiveRouting;
+
 extern int startRouting (int column, int row, int screen);
 extern int isRouting (void);
 extern RoutingStatus getRoutingStatus (int wait);
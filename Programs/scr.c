@@ -94,6 +94,11 @@ refreshScreen (void) {
   return currentScreen->refresh();
 }
 
+int
+awaitScreenUpdate (int timeout) {
+  return currentScreen->awaitUpdate(timeout);
+}
+
 void
 describeScreen (ScreenDescription *description) {
   describeBaseScreen(currentScreen, description);
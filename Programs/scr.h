@@ -32,6 +32,7 @@ extern int isMainScreen (void);
 /* Routines which apply to the current screen. */
 extern int pollScreen (void);
 extern int refreshScreen (void);
+extern int awaitScreenUpdate (int timeout);		/* 0 if changes can't be awaited */
 extern void describeScreen (ScreenDescription *);		/* get screen status */
 extern int readScreen (short left, short top, short width, short height, ScreenCharacter *buffer);
 extern int readScreenText (short left, short top, short width, short height, wchar_t *buffer);
@@ -151,6 +151,11 @@ refresh_BaseScreen (void) {
   return 1;
 }
 
+static int
+awaitUpdate_BaseScreen (int timeout) {
+  return 0;
+}
+
 static void
 describe_BaseScreen (ScreenDescription *description) {
   description->rows = 1;
@@ -222,6 +227,7 @@ initializeBaseScreen (BaseScreen *base) {
 
   base->poll = poll_BaseScreen;
   base->refresh = refresh_BaseScreen;
+  base->awaitUpdate = awaitUpdate_BaseScreen;
   base->describe = describe_BaseScreen;
 
   base->readCharacters = readCharacters_BaseScreen;
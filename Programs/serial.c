@@ -245,6 +245,25 @@ serialSetFlowControl (SerialDevice *serial, SerialFlowControl flow) {
   return 0;
 }
 
+int
+serialSetLowLatency (SerialDevice *serial, int enabled) {
+  enabled = !!enabled;
+  if (enabled == serial->lowLatency) return 1;
+  logMessage(LOG_CATEGORY(SERIAL_IO), "set low latency: %s", (enabled? "on": "off"));
+
+  /* remembered even if unsupported so that latency is still measured */
+  serial->lowLatency = enabled;
+  if (serialPutLowLatency(serial, enabled)) return 1;
+
+  if (enabled) logMessage(LOG_WARNING, "serial low latency not supported: %s", serial->devicePath);
+  return 0;
+}
+
+int
+serialGetLowLatency (SerialDevice *serial) {
+  return serial->lowLatency;
+}
+
 int
 serialSetParameters (SerialDevice *serial, const SerialParameters *parameters) {
   if (!serialSetBaud(serial, parameters->baud)) return 0;
@@ -675,13 +694,31 @@ serialConfigureFlowControl (SerialDevice *serial, const char *string) {
   return 1;
 }
 
+static int
+serialConfigureLowLatency (SerialDevice *serial, const char *string) {
+  if (string && *string) {
+    unsigned int flag;
+
+    if (!validateYesNo(&flag, string)) {
+      logMessage(LOG_WARNING, "invalid serial low latency setting: %s", string);
+      return 0;
+    }
+
+    /* not every device supports it, so just go with what we get */
+    serialSetLowLatency(serial, flag);
+  }
+
+  return 1;
+}
+
 typedef enum {
   SERIAL_PARM_NAME,
   SERIAL_PARM_BAUD,
   SERIAL_PARM_DATA_BITS,
   SERIAL_PARM_STOP_BITS,
   SERIAL_PARM_DATA_PARITY,
-  SERIAL_PARM_FLOW_CONTROL
+  SERIAL_PARM_FLOW_CONTROL,
+  SERIAL_PARM_LOW_LATENCY
 } SerialDeviceParameter;
 
 static const char *const serialDeviceParameterNames[] = {
@@ -691,6 +728,7 @@ static const char *const serialDeviceParameterNames[] = {
   "stopBits",
   "parity",
   "flowControl",
+  "lowLatency",
   NULL
 };
 
@@ -728,6 +766,7 @@ serialOpenDevice (const char *identifier) {
           if (!serialConfigureStopBits(serial, parameters[SERIAL_PARM_STOP_BITS])) ok = 0;
           if (!serialConfigureParity(serial, parameters[SERIAL_PARM_DATA_PARITY])) ok = 0;
           if (!serialConfigureFlowControl(serial, parameters[SERIAL_PARM_FLOW_CONTROL])) ok = 0;
+          if (!serialConfigureLowLatency(serial, parameters[SERIAL_PARM_LOW_LATENCY])) ok = 0;
 
           deallocateStrings(parameters);
           if (ok) return serial;
@@ -757,6 +796,7 @@ serialCloseDevice (SerialDevice *serial) {
 #endif /* HAVE_POSIX_THREADS */
 
   serialWriteAttributes(serial, &serial->originalAttributes);
+  serialSetLowLatency(serial, 0);
 
   if (serial->stream) {
     fclose(serial->stream);
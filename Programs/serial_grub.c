@@ -225,6 +225,12 @@ serialPutData (
   return size;
 }
 
+int
+serialPutLowLatency (SerialDevice *serial, int enabled) {
+  errno = ENOSYS;
+  return 0;
+}
+
 int
 serialGetLines (SerialDevice *serial) {
   errno = ENOSYS;
@@ -43,6 +43,7 @@ struct SerialDeviceStruct {
 
   SerialLines linesState;
   SerialLines waitLines;
+  unsigned lowLatency:1;
 
 #ifdef HAVE_POSIX_THREADS
   SerialFlowControlProc *currentFlowControlProc;
@@ -98,6 +99,8 @@ extern ssize_t serialPutData (
   const void *data, size_t size
 );
 
+extern int serialPutLowLatency (SerialDevice *serial, int enabled);
+
 extern int serialGetLines (SerialDevice *serial);
 extern int serialPutLines (SerialDevice *serial, SerialLines high, SerialLines low);
 
@@ -323,6 +323,12 @@ serialPutData (
   return writeFile(serial->fileDescriptor, data, size);
 }
 
+int
+serialPutLowLatency (SerialDevice *serial, int enabled) {
+  errno = ENOSYS;
+  return 0;
+}
+
 int
 serialGetLines (SerialDevice *serial) {
   serial->linesState = serialReadPort(serial, UART_PORT_MSR) & 0XF0;
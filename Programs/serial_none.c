@@ -132,6 +132,12 @@ serialPutData (
   return -1;
 }
 
+int
+serialPutLowLatency (SerialDevice *serial, int enabled) {
+  errno = ENOSYS;
+  return 0;
+}
+
 int
 serialGetLines (SerialDevice *serial) {
   errno = ENOSYS;
@@ -23,7 +23,13 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#include <linux/serial.h>
+#endif /* __linux__ */
+
 #include "log.h"
+#include "parameters.h"
 #include "io_misc.h"
 #include "async_io.h"
 
@@ -455,6 +461,125 @@ serialPutData (
   return writeFile(serial->fileDescriptor, data, size);
 }
 
+#ifdef __linux__
+static char *
+serialMakeLatencyTimerPath (SerialDevice *serial) {
+  struct stat status;
+
+  if (fstat(serial->fileDescriptor, &status) != -1) {
+    char path[0X80];
+
+    snprintf(path, sizeof(path), "/sys/dev/char/%u:%u/device/latency_timer",
+             major(status.st_rdev), minor(status.st_rdev));
+
+    if (access(path, W_OK) != -1) {
+      char *copy = strdup(path);
+      if (copy) return copy;
+      logMallocError();
+    }
+  } else {
+    logSystemError("fstat");
+  }
+
+  return NULL;
+}
+
+static int
+serialReadLatencyTimer (const char *path) {
+  int milliseconds = -1;
+  FILE *stream = fopen(path, "r");
+
+  if (stream) {
+    if (fscanf(stream, "%d", &milliseconds) != 1) milliseconds = -1;
+    fclose(stream);
+  }
+
+  return milliseconds;
+}
+
+static int
+serialWriteLatencyTimer (const char *path, int milliseconds) {
+  FILE *stream = fopen(path, "w");
+
+  if (stream) {
+    int ok = fprintf(stream, "%d\n", milliseconds) > 0;
+    if (fclose(stream) == EOF) ok = 0;
+    if (ok) return 1;
+  }
+
+  logMessage(LOG_WARNING, "can't set latency timer: %s: %s", path, strerror(errno));
+  return 0;
+}
+#endif /* __linux__ */
+
+int
+serialPutLowLatency (SerialDevice *serial, int enabled) {
+  int ok = 0;
+
+#if defined(TIOCGSERIAL) && defined(ASYNC_LOW_LATENCY)
+  {
+    struct serial_struct info;
+
+    if (ioctl(serial->fileDescriptor, TIOCGSERIAL, &info) != -1) {
+      if (enabled) {
+        serial->package.original.serialFlags = info.flags;
+        info.flags |= ASYNC_LOW_LATENCY;
+      } else {
+        info.flags &= ~ASYNC_LOW_LATENCY;
+        info.flags |= serial->package.original.serialFlags & ASYNC_LOW_LATENCY;
+      }
+
+      if (ioctl(serial->fileDescriptor, TIOCSSERIAL, &info) != -1) {
+        ok = 1;
+      } else {
+        logSystemError("TIOCSSERIAL");
+      }
+    } else {
+      logMessage(LOG_CATEGORY(SERIAL_IO), "TIOCGSERIAL: %s", strerror(errno));
+    }
+  }
+#endif /* ASYNC_LOW_LATENCY */
+
+#ifdef __linux__
+  {
+    /* USB adapters (e.g. FTDI) hold input back for a while in the hope of
+     * filling a packet, which is far longer than a braille device takes
+     * to respond.
+     */
+    char *path = serialMakeLatencyTimerPath(serial);
+
+    if (path) {
+      if (enabled) {
+        int milliseconds = serialReadLatencyTimer(path);
+        serial->package.original.latencyTimer = milliseconds;
+
+        if (milliseconds > SERIAL_LOW_LATENCY_TIMER) {
+          if (serialWriteLatencyTimer(path, SERIAL_LOW_LATENCY_TIMER)) {
+            logMessage(LOG_CATEGORY(SERIAL_IO),
+                       "latency timer changed: %dms -> %dms",
+                       milliseconds, SERIAL_LOW_LATENCY_TIMER);
+            ok = 1;
+          }
+        } else if (milliseconds != -1) {
+          ok = 1;
+        }
+      } else {
+        int milliseconds = serial->package.original.latencyTimer;
+
+        if (milliseconds > SERIAL_LOW_LATENCY_TIMER) {
+          if (serialWriteLatencyTimer(path, milliseconds)) ok = 1;
+        }
+      }
+
+      free(path);
+    }
+  }
+#endif /* __linux__ */
+
+  if (!ok) errno = ENOSYS;
+  return ok;
+}
+
 int
 serialGetLines (SerialDevice *serial) {
 #ifdef TIOCMGET
@@ -512,6 +637,8 @@ serialMonitorWaitLines (SerialDevice *serial) {
 int
 serialConnectDevice (SerialDevice *serial, const char *device) {
   serial->package.inputMonitor = NULL;
+  serial->package.original.serialFlags = 0;
+  serial->package.original.latencyTimer = -1;
 
   if ((serial->fileDescriptor = open(device, O_RDWR|O_NOCTTY|O_NONBLOCK)) != -1) {
     if (isatty(serial->fileDescriptor)) {
@@ -45,6 +45,11 @@ typedef int SerialLines;
 
 typedef struct {
   AsyncHandle inputMonitor;
+
+  struct {
+    int serialFlags;
+    int latencyTimer;
+  } original;
 } SerialPackageFields;
 
 #ifdef __cplusplus
@@ -159,6 +159,16 @@ drainSpeech (SpeechSynthesizer *spk) {
   return 1;
 }
 
+int
+awaitSpeech (SpeechSynthesizer *spk, int timeout) {
+  return awaitSpeechRequests(spk->driver.thread, timeout);
+}
+
+void
+getSpeechStatistics (SpeechSynthesizer *spk, SpeechQueueStatistics *statistics) {
+  getSpeechQueueStatistics(spk->driver.thread, statistics);
+}
+
 int
 canSetSpeechVolume (SpeechSynthesizer *spk) {
   return spk->setVolume != NULL;
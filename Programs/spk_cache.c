@@ -0,0 +1,206 @@
+/*
+ * BRLTTY - A background process providing access to the console screen (when in
+ *          text mode) for a blind person using a refreshable braille display.
+ *
+ * Copyright (C) 1995-2022 by The BRLTTY Developers.
+ *
+ * BRLTTY comes with ABSOLUTELY NO WARRANTY.
+ *
+ * This is free software, placed under the terms of the
+ * GNU Lesser General Public License, as published by the Free Software
+ * Foundation; either version 2.1 of the License, or (at your option) any
+ * later version. Please see the file LICENSE-LGPL for details.
+ *
+ * Web Page: http://brltty.app/
+ *
+ * This software is maintained by Dave Mielke <dave@mielke.cc>.
+ */
+
+#include "prologue.h"
+
+#include <string.h>
+
+#include "log.h"
+#include "parameters.h"
+#include "spk_cache.h"
+#include "queue.h"
+
+typedef struct {
+  char *voice;
+  unsigned char volume;
+  unsigned char rate;
+  unsigned char pitch;
+  unsigned char punctuation;
+
+  size_t length;
+  size_t count;
+  int sampleRate;
+
+  unsigned char *text;
+  int16_t samples[];
+} SpeechCacheEntry;
+
+struct SpeechCacheStruct {
+  Queue *entries;
+  size_t maximumSize;
+  size_t currentSize;
+
+  struct {
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+  } statistics;
+};
+
+static size_t
+getSpeechCacheEntrySize (const SpeechCacheEntry *entry) {
+  return entry->count * sizeof(entry->samples[0]);
+}
+
+static void
+deallocateSpeechCacheEntry (void *item, void *data) {
+  SpeechCacheEntry *entry = item;
+  SpeechCache *cache = data;
+
+  cache->currentSize -= getSpeechCacheEntrySize(entry);
+  free(entry->voice);
+  free(entry);
+}
+
+SpeechCache *
+newSpeechCache (size_t size) {
+  SpeechCache *cache;
+
+  if ((cache = malloc(sizeof(*cache)))) {
+    memset(cache, 0, sizeof(*cache));
+    cache->maximumSize = size;
+    cache->currentSize = 0;
+
+    if ((cache->entries = newQueue(deallocateSpeechCacheEntry, NULL))) {
+      setQueueData(cache->entries, cache);
+      return cache;
+    }
+
+    free(cache);
+  } else {
+    logMallocError();
+  }
+
+  return NULL;
+}
+
+void
+destroySpeechCache (SpeechCache *cache) {
+  logMessage(LOG_DEBUG,
+             "speech cache statistics: Entries:%d Size:%zu Hits:%u Misses:%u Evictions:%u",
+             getQueueSize(cache->entries), cache->currentSize,
+             cache->statistics.hits, cache->statistics.misses,
+             cache->statistics.evictions);
+
+  deallocateQueue(cache->entries);
+  free(cache);
+}
+
+int
+isCacheableSpeech (const SpeechCache *cache, size_t length) {
+  return cache && length && (length <= SPEECH_CACHE_TEXT_LIMIT);
+}
+
+static int
+testSpeechCacheEntry (const void *item, void *data) {
+  const SpeechCacheEntry *entry = item;
+  const SpeechCacheKey *key = data;
+
+  if (entry->length != key->length) return 0;
+  if (entry->volume != key->volume) return 0;
+  if (entry->rate != key->rate) return 0;
+  if (entry->pitch != key->pitch) return 0;
+  if (entry->punctuation != key->punctuation) return 0;
+  if (memcmp(entry->text, key->text, key->length) != 0) return 0;
+
+  {
+    const char *voice = key->voice? key->voice: "";
+    if (strcmp(entry->voice, voice) != 0) return 0;
+  }
+
+  return 1;
+}
+
+int
+getCachedSpeech (SpeechCache *cache, const SpeechCacheKey *key, SpeechCacheAudio *audio) {
+  Element *element = findElement(cache->entries, testSpeechCacheEntry, (void *)key);
+
+  if (element) {
+    const SpeechCacheEntry *entry = getElementItem(element);
+
+    audio->samples = entry->samples;
+    audio->count = entry->count;
+    audio->sampleRate = entry->sampleRate;
+
+    requeueElement(element);
+    cache->statistics.hits += 1;
+    return 1;
+  }
+
+  cache->statistics.misses += 1;
+  return 0;
+}
+
+int
+putCachedSpeech (SpeechCache *cache, const SpeechCacheKey *key, const SpeechCacheAudio *audio) {
+  size_t audioSize = audio->count * sizeof(audio->samples[0]);
+  if (!audio->count) return 0;
+  if (audioSize > cache->maximumSize) return 0;
+
+  {
+    Element *element = findElement(cache->entries, testSpeechCacheEntry, (void *)key);
+    if (element) deleteElement(element);
+  }
+
+  while (cache->currentSize + audioSize > cache->maximumSize) {
+    Element *element = getQueueHead(cache->entries);
+    if (!element) break;
+
+    deleteElement(element);
+    cache->statistics.evictions += 1;
+  }
+
+  {
+    SpeechCacheEntry *entry;
+    size_t size = sizeof(*entry) + audioSize + key->length;
+
+    if ((entry = malloc(size))) {
+      memset(entry, 0, sizeof(*entry));
+
+      if ((entry->voice = strdup(key->voice? key->voice: ""))) {
+        entry->volume = key->volume;
+        entry->rate = key->rate;
+        entry->pitch = key->pitch;
+        entry->punctuation = key->punctuation;
+
+        entry->count = audio->count;
+        entry->sampleRate = audio->sampleRate;
+        memcpy(entry->samples, audio->samples, audioSize);
+
+        entry->length = key->length;
+        entry->text = (unsigned char *)&entry->samples[entry->count];
+        memcpy(entry->text, key->text, key->length);
+
+        if (enqueueItem(cache->entries, entry)) {
+          cache->currentSize += audioSize;
+          return 1;
+        }
+
+        free(entry->voice);
+      } else {
+        logMallocError();
+      }
+
+      free(entry);
+    } else {
+      logMallocError();
+    }
+  }
+
+  return 0;
+}
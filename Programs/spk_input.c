@@ -19,6 +19,7 @@
 #include "prologue.h"
 
 #include <string.h>
+#include <strings.h>
 
 #include "log.h"
 #include "spk_input.h"
@@ -27,23 +28,262 @@
 #include "core.h"
 
 #ifdef ENABLE_SPEECH_SUPPORT
+/* A line which begins with this character is a command. A line which
+ * begins with two of them is text which begins with one of them. Any
+ * other input is text which is spoken as is.
+ */
+#define SPEECH_INPUT_COMMAND_PREFIX '@'
+
+#define SPEECH_INPUT_PRIORITY_MAXIMUM 9
+
 struct SpeechInputObjectStruct {
   NamedPipeObject *pipe;
+  unsigned char priority;
 };
 
+typedef struct {
+  SpeechInputObject *obj;
+
+  char *text;
+  size_t length;
+
+  unsigned char priority;
+  unsigned char isCommanded:1;
+} SpeechInputBatch;
+
+static void
+flushSpeechInputBatch (SpeechInputBatch *batch) {
+  if (batch->length) {
+    SayOptions options = SAY_OPT_CLASS_INPUT;
+
+    if (batch->isCommanded) {
+      SpeechInputObject *obj = batch->obj;
+
+      /* An utterance supersedes any speech input still being spoken
+       * which was requested with the same or a lower priority.
+       */
+      if (batch->priority >= obj->priority) options |= SAY_OPT_MUTE_FIRST;
+      obj->priority = batch->priority;
+    }
+
+    batch->text[batch->length] = 0;
+    sayString(&spk, batch->text, options);
+    batch->length = 0;
+  }
+}
+
+static void
+addSpeechInputText (SpeechInputBatch *batch, const char *text, size_t length) {
+  if (batch->isCommanded) {
+    flushSpeechInputBatch(batch);
+    batch->isCommanded = 0;
+  }
+
+  memcpy(&batch->text[batch->length], text, length);
+  batch->length += length;
+}
+
+static void
+addSpeechInputUtterance (SpeechInputBatch *batch, unsigned char priority, const char *text, size_t length) {
+  if (!batch->isCommanded) {
+    flushSpeechInputBatch(batch);
+    batch->isCommanded = 1;
+  } else if (batch->length) {
+    if (priority < batch->priority) {
+      logMessage(LOG_CATEGORY(SPEECH_EVENTS),
+                 "speech input superseded: priority %u", priority);
+      return;
+    }
+
+    if (priority > batch->priority) {
+      logMessage(LOG_CATEGORY(SPEECH_EVENTS),
+                 "speech input superseded: priority %u", batch->priority);
+      batch->length = 0;
+    } else {
+      batch->text[batch->length++] = '\n';
+    }
+  }
+
+  batch->priority = priority;
+  memcpy(&batch->text[batch->length], text, length);
+  batch->length += length;
+}
+
+static int
+isSpeechInputSpace (char character) {
+  return (character == ' ') || (character == '\t');
+}
+
+static int
+getSpeechInputWord (const char **next, const char *end, const char **word, size_t *length) {
+  const char *from = *next;
+  while ((from < end) && isSpeechInputSpace(*from)) from += 1;
+
+  const char *to = from;
+  while ((to < end) && !isSpeechInputSpace(*to)) to += 1;
+
+  *word = from;
+  *length = to - from;
+  *next = to;
+  return to > from;
+}
+
+static const char *
+skipSpeechInputSpace (const char *next, const char *end) {
+  while ((next < end) && isSpeechInputSpace(*next)) next += 1;
+  return next;
+}
+
+static int
+isSpeechInputWord (const char *word, size_t length, const char *name) {
+  return (length == strlen(name)) && (strncasecmp(word, name, length) == 0);
+}
+
+static int
+getSpeechInputInteger (const char **next, const char *end, int maximum, int *value) {
+  const char *word;
+  size_t length;
+
+  if (getSpeechInputWord(next, end, &word, &length)) {
+    const char *digit = word;
+    int result = 0;
+
+    while (digit < (word + length)) {
+      if ((*digit < '0') || (*digit > '9')) return 0;
+      result = (result * 10) + (*digit++ - '0');
+      if (result > maximum) return 0;
+    }
+
+    *value = result;
+    return 1;
+  }
+
+  return 0;
+}
+
+static void
+handleSpeechInputCommand (SpeechInputBatch *batch, const char *line, size_t length) {
+  const char *next = line;
+  const char *end = line + length;
+
+  const char *command;
+  size_t size;
+
+  while ((end > next) && ((end[-1] == '\r') || isSpeechInputSpace(end[-1]))) end -= 1;
+  if (!getSpeechInputWord(&next, end, &command, &size)) goto invalid;
+
+  if (isSpeechInputWord(command, size, "say")) {
+    int priority;
+
+    if (!getSpeechInputInteger(&next, end, SPEECH_INPUT_PRIORITY_MAXIMUM, &priority)) goto invalid;
+    next = skipSpeechInputSpace(next, end);
+    addSpeechInputUtterance(batch, priority, next, (end - next));
+    return;
+  }
+
+  if (isSpeechInputWord(command, size, "mute")) {
+    batch->length = 0;
+    batch->obj->priority = 0;
+    muteSpeech(&spk, "speech input");
+    return;
+  }
+
+  if (isSpeechInputWord(command, size, "mark")) {
+    flushSpeechInputBatch(batch);
+    next = skipSpeechInputSpace(next, end);
+
+    logMessage(LOG_CATEGORY(SPEECH_EVENTS),
+               "speech input mark: %.*s", (int)(end - next), next);
+    return;
+  }
+
+  {
+    /* These only change what the synthesizer is currently doing - the
+     * user's preferences aren't touched, so they're never saved.
+     */
+    typedef struct {
+      const char *name;
+      int maximum;
+      int (*set) (SpeechSynthesizer *spk, int setting, int say);
+    } SettingEntry;
+
+    static const SettingEntry settingTable[] = {
+      { .name = "volume",
+        .maximum = SPK_VOLUME_MAXIMUM,
+        .set = setSpeechVolume
+      },
+
+      { .name = "rate",
+        .maximum = SPK_RATE_MAXIMUM,
+        .set = setSpeechRate
+      },
+
+      { .name = "pitch",
+        .maximum = SPK_PITCH_MAXIMUM,
+        .set = setSpeechPitch
+      },
+    };
+
+    const SettingEntry *setting = settingTable;
+    const SettingEntry *settingEnd = setting + ARRAY_COUNT(settingTable);
+
+    while (setting < settingEnd) {
+      if (isSpeechInputWord(command, size, setting->name)) {
+        int value;
+
+        if (!getSpeechInputInteger(&next, end, setting->maximum, &value)) goto invalid;
+        flushSpeechInputBatch(batch);
+        setting->set(&spk, value, 0);
+        return;
+      }
+
+      setting += 1;
+    }
+  }
+
+invalid:
+  logMessage(LOG_WARNING, "invalid speech input command: %.*s", (int)length, line);
+}
+
 static
 NAMED_PIPE_INPUT_CALLBACK(handleSpeechInput) {
-//SpeechInputObject *obj = parameters->data;
+  SpeechInputObject *obj = parameters->data;
 
-  const unsigned char *buffer = parameters->buffer;
+  const char *buffer = (const char *)parameters->buffer;
   size_t length = parameters->length;
-  char string[length + 1];
+  size_t consumed = 0;
+
+  char text[length + 1];
+  SpeechInputBatch batch = {
+    .obj = obj,
+    .text = text,
+    .length = 0
+  };
+
+  while (consumed < length) {
+    const char *line = buffer + consumed;
+    size_t left = length - consumed;
+
+    const char *newline = memchr(line, '\n', left);
+    size_t size = newline? (newline - line): left;
+    size_t next = newline? (size + 1): left;
 
-  memcpy(string, buffer, length);
-  string[length] = 0;
-  sayString(&spk, string, 0);
+    if ((line[0] == SPEECH_INPUT_COMMAND_PREFIX) &&
+        ((left == 1) || (line[1] != SPEECH_INPUT_COMMAND_PREFIX))) {
+      /* Wait for the rest of the command unless the buffer is full. */
+      if (!newline && (length < parameters->size)) break;
+
+      handleSpeechInputCommand(&batch, (line + 1), (size - 1));
+    } else {
+      size_t skip = (line[0] == SPEECH_INPUT_COMMAND_PREFIX)? 1: 0;
+      addSpeechInputText(&batch, (line + skip), (next - skip));
+    }
+
+    consumed += next;
+  }
 
-  return length;
+  flushSpeechInputBatch(&batch);
+  return consumed;
 }
 
 SpeechInputObject *
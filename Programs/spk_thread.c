@@ -31,6 +31,7 @@
 #include "async_event.h"
 #include "thread.h"
 #include "queue.h"
+#include "timing.h"
 
 #ifdef ENABLE_SPEECH_SUPPORT
 typedef enum {
@@ -99,6 +100,25 @@ struct SpeechDriverThreadStruct {
       int INTEGER;
     } value;
   } response;
+
+  SpeechQueueStatistics queueStatistics;
+
+  /* the class of the text most recently sent to the driver */
+  unsigned sayingMessageText:1;
+  unsigned sayingInputText:1;
+
+  /* The chunks which have been sent to the driver but which it hasn't yet
+   * said it's finished speaking. Speech locations are relative to the oldest.
+   */
+  struct {
+    unsigned int first;
+    unsigned int count;
+
+    struct {
+      size_t offset;
+      unsigned final:1;
+    } entries[SPEECH_CHUNK_TRACKING_LIMIT];
+  } chunks;
 };
 
 typedef enum {
@@ -133,6 +153,9 @@ typedef struct {
       size_t count;
       const unsigned char *attributes;
       SayOptions options;
+
+      size_t offset; // of the first character (if a chunk of longer text)
+      unsigned final:1; // the last (or only) chunk
     } sayText;
 
     struct {
@@ -152,6 +175,7 @@ typedef struct {
     } setPunctuation;
   } arguments;
 
+  TimeValue enqueued;
   unsigned char data[0];
 } SpeechRequest;
 
@@ -329,6 +353,49 @@ awaitSpeechResponse (SpeechDriverThread *sdt, int timeout) {
 
 static void sendSpeechRequest (SpeechDriverThread *sdt);
 
+static void
+resetSpeechChunks (SpeechDriverThread *sdt) {
+  sdt->chunks.first = 0;
+  sdt->chunks.count = 0;
+}
+
+static void
+addSpeechChunk (SpeechDriverThread *sdt, const SpeechRequest *req) {
+  unsigned int limit = ARRAY_COUNT(sdt->chunks.entries);
+
+  if (sdt->chunks.count == limit) {
+    /* the driver doesn't say when it's finished - forget the oldest */
+    sdt->chunks.first = (sdt->chunks.first + 1) % limit;
+    sdt->chunks.count -= 1;
+  }
+
+  {
+    unsigned int index = (sdt->chunks.first + sdt->chunks.count++) % limit;
+
+    sdt->chunks.entries[index].offset = req->arguments.sayText.offset;
+    sdt->chunks.entries[index].final = req->arguments.sayText.final;
+  }
+}
+
+static int
+removeSpeechChunk (SpeechDriverThread *sdt) {
+  if (!sdt->chunks.count) return 1;
+
+  {
+    int final = sdt->chunks.entries[sdt->chunks.first].final;
+
+    sdt->chunks.first = (sdt->chunks.first + 1) % ARRAY_COUNT(sdt->chunks.entries);
+    sdt->chunks.count -= 1;
+    return final;
+  }
+}
+
+static size_t
+getSpeechChunkOffset (SpeechDriverThread *sdt) {
+  if (!sdt->chunks.count) return 0;
+  return sdt->chunks.entries[sdt->chunks.first].offset;
+}
+
 static void
 handleSpeechMessage (SpeechDriverThread *sdt, SpeechMessage *msg) {
   logSpeechMessage(msg, "handling");
@@ -344,15 +411,25 @@ handleSpeechMessage (SpeechDriverThread *sdt, SpeechMessage *msg) {
         SpeechSynthesizer *spk = sdt->speechSynthesizer;
         SetSpeechFinishedMethod *setFinished = spk->setFinished;
 
-        if (setFinished) setFinished(spk);
+        if (removeSpeechChunk(sdt)) {
+          if (!sdt->chunks.count) {
+            sdt->sayingMessageText = 0;
+            sdt->sayingInputText = 0;
+          }
+
+          if (setFinished) setFinished(spk);
+        }
+
         break;
       }
 
       case MSG_SPEECH_LOCATION: {
         SpeechSynthesizer *spk = sdt->speechSynthesizer;
         SetSpeechLocationMethod *setLocation = spk->setLocation;
+        int location = msg->arguments.speechLocation.location;
 
-        if (setLocation) setLocation(spk, msg->arguments.speechLocation.location);
+        location += getSpeechChunkOffset(sdt);
+        if (setLocation) setLocation(spk, location);
         break;
       }
 
@@ -589,14 +666,69 @@ muteSpeechRequestQueue (SpeechDriverThread *sdt) {
   removeSpeechRequests(sdt, REQ_MUTE_SPEECH);
 }
 
+static void
+noteSpeechRequestAge (SpeechDriverThread *sdt, const SpeechRequest *req) {
+  long int age = getMonotonicElapsed(&req->enqueued);
+
+  sdt->queueStatistics.requests += 1;
+  sdt->queueStatistics.totalAge += age;
+
+  if (age > sdt->queueStatistics.maximumAge) {
+    sdt->queueStatistics.maximumAge = age;
+  }
+
+  logMessage(LOG_CATEGORY(SPEECH_EVENTS),
+             "speech request queue: depth %d, age %ld",
+             getQueueSize(sdt->requestQueue), age);
+}
+
+static void
+logSpeechQueueStatistics (SpeechDriverThread *sdt) {
+  logMessage(LOG_CATEGORY(SPEECH_EVENTS),
+             "speech request queue statistics: Requests:%u MaxDepth:%u MaxAge:%ld Superseded:%u Merged:%u",
+             sdt->queueStatistics.requests,
+             sdt->queueStatistics.maximumDepth, sdt->queueStatistics.maximumAge,
+             sdt->queueStatistics.superseded, sdt->queueStatistics.merged);
+}
+
+static inline SayOptions
+getSayTextClass (const SpeechRequest *req) {
+  return req->arguments.sayText.options & SAY_OPT_CLASS_MASK;
+}
+
 static void
 sendSpeechRequest (SpeechDriverThread *sdt) {
   while (getQueueSize(sdt->requestQueue) > 0) {
     SpeechRequest *req = dequeueItem(sdt->requestQueue);
 
     logSpeechRequest(req, "sending");
+    if (req) noteSpeechRequestAge(sdt, req);
     setResponsePending(sdt);
 
+    if (req) {
+      switch (req->type) {
+        case REQ_SAY_TEXT: {
+          SayOptions sayClass = getSayTextClass(req);
+
+          if (req->arguments.sayText.options & SAY_OPT_MUTE_FIRST) resetSpeechChunks(sdt);
+          addSpeechChunk(sdt, req);
+
+          sdt->sayingMessageText = sayClass == SAY_OPT_CLASS_MESSAGE;
+          sdt->sayingInputText = sayClass == SAY_OPT_CLASS_INPUT;
+          break;
+        }
+
+        case REQ_MUTE_SPEECH:
+          resetSpeechChunks(sdt);
+          sdt->sayingMessageText = 0;
+          sdt->sayingInputText = 0;
+          break;
+
+        default:
+          break;
+      }
+    }
+
 #ifdef GOT_PTHREADS
     if (!asyncSignalEvent(sdt->requestEvent, req)) {
       if (req) free(req);
@@ -615,8 +747,17 @@ static int
 enqueueSpeechRequest (SpeechDriverThread *sdt, SpeechRequest *req) {
   if (testThreadValidity(sdt)) {
     logSpeechRequest(req, "enqueuing");
+    if (req) getMonotonicTime(&req->enqueued);
 
     if (enqueueItem(sdt->requestQueue, req)) {
+      {
+        unsigned int depth = getQueueSize(sdt->requestQueue);
+
+        if (depth > sdt->queueStatistics.maximumDepth) {
+          sdt->queueStatistics.maximumDepth = depth;
+        }
+      }
+
       if (sdt->response.type != RSP_PENDING) {
         if (getQueueSize(sdt->requestQueue) == 1) {
           sendSpeechRequest(sdt);
@@ -647,34 +788,332 @@ newSpeechRequest (SpeechRequestType type, SpeechDatum *data) {
   return NULL;
 }
 
-int
-speechRequest_sayText (
+typedef struct {
+  SayOptions const sayClass;
+} TestSayTextClassData;
+
+static int
+testSayTextClass (const void *item, void *data) {
+  const SpeechRequest *req = item;
+  const TestSayTextClassData *tsc = data;
+
+  if (!req) return 0;
+  if (req->type != REQ_SAY_TEXT) return 0;
+  return getSayTextClass(req) == tsc->sayClass;
+}
+
+static int
+testSayTextRequest (const void *item, void *data) {
+  const SpeechRequest *req = item;
+  return req && (req->type == REQ_SAY_TEXT);
+}
+
+static void
+supersedeSayTextRequests (SpeechDriverThread *sdt, SayOptions sayClass) {
+  TestSayTextClassData tsc = {
+    .sayClass = sayClass
+  };
+
+  Element *element;
+
+  while ((element = findElement(sdt->requestQueue, testSayTextClass, &tsc))) {
+    deleteElement(element);
+    sdt->queueStatistics.superseded += 1;
+  }
+}
+
+static inline int
+isAutomaticSayClass (SayOptions sayClass) {
+  return (sayClass == SAY_OPT_CLASS_AUTOSPEAK) || (sayClass == SAY_OPT_CLASS_ECHO);
+}
+
+static int
+isSayingMessage (SpeechDriverThread *sdt) {
+  TestSayTextClassData tsc = {
+    .sayClass = SAY_OPT_CLASS_MESSAGE
+  };
+
+  if (sdt->sayingMessageText) return 1;
+  return !!findElement(sdt->requestQueue, testSayTextClass, &tsc);
+}
+
+static Element *
+getMergeableSayTextElement (
+  SpeechDriverThread *sdt,
+  const unsigned char *attributes, SayOptions options
+) {
+  Element *element = getStackHead(sdt->requestQueue);
+  if (!element) return NULL;
+
+  const SpeechRequest *req = getElementItem(element);
+  if (!req) return NULL;
+  if (req->type != REQ_SAY_TEXT) return NULL;
+  if (getSayTextClass(req) != SAY_OPT_CLASS_ECHO) return NULL;
+  if (!req->arguments.sayText.attributes != !attributes) return NULL;
+
+  {
+    SayOptions ignore = SAY_OPT_MUTE_FIRST;
+    if ((req->arguments.sayText.options | ignore) != (options | ignore)) return NULL;
+  }
+
+  return element;
+}
+
+static int
+mergeSayTextRequest (
   SpeechDriverThread *sdt,
   const char *text, size_t length,
   size_t count, const unsigned char *attributes,
   SayOptions options
+) {
+  Element *element = getMergeableSayTextElement(sdt, attributes, options);
+  if (!element) return 0;
+
+  const SpeechRequest *old = getElementItem(element);
+  size_t oldLength = old->arguments.sayText.length;
+  size_t oldCount = old->arguments.sayText.count;
+
+  /* adjacent echoes are separated by a space so that they're still spoken
+   * as individual characters rather than run together into a word
+   */
+  size_t newLength = oldLength + 1 + length;
+  size_t newCount = oldCount + 1 + count;
+
+  char newText[newLength + 1];
+  memcpy(newText, old->arguments.sayText.text, oldLength);
+  newText[oldLength] = ' ';
+  memcpy(&newText[oldLength+1], text, length);
+  newText[newLength] = 0;
+
+  unsigned char newAttributes[newCount];
+  if (attributes) {
+    memcpy(newAttributes, old->arguments.sayText.attributes, oldCount);
+    newAttributes[oldCount] = oldCount? newAttributes[oldCount-1]: 0;
+    memcpy(&newAttributes[oldCount+1], attributes, count);
+  }
+
+  SpeechRequest *req;
+
+  BEGIN_SPEECH_DATA
+    {.address=newText, .size=newLength+1},
+    {.address=(attributes? newAttributes: NULL), .size=newCount},
+  END_SPEECH_DATA
+
+  if (!(req = newSpeechRequest(REQ_SAY_TEXT, data))) return 0;
+  req->arguments.sayText.text = data[0].address;
+  req->arguments.sayText.length = newLength;
+  req->arguments.sayText.count = newCount;
+  req->arguments.sayText.attributes = data[1].address;
+  req->arguments.sayText.options = old->arguments.sayText.options;
+  req->arguments.sayText.offset = old->arguments.sayText.offset;
+  req->arguments.sayText.final = old->arguments.sayText.final;
+  req->enqueued = old->enqueued;
+  logSpeechRequest(req, "merging");
+
+  /* The merged request replaces the old one at the tail of the queue. Since
+   * the old one was still queued, a response must be pending, so it won't be
+   * sent prematurely.
+   */
+  deleteElement(element);
+
+  if (!enqueueItem(sdt->requestQueue, req)) {
+    free(req);
+    return 0;
+  }
+
+  sdt->queueStatistics.merged += 1;
+  return 1;
+}
+
+static SpeechRequest *
+newSayTextRequest (
+  const char *text, size_t length,
+  size_t count, const unsigned char *attributes,
+  SayOptions options
 ) {
   SpeechRequest *req;
 
+  /* the text might be a chunk so its terminator is set explicitly */
   BEGIN_SPEECH_DATA
     {.address=text, .size=length+1},
     {.address=attributes, .size=count},
   END_SPEECH_DATA
 
   if ((req = newSpeechRequest(REQ_SAY_TEXT, data))) {
+    ((unsigned char *)data[0].address)[length] = 0;
+
     req->arguments.sayText.text = data[0].address;
     req->arguments.sayText.length = length;
     req->arguments.sayText.count = count;
     req->arguments.sayText.attributes = data[1].address;
     req->arguments.sayText.options = options;
+    req->arguments.sayText.offset = 0;
+    req->arguments.sayText.final = 1;
+  }
 
-    if (options & SAY_OPT_MUTE_FIRST) muteSpeechRequestQueue(sdt);
-    if (enqueueSpeechRequest(sdt, req)) return 1;
+  return req;
+}
 
-    free(req);
+static inline int
+isUtf8Continuation (unsigned char byte) {
+  return (byte & 0XC0) == 0X80;
+}
+
+static size_t
+countChunkCharacters (const char *text, size_t length) {
+  size_t count = 0;
+
+  for (size_t index=0; index<length; index+=1) {
+    if (!isUtf8Continuation(text[index])) count += 1;
   }
 
-  return 0;
+  return count;
+}
+
+static size_t
+findChunkLength (const char *text, size_t length, size_t limit) {
+  if (length <= limit) return length;
+
+  {
+    size_t sentence = 0;
+    size_t clause = 0;
+    size_t word = 0;
+
+    for (size_t index=1; index<=limit; index+=1) {
+      if (text[index] != ' ') continue;
+
+      switch (text[index-1]) {
+        case '.':
+        case '!':
+        case '?':
+          sentence = index + 1;
+          break;
+
+        case ',':
+        case ';':
+        case ':':
+          clause = index + 1;
+          break;
+
+        default:
+          word = index + 1;
+          break;
+      }
+    }
+
+    if (sentence) return sentence;
+    if (clause) return clause;
+    if (word) return word;
+  }
+
+  while (limit > 1) {
+    if (!isUtf8Continuation(text[limit])) break;
+    limit -= 1;
+  }
+
+  return limit;
+}
+
+static int
+enqueueSayTextChunks (
+  SpeechDriverThread *sdt,
+  const char *text, size_t length,
+  size_t count, const unsigned char *attributes,
+  SayOptions options
+) {
+  size_t offset = 0;
+  size_t limit = SPEECH_CHUNK_FIRST_SIZE;
+  unsigned int chunks = 0;
+
+  while (length) {
+    size_t chunkLength = findChunkLength(text, length, limit);
+    int final = chunkLength == length;
+    size_t chunkCount = final? count: countChunkCharacters(text, chunkLength);
+    SpeechRequest *req;
+
+    if (!(req = newSayTextRequest(text, chunkLength, chunkCount, attributes, options))) break;
+    req->arguments.sayText.offset = offset;
+    req->arguments.sayText.final = final;
+
+    if (!enqueueSpeechRequest(sdt, req)) {
+      free(req);
+      break;
+    }
+
+    chunks += 1;
+    if (final) {
+      if (chunks > 1) {
+        logMessage(LOG_CATEGORY(SPEECH_EVENTS), "text chunks: %u", chunks);
+      }
+
+      return 1;
+    }
+
+    /* only the first chunk interrupts - the rest follow it */
+    options &= ~SAY_OPT_MUTE_FIRST;
+    limit = SPEECH_CHUNK_SIZE;
+
+    text += chunkLength;
+    length -= chunkLength;
+    if (attributes) attributes += chunkCount;
+    count -= chunkCount;
+    offset += chunkCount;
+  }
+
+  return chunks > 0;
+}
+
+int
+speechRequest_sayText (
+  SpeechDriverThread *sdt,
+  const char *text, size_t length,
+  size_t count, const unsigned char *attributes,
+  SayOptions options
+) {
+  SayOptions sayClass = options & SAY_OPT_CLASS_MASK;
+
+  if (!testThreadValidity(sdt)) return 0;
+
+  if (sayClass == SAY_OPT_CLASS_ECHO) {
+    /* A character echo doesn't interrupt a still queued one - it's merged
+     * into it so that fast typing doesn't lose any of the echoed characters.
+     */
+    if (mergeSayTextRequest(sdt, text, length, count, attributes, options)) {
+      return 1;
+    }
+  }
+
+  if (options & SAY_OPT_MUTE_FIRST) {
+    if (isAutomaticSayClass(sayClass) && isSayingMessage(sdt)) {
+      /* Automatic speech mustn't cut a message short, so it follows the
+       * message instead, although it still replaces older automatic speech.
+       */
+      supersedeSayTextRequests(sdt, SAY_OPT_CLASS_AUTOSPEAK);
+      supersedeSayTextRequests(sdt, SAY_OPT_CLASS_ECHO);
+      options &= ~SAY_OPT_MUTE_FIRST;
+    } else if (sayClass == SAY_OPT_CLASS_INPUT) {
+      /* Speech input only supersedes earlier speech input (its priority has
+       * already been checked). It only interrupts speech input which is
+       * still being spoken, and otherwise waits its turn.
+       */
+      supersedeSayTextRequests(sdt, sayClass);
+
+      if (!sdt->sayingInputText ||
+          findElement(sdt->requestQueue, testSayTextRequest, NULL)) {
+        options &= ~SAY_OPT_MUTE_FIRST;
+      }
+    } else {
+      muteSpeechRequestQueue(sdt);
+    }
+  } else if (sayClass == SAY_OPT_CLASS_AUTOSPEAK) {
+    /* a newer autospeak request makes any older queued ones stale */
+    supersedeSayTextRequests(sdt, sayClass);
+  }
+
+  /* Long text is split into chunks (at sentence, clause, or word boundaries)
+   * so that the driver can start speaking the first one sooner.
+   */
+  return enqueueSayTextChunks(sdt, text, length, count, attributes, options);
 }
 
 int
@@ -693,6 +1132,29 @@ speechRequest_muteSpeech (
   return 0;
 }
 
+ASYNC_CONDITION_TESTER(testSpeechRequestsHandled) {
+  SpeechDriverThread *sdt = data;
+
+  if (sdt->response.type == RSP_PENDING) return 0;
+  return getQueueSize(sdt->requestQueue) == 0;
+}
+
+int
+awaitSpeechRequests (
+  SpeechDriverThread *sdt,
+  int timeout
+) {
+  return asyncAwaitCondition(timeout, testSpeechRequestsHandled, sdt);
+}
+
+void
+getSpeechQueueStatistics (
+  SpeechDriverThread *sdt,
+  SpeechQueueStatistics *statistics
+) {
+  *statistics = sdt->queueStatistics;
+}
+
 int
 speechRequest_drainSpeech (
   SpeechDriverThread *sdt
@@ -937,6 +1399,7 @@ void
 destroySpeechDriverThread (SpeechSynthesizer *spk) {
   SpeechDriverThread *sdt = spk->driver.thread;
 
+  logSpeechQueueStatistics(sdt);
   deleteElements(sdt->requestQueue);
 
 #ifdef GOT_PTHREADS
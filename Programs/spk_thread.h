@@ -50,6 +50,16 @@ extern int speechRequest_drainSpeech (
   SpeechDriverThread *sdt
 );
 
+extern int awaitSpeechRequests (
+  SpeechDriverThread *sdt,
+  int timeout
+);
+
+extern void getSpeechQueueStatistics (
+  SpeechDriverThread *sdt,
+  SpeechQueueStatistics *statistics
+);
+
 extern int speechRequest_setVolume (
   SpeechDriverThread *sdt,
   unsigned char setting
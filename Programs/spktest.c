@@ -33,8 +33,10 @@
 #include "file.h"
 #include "parse.h"
 #include "async_wait.h"
+#include "timing.h"
 
 static char *opt_textString;
+static char *opt_benchmarkIterations;
 static char *opt_speechVolume;
 static char *opt_speechRate;
 static char *opt_pcmDevice;
@@ -58,6 +60,13 @@ BEGIN_OPTION_TABLE(programOptions)
     .description = "Text to be spoken."
   },
 
+  { .word = "benchmark",
+    .letter = 'b',
+    .argument = "iterations",
+    .setting.string = &opt_benchmarkIterations,
+    .description = "Measure latencies and throughput rather than just speaking."
+  },
+
   { .word = "volume",
     .letter = 'v',
     .argument = "loudness",
@@ -95,6 +104,141 @@ sayLine (const LineHandlerParameters *parameters) {
   return 1;
 }
 
+#define BENCHMARK_TIMEOUT 5000
+#define BENCHMARK_DEFAULT_TEXT "The quick brown fox jumps over the lazy dog."
+#define BENCHMARK_SETTINGS_PER_ITERATION 10
+
+typedef struct {
+  unsigned int count;
+  long int total;
+  long int minimum;
+  long int maximum;
+} BenchmarkMeasurement;
+
+static void
+addBenchmarkMeasurement (BenchmarkMeasurement *measurement, long int time) {
+  if (!measurement->count || (time < measurement->minimum)) measurement->minimum = time;
+  if (!measurement->count || (time > measurement->maximum)) measurement->maximum = time;
+
+  measurement->total += time;
+  measurement->count += 1;
+}
+
+static void
+showBenchmarkMeasurement (const char *name, const BenchmarkMeasurement *measurement) {
+  printf("%s: ", name);
+
+  if (measurement->count) {
+    printf("avg %ldms, min %ldms, max %ldms (%u)",
+           (measurement->total / measurement->count),
+           measurement->minimum, measurement->maximum,
+           measurement->count);
+  } else {
+    printf("not reported by the driver");
+  }
+
+  printf("\n");
+}
+
+static unsigned char speechLocationReported;
+
+static void
+setBenchmarkSpeechLocation (SpeechSynthesizer *spk, int location) {
+  speechLocationReported = 1;
+}
+
+ASYNC_CONDITION_TESTER(testSpeechLocationReported) {
+  return speechLocationReported;
+}
+
+static int
+benchmark (SpeechSynthesizer *spk, const char *text, int iterations) {
+  BenchmarkMeasurement handled = {.count = 0};
+  BenchmarkMeasurement firstAudio = {.count = 0};
+  BenchmarkMeasurement mute = {.count = 0};
+  int awaitLocation = 1;
+
+  /* drivers only report locations while speech is being tracked */
+  spk->track.isActive = 1;
+  spk->setLocation = setBenchmarkSpeechLocation;
+
+  for (int iteration=0; iteration<iterations; iteration+=1) {
+    TimeValue start;
+
+    /* The first reported location is the nearest thing to
+     * the start of the audio that a driver tells us about.
+     */
+    speechLocationReported = 0;
+    getMonotonicTime(&start);
+    if (!sayString(spk, text, SAY_OPT_MUTE_FIRST)) return 0;
+
+    if (awaitSpeech(spk, BENCHMARK_TIMEOUT)) {
+      addBenchmarkMeasurement(&handled, getMonotonicElapsed(&start));
+    }
+
+    if (awaitLocation) {
+      if (asyncAwaitCondition(BENCHMARK_TIMEOUT, testSpeechLocationReported, NULL)) {
+        addBenchmarkMeasurement(&firstAudio, getMonotonicElapsed(&start));
+      } else {
+        /* don't wait for what the driver never reports */
+        awaitLocation = 0;
+      }
+    }
+
+    getMonotonicTime(&start);
+    if (!muteSpeech(spk, "benchmark")) return 0;
+
+    if (awaitSpeech(spk, BENCHMARK_TIMEOUT)) {
+      addBenchmarkMeasurement(&mute, getMonotonicElapsed(&start));
+    }
+  }
+
+  spk->setLocation = NULL;
+  spk->track.isActive = 0;
+
+  printf("speech driver: %s [%s]\n", speech->definition.code, speech->definition.name);
+  showBenchmarkMeasurement("say handled", &handled);
+  showBenchmarkMeasurement("first audio", &firstAudio);
+  showBenchmarkMeasurement("mute", &mute);
+
+  printf("settings: ");
+
+  if (canSetSpeechRate(spk)) {
+    int count = iterations * BENCHMARK_SETTINGS_PER_ITERATION;
+    TimeValue start;
+    long int elapsed;
+
+    getMonotonicTime(&start);
+
+    for (int index=0; index<count; index+=1) {
+      setSpeechRate(spk, (SPK_RATE_DEFAULT + (index & 1)), 0);
+    }
+
+    awaitSpeech(spk, BENCHMARK_TIMEOUT);
+    elapsed = getMonotonicElapsed(&start);
+    setSpeechRate(spk, SPK_RATE_DEFAULT, 0);
+
+    printf("%d rate changes in %ldms", count, elapsed);
+    if (elapsed) printf(" (%ld/s)", ((count * 1000L) / elapsed));
+  } else {
+    printf("rate can't be set");
+  }
+
+  printf("\n");
+
+  {
+    SpeechQueueStatistics statistics;
+
+    getSpeechStatistics(spk, &statistics);
+    printf("request queue: %u requests, avg age %ldms, max age %ldms, max depth %u\n",
+           statistics.requests,
+           (statistics.requests? (statistics.totalAge / statistics.requests): 0),
+           statistics.maximumAge, statistics.maximumDepth);
+  }
+
+  return 1;
+}
+
 int
 main (int argc, char *argv[]) {
   ProgramExitStatus exitStatus;
@@ -106,6 +250,7 @@ main (int argc, char *argv[]) {
 
   int speechVolume = SPK_VOLUME_DEFAULT;
   int speechRate = SPK_RATE_DEFAULT;
+  int benchmarkIterations = 0;
 
   {
     static const OptionsDescriptor descriptor = {
@@ -137,6 +282,15 @@ main (int argc, char *argv[]) {
     }
   }
 
+  if (opt_benchmarkIterations && *opt_benchmarkIterations) {
+    static const int minimum = 1;
+
+    if (!validateInteger(&benchmarkIterations, opt_benchmarkIterations, &minimum, NULL)) {
+      logMessage(LOG_ERR, "%s: %s", "invalid benchmark iteration count", opt_benchmarkIterations);
+      return PROG_EXIT_SYNTAX;
+    }
+  }
+
   if (argc) {
     driver = *argv++, --argc;
   }
@@ -206,7 +360,16 @@ main (int argc, char *argv[]) {
       setSpeechVolume(&spk, speechVolume, 0);
       setSpeechRate(&spk, speechRate, 0);
 
-      if (opt_textString && *opt_textString) {
+      exitStatus = PROG_EXIT_SUCCESS;
+
+      if (benchmarkIterations) {
+        const char *text = (opt_textString && *opt_textString)? opt_textString: BENCHMARK_DEFAULT_TEXT;
+
+        if (!benchmark(&spk, text, benchmarkIterations)) {
+          logMessage(LOG_ERR, "speech driver benchmark failed");
+          exitStatus = PROG_EXIT_FATAL;
+        }
+      } else if (opt_textString && *opt_textString) {
         say(&spk, opt_textString);
       } else {
         processLines(stdin, sayLine, (void *)&spk);
@@ -214,7 +377,6 @@ main (int argc, char *argv[]) {
 
       drainSpeech(&spk);
       stopSpeechDriverThread(&spk);
-      exitStatus = PROG_EXIT_SUCCESS;
     } else {
       logMessage(LOG_ERR, "can't initialize speech driver");
       exitStatus = PROG_EXIT_FATAL;
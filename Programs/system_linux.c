@@ -28,6 +28,8 @@
 #include <dirent.h>
 #include <sys/sysmacros.h>
 #include <linux/major.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
 
 #include "log.h"
 #include "parse.h"
@@ -38,6 +40,7 @@
 #include "async_io.h"
 #include "hostcmd.h"
 #include "bitmask.h"
+#include "queue.h"
 #include "system.h"
 #include "system_linux.h"
 
@@ -1439,6 +1442,182 @@ destroyInputEventMonitor (InputEventMonitor *monitor) {
   free(monitor);
 }
 
+/* All kobject uevent monitors share one netlink socket. It's opened when
+ * the first monitor is created and closed when the last one is destroyed.
+ */
+struct KobjectUeventMonitorStruct {
+  KobjectUeventHandler *handleUevent;
+  void *data;
+};
+
+static Queue *kobjectUeventMonitors = NULL;
+static int kobjectUeventSocket = -1;
+static AsyncHandle kobjectUeventHandle = NULL;
+
+const char *
+getKobjectUeventProperty (const KobjectUevent *event, const char *name) {
+  size_t length = strlen(name);
+  const char *property = event->properties;
+  const char *end = property + event->size;
+
+  while (property < end) {
+    const char *next = memchr(property, 0, end-property);
+    if (!next) break;
+
+    if ((strncmp(property, name, length) == 0) && (property[length] == '=')) {
+      return property + length + 1;
+    }
+
+    property = next + 1;
+  }
+
+  return NULL;
+}
+
+typedef struct {
+  const KobjectUevent *event;
+} KobjectUeventDispatchData;
+
+static int
+dispatchKobjectUevent (void *item, void *data) {
+  KobjectUeventMonitor *monitor = item;
+  const KobjectUeventDispatchData *kud = data;
+
+  monitor->handleUevent(kud->event, monitor->data);
+  return 0;
+}
+
+#ifdef NETLINK_KOBJECT_UEVENT
+ASYNC_INPUT_CALLBACK(handleKobjectUevent) {
+  static const char label[] = "kobject uevent";
+
+  if (parameters->error) {
+    logMessage(LOG_DEBUG, "%s read error: %s", label, strerror(parameters->error));
+  } else if (parameters->end) {
+    logMessage(LOG_DEBUG, "%s end-of-file", label);
+  } else {
+    /* Each read returns one datagram: an action@path header followed by
+     * the event's NAME=value properties, each terminated by a NUL.
+     */
+    const char *header = parameters->buffer;
+    const char *end = memchr(header, 0, parameters->length);
+
+    if (end) {
+      const char *delimiter = strchr(header, '@');
+
+      if (delimiter) {
+        size_t actionLength = delimiter - header;
+        char action[actionLength + 1];
+
+        memcpy(action, header, actionLength);
+        action[actionLength] = 0;
+
+        {
+          const KobjectUevent event = {
+            .action = action,
+            .path = delimiter + 1,
+            .properties = end + 1,
+            .size = parameters->length - (end + 1 - header)
+          };
+
+          KobjectUeventDispatchData kud = {
+            .event = &event
+          };
+
+          logMessage(LOG_DEBUG, "%s: %s %s", label, event.action, event.path);
+          processQueue(kobjectUeventMonitors, dispatchKobjectUevent, &kud);
+        }
+      } else {
+        logMessage(LOG_DEBUG, "unrecognized %s: %s", label, header);
+      }
+    }
+
+    return parameters->length;
+  }
+
+  return 0;
+}
+
+static int
+openKobjectUeventSocket (void) {
+  const struct sockaddr_nl socketAddress = {
+    .nl_family = AF_NETLINK,
+    .nl_pid = 0,
+    .nl_groups = 1
+  };
+
+  if ((kobjectUeventSocket = socket(PF_NETLINK, (SOCK_DGRAM | SOCK_CLOEXEC), NETLINK_KOBJECT_UEVENT)) != -1) {
+    if (bind(kobjectUeventSocket, (const struct sockaddr *)&socketAddress, sizeof(socketAddress)) != -1) {
+      if (asyncReadSocket(&kobjectUeventHandle, kobjectUeventSocket,
+                          0X1000, handleKobjectUevent, NULL)) {
+        logMessage(LOG_DEBUG,
+          "netlink kobject uevent socket opened: fd=%d", kobjectUeventSocket
+        );
+
+        return 1;
+      }
+    } else {
+      logSystemError("netlink kobject uevent socket bind");
+    }
+
+    close(kobjectUeventSocket);
+    kobjectUeventSocket = -1;
+  } else {
+    logSystemError("netlink kobject uevent socket creation");
+  }
+
+  return 0;
+}
+#endif /* NETLINK_KOBJECT_UEVENT */
+
+static void
+closeKobjectUeventSocket (void) {
+  if (kobjectUeventHandle) {
+    asyncCancelRequest(kobjectUeventHandle);
+    kobjectUeventHandle = NULL;
+  }
+
+  if (kobjectUeventSocket != -1) {
+    close(kobjectUeventSocket);
+    kobjectUeventSocket = -1;
+  }
+}
+
+KobjectUeventMonitor *
+newKobjectUeventMonitor (KobjectUeventHandler *handleUevent, void *data) {
+#ifdef NETLINK_KOBJECT_UEVENT
+  KobjectUeventMonitor *monitor;
+
+  if ((monitor = malloc(sizeof(*monitor)))) {
+    memset(monitor, 0, sizeof(*monitor));
+    monitor->handleUevent = handleUevent;
+    monitor->data = data;
+
+    if (kobjectUeventMonitors || (kobjectUeventMonitors = newQueue(NULL, NULL))) {
+      if ((kobjectUeventSocket != -1) || openKobjectUeventSocket()) {
+        if (enqueueItem(kobjectUeventMonitors, monitor)) return monitor;
+        if (!getQueueSize(kobjectUeventMonitors)) closeKobjectUeventSocket();
+      }
+    }
+
+    free(monitor);
+  } else {
+    logMallocError();
+  }
+#else /* NETLINK_KOBJECT_UEVENT */
+  logUnsupportedFunction();
+#endif /* NETLINK_KOBJECT_UEVENT */
+
+  return NULL;
+}
+
+void
+destroyKobjectUeventMonitor (KobjectUeventMonitor *monitor) {
+  deleteItem(kobjectUeventMonitors, monitor);
+  if (!getQueueSize(kobjectUeventMonitors)) closeKobjectUeventSocket();
+  free(monitor);
+}
+
 void
 initializeSystemObject (void) {
 }
@@ -332,6 +332,15 @@ getMonotonicElapsed (const TimeValue *start) {
   return millisecondsBetween(start, &now);
 }
 
+long int
+getMonotonicElapsedMicroseconds (const TimeValue *start) {
+  TimeValue now;
+  getMonotonicTime(&now);
+
+  return ((long int)(now.seconds - start->seconds) * 1000000)
+       + ((now.nanoseconds - start->nanoseconds) / 1000);
+}
+
 void
 restartTimePeriod (TimePeriod *period) {
   getMonotonicTime(&period->start);
@@ -23,6 +23,7 @@
 #include "log.h"
 #include "parameters.h"
 #include "thread.h"
+#include "timing.h"
 #include "async_handle.h"
 #include "async_alarm.h"
 #include "async_event.h"
@@ -66,18 +67,28 @@ ASYNC_ALARM_CALLBACK(handleTuneDeviceCloseTimeout) {
   closeTuneDevice();
 }
 
+static int
+isPersistentTuneDevice (void) {
+  if (!noteMethods) return 0;
+  if (!noteMethods->isPersistent) return 0;
+  return noteMethods->isPersistent();
+}
+
 static int
 openTuneDevice (void) {
   const int timeout = TUNE_DEVICE_CLOSE_DELAY;
 
   if (noteDevice) {
-    asyncResetAlarmIn(tuneDeviceCloseTimer, timeout);
+    if (tuneDeviceCloseTimer) asyncResetAlarmIn(tuneDeviceCloseTimer, timeout);
     return 1;
   }
 
   if (noteMethods) {
     if ((noteDevice = noteMethods->construct(openErrorLevel)) != NULL) {
-      asyncNewRelativeAlarm(&tuneDeviceCloseTimer, timeout, handleTuneDeviceCloseTimeout, NULL);
+      if (!isPersistentTuneDevice()) {
+        asyncNewRelativeAlarm(&tuneDeviceCloseTimer, timeout, handleTuneDeviceCloseTimeout, NULL);
+      }
+
       return 1;
     }
   }
@@ -100,6 +111,7 @@ typedef enum {
 
 typedef struct {
   TuneRequestType type;
+  TimeValue requested;
 
   union {
     struct {
@@ -124,11 +136,54 @@ typedef struct {
   } parameters;
 } TuneRequest;
 
+/* This is the time from a tune being requested until it's heard - queueing,
+ * opening the device, and then waiting for whatever output the device already
+ * has queued ahead of it (when the device can say how much that is).
+ */
+static struct {
+  unsigned int count;
+  long int total;
+  long int maximum;
+} tuneLatency;
+
+static int
+getTuneDeviceDelay (void) {
+  if (!noteDevice) return -1;
+  if (!noteMethods->getDelay) return -1;
+  return noteMethods->getDelay(noteDevice);
+}
+
+static void
+noteTuneLatency (const TuneRequest *req) {
+  long int latency = getMonotonicElapsed(&req->requested);
+  int delay = getTuneDeviceDelay();
+  if (delay > 0) latency += delay;
+
+  tuneLatency.count += 1;
+  tuneLatency.total += latency;
+  if (latency > tuneLatency.maximum) tuneLatency.maximum = latency;
+
+  logMessage(LOG_DEBUG, "tune latency: %ld (output delay: %d)", latency, delay);
+}
+
+static void
+logTuneLatency (void) {
+  if (tuneLatency.count) {
+    logMessage(LOG_DEBUG,
+               "tune latency statistics: Count:%u Average:%ld Maximum:%ld",
+               tuneLatency.count, (tuneLatency.total / tuneLatency.count),
+               tuneLatency.maximum);
+  }
+}
+
 static void
 handleTuneRequest_setDevice (const NoteMethods *methods) {
   if (methods != noteMethods) {
     closeTuneDevice();
     noteMethods = methods;
+
+    /* open it now so that the first tune doesn't have to wait for it */
+    if (isPersistentTuneDevice()) openTuneDevice();
   }
 }
 
@@ -145,6 +200,11 @@ handleTuneRequest_playNotes (const NoteElement *tune) {
 
 static void
 handleTuneRequest_playTones (const ToneElement *tune) {
+  if (noteMethods && noteMethods->tones) {
+    if (openTuneDevice()) noteMethods->tones(noteDevice, tune);
+    return;
+  }
+
   while (tune->duration) {
     if (!openTuneDevice()) return;
     if (!noteMethods->tone(noteDevice, tune->duration, tune->frequency)) return;
@@ -176,6 +236,7 @@ handleTuneRequest (TuneRequest *req) {
         const NoteElement *tune = req->parameters.playNotes.tune;
 
         currentlyPlayingNotes = tune;
+        if (tune->duration && openTuneDevice()) noteTuneLatency(req);
         handleTuneRequest_playNotes(tune);
         currentlyPlayingNotes = NULL;
 
@@ -186,6 +247,7 @@ handleTuneRequest (TuneRequest *req) {
         const ToneElement *tune = req->parameters.playTones.tune;
 
         currentlyPlayingTones = tune;
+        if (tune->duration && openTuneDevice()) noteTuneLatency(req);
         handleTuneRequest_playTones(tune);
         currentlyPlayingTones = NULL;
 
@@ -203,6 +265,7 @@ handleTuneRequest (TuneRequest *req) {
 
     free(req);
   } else {
+    logTuneLatency();
     closeTuneDevice();
   }
 }
@@ -413,6 +476,7 @@ newTuneRequest (TuneRequestType type) {
   if ((req = malloc(sizeof(*req)))) {
     memset(req, 0, sizeof(*req));
     req->type = type;
+    getMonotonicTime(&req->requested);
     return req;
   } else {
     logMallocError();
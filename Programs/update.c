@@ -34,6 +34,7 @@
 #include "charset.h"
 #include "ttb.h"
 #include "atb.h"
+#include "brl_utils.h"
 #include "brl_dots.h"
 #include "spk.h"
 #include "scr.h"
@@ -518,6 +519,7 @@ autospeak (AutospeakMode mode) {
     int column = 0;
     int count = newWidth;
     const char *reason = NULL;
+    SayOptions sayClass = SAY_OPT_CLASS_AUTOSPEAK;
     int indent = 0;
 
     if (mode == AUTOSPEAK_FORCE) {
@@ -570,6 +572,7 @@ autospeak (AutospeakMode mode) {
                   column = newX;
                   count = prefs.autospeakInsertedCharacters? (x - newX): 0;
                   reason = "characters inserted after cursor";
+                  sayClass = SAY_OPT_CLASS_ECHO;
                   goto autospeak;
                 }
 
@@ -582,6 +585,7 @@ autospeak (AutospeakMode mode) {
                   column = oldX;
                   count = prefs.autospeakDeletedCharacters? (x - oldX): 0;
                   reason = "characters deleted after cursor";
+                  sayClass = SAY_OPT_CLASS_ECHO;
                   goto autospeak;
                 }
 
@@ -623,6 +627,7 @@ autospeak (AutospeakMode mode) {
                     column = first;
                     count = last - first + 1;
                     reason = "word inserted";
+                    sayClass = SAY_OPT_CLASS_ECHO;
                     goto autospeak;
                   }
                 }
@@ -631,6 +636,7 @@ autospeak (AutospeakMode mode) {
 
             if (!prefs.autospeakInsertedCharacters) count = 0;
             reason = "characters inserted before cursor";
+            sayClass = SAY_OPT_CLASS_ECHO;
             goto autospeak;
           }
 
@@ -642,6 +648,7 @@ autospeak (AutospeakMode mode) {
             column = newX;
             count = prefs.autospeakDeletedCharacters? (oldX - newX): 0;
             reason = "characters deleted before cursor";
+            sayClass = SAY_OPT_CLASS_ECHO;
             goto autospeak;
           }
         }
@@ -655,6 +662,7 @@ autospeak (AutospeakMode mode) {
         column = newX;
         count = prefs.autospeakSelectedCharacter? 1: 0;
         reason = "character selected";
+        sayClass = SAY_OPT_CLASS_ECHO;
 
         if (prefs.autospeakCompletedWords) {
           if ((newX > oldX) && (column >= 2)) {
@@ -695,11 +703,11 @@ autospeak (AutospeakMode mode) {
     if (mode == AUTOSPEAK_SILENT) count = 0;
 
     characters += column;
-    int interrupt = 1;
+    SayOptions sayOptions = sayClass | SAY_OPT_MUTE_FIRST;
 
     if (indent) {
-      if (speakIndent(characters, count, 0)) {
-        interrupt = 0;
+      if (speakIndent(characters, count, 0, SAY_OPT_CLASS_AUTOSPEAK)) {
+        sayOptions &= ~SAY_OPT_MUTE_FIRST;
       }
     }
 
@@ -710,7 +718,7 @@ autospeak (AutospeakMode mode) {
                  "autospeak: %s: [%d,%d] %d.%d",
                  reason, ses->winx, ses->winy, column, count);
 
-      speakCharacters(characters, count, 0, interrupt);
+      speakCharacters(characters, count, 0, sayOptions);
     }
   }
 
@@ -1177,7 +1185,16 @@ doUpdate (void) {
         fillStatusSeparator(textBuffer, brl.buffer);
       }
 
-      if (!(writeStatusCells() && writeBrailleWindow(&brl, textBuffer, scr.quality))) brl.hasFailed = 1;
+      {
+        int ok;
+
+        /* let the driver's packets for this update go out in one write */
+        beginBrailleOutput(&brl);
+        ok = writeStatusCells() && writeBrailleWindow(&brl, textBuffer, scr.quality);
+        if (!endBrailleOutput(&brl)) ok = 0;
+
+        if (!ok) brl.hasFailed = 1;
+      }
     }
 
     api.releaseDriver();
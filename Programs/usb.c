@@ -612,21 +612,167 @@ usbCancelInputMonitor (UsbEndpoint *endpoint) {
   }
 }
 
+static inline int
+usbHaveInputRing (UsbEndpoint *endpoint) {
+  return !!endpoint->direction.input.ring.buffer;
+}
+
 static inline int
 usbHaveInputPipe (UsbEndpoint *endpoint) {
   return endpoint->direction.input.pipe.output != INVALID_FILE_DESCRIPTOR;
 }
 
+static inline int
+usbHaveInputQueue (UsbEndpoint *endpoint) {
+  return usbHaveInputRing(endpoint) || usbHaveInputPipe(endpoint);
+}
+
 static inline int
 usbHaveInputError (UsbEndpoint *endpoint) {
+  if (usbHaveInputRing(endpoint)) return endpoint->direction.input.ring.broken;
   return endpoint->direction.input.pipe.input == INVALID_FILE_DESCRIPTOR;
 }
 
+static inline int *
+usbGetInputErrorCode (UsbEndpoint *endpoint) {
+  if (usbHaveInputRing(endpoint)) return &endpoint->direction.input.ring.error;
+  return &endpoint->direction.input.pipe.error;
+}
+
+static inline size_t
+usbGetInputRingCount (UsbEndpoint *endpoint) {
+  return endpoint->direction.input.ring.head - endpoint->direction.input.ring.tail;
+}
+
+static void
+usbRingInputDoorbell (UsbEndpoint *endpoint) {
+  uint64_t value = 1;
+
+  if (writeFileDescriptor(endpoint->direction.input.ring.doorbell, &value, sizeof(value)) == -1) {
+    if (errno != EAGAIN) logSystemError("USB input doorbell write");
+  }
+}
+
+static void
+usbResetInputDoorbell (UsbEndpoint *endpoint) {
+  uint64_t value;
+
+  while (readFileDescriptor(endpoint->direction.input.ring.doorbell, &value, sizeof(value)) > 0);
+  __sync_synchronize();
+
+  /* the producer may have added data after the ring was found to be empty */
+  if (usbGetInputRingCount(endpoint) || endpoint->direction.input.ring.broken) {
+    usbRingInputDoorbell(endpoint);
+  }
+}
+
+static int
+usbEnqueueInputRing (UsbEndpoint *endpoint, const void *buffer, size_t length) {
+  UsbInputRing *ring = &endpoint->direction.input.ring;
+  size_t head = ring->head;
+  int wasEmpty = head == ring->tail;
+
+  if (length > (ring->size - (head - ring->tail))) {
+    logMessage(LOG_WARNING,
+      "USB input ring full: Ept:%02X Len:%"PRIsize,
+      endpoint->descriptor->bEndpointAddress, length
+    );
+
+    return 1;
+  }
+
+  {
+    const unsigned char *bytes = buffer;
+
+    while (length > 0) {
+      size_t offset = head & (ring->size - 1);
+      size_t count = MIN(length, (ring->size - offset));
+
+      memcpy(&ring->buffer[offset], bytes, count);
+      bytes += count;
+      length -= count;
+      head += count;
+    }
+  }
+
+  __sync_synchronize();
+  ring->head = head;
+
+  if (wasEmpty) usbRingInputDoorbell(endpoint);
+  return 1;
+}
+
+static size_t
+usbDequeueInputRing (UsbEndpoint *endpoint, void *buffer, size_t length) {
+  UsbInputRing *ring = &endpoint->direction.input.ring;
+  size_t tail = ring->tail;
+  size_t count = ring->head - tail;
+
+  __sync_synchronize();
+  if (count > length) count = length;
+
+  {
+    unsigned char *bytes = buffer;
+    size_t left = count;
+
+    while (left > 0) {
+      size_t offset = tail & (ring->size - 1);
+      size_t amount = MIN(left, (ring->size - offset));
+
+      memcpy(bytes, &ring->buffer[offset], amount);
+      bytes += amount;
+      left -= amount;
+      tail += amount;
+    }
+  }
+
+  __sync_synchronize();
+  ring->tail = tail;
+
+  if (ring->head == tail) usbResetInputDoorbell(endpoint);
+  return count;
+}
+
+static ssize_t
+usbReadInputRing (
+  UsbEndpoint *endpoint,
+  void *buffer, size_t length,
+  int initialTimeout, int subsequentTimeout
+) {
+  unsigned char *bytes = buffer;
+  size_t count = 0;
+
+  while (count < length) {
+    size_t amount = usbDequeueInputRing(endpoint, &bytes[count], (length - count));
+
+    if (amount) {
+      count += amount;
+    } else {
+      int timeout = count? subsequentTimeout: initialTimeout;
+
+      if (!timeout || usbHaveInputError(endpoint)) {
+        errno = EAGAIN;
+        break;
+      }
+
+      if (!awaitFileInput(endpoint->direction.input.ring.doorbell, timeout)) break;
+    }
+  }
+
+  return count;
+}
+
 void
 usbSetEndpointInputError (UsbEndpoint *endpoint, int error) {
   if (!usbHaveInputError(endpoint)) {
-    endpoint->direction.input.pipe.error = error;
-    closeFile(&endpoint->direction.input.pipe.input);
+    *usbGetInputErrorCode(endpoint) = error;
+
+    if (usbHaveInputRing(endpoint)) {
+      endpoint->direction.input.ring.broken = 1;
+      usbRingInputDoorbell(endpoint);
+    } else {
+      closeFile(&endpoint->direction.input.pipe.input);
+    }
   }
 }
 
@@ -635,7 +781,7 @@ usbSetInputError (void *item, void *data) {
   UsbEndpoint *endpoint = item;
   const int *error = data;
 
-  if (usbHaveInputPipe(endpoint)) {
+  if (usbHaveInputQueue(endpoint)) {
     usbSetEndpointInputError(endpoint, *error);
   }
 
@@ -654,6 +800,7 @@ usbEnqueueInput (UsbEndpoint *endpoint, const void *buffer, size_t length) {
     return 0;
   }
 
+  if (usbHaveInputRing(endpoint)) return usbEnqueueInputRing(endpoint, buffer, length);
   return writeFile(endpoint->direction.input.pipe.input, buffer, length) != -1;
 }
 
@@ -662,11 +809,18 @@ usbDestroyInputPipe (UsbEndpoint *endpoint) {
   usbCancelInputMonitor(endpoint);
   closeFile(&endpoint->direction.input.pipe.input);
   closeFile(&endpoint->direction.input.pipe.output);
+
+  if (endpoint->direction.input.ring.buffer) {
+    free(endpoint->direction.input.ring.buffer);
+    endpoint->direction.input.ring.buffer = NULL;
+  }
+
+  closeFile(&endpoint->direction.input.ring.doorbell);
 }
 
 int
 usbMakeInputPipe (UsbEndpoint *endpoint) {
-  if (usbHaveInputPipe(endpoint)) return 1;
+  if (usbHaveInputQueue(endpoint)) return 1;
 
   if (createAnonymousPipe(&endpoint->direction.input.pipe.input,
                           &endpoint->direction.input.pipe.output)) {
@@ -679,6 +833,31 @@ usbMakeInputPipe (UsbEndpoint *endpoint) {
   return 0;
 }
 
+int
+usbMakeInputRing (UsbEndpoint *endpoint, FileDescriptor doorbell) {
+  UsbInputRing *ring = &endpoint->direction.input.ring;
+
+  if (usbHaveInputQueue(endpoint)) return 0;
+
+  if (!(ring->buffer = malloc(USB_INPUT_RING_SIZE))) {
+    logMallocError();
+    return 0;
+  }
+
+  ring->size = USB_INPUT_RING_SIZE;
+  ring->head = ring->tail = 0;
+  ring->doorbell = doorbell;
+  ring->error = 0;
+  ring->broken = 0;
+
+  logMessage(LOG_CATEGORY(USB_IO),
+    "input ring created: Ept:%02X Size:%"PRIsize,
+    endpoint->descriptor->bEndpointAddress, ring->size
+  );
+
+  return 1;
+}
+
 int
 usbMonitorInputPipe (
   UsbDevice *device, unsigned char endpointNumber,
@@ -687,13 +866,16 @@ usbMonitorInputPipe (
   UsbEndpoint *endpoint = usbGetInputEndpoint(device, endpointNumber);
 
   if (endpoint) {
-    if (usbHaveInputPipe(endpoint)) {
+    if (usbHaveInputQueue(endpoint)) {
+      FileDescriptor fileDescriptor = usbHaveInputRing(endpoint)?
+                                      endpoint->direction.input.ring.doorbell:
+                                      endpoint->direction.input.pipe.output;
+
       usbCancelInputMonitor(endpoint);
       if (!callback) return 1;
 
       if (asyncMonitorFileInput(&endpoint->direction.input.pipe.monitor,
-                                endpoint->direction.input.pipe.output,
-                                callback, data)) {
+                                fileDescriptor, callback, data)) {
         return 1;
       }
     }
@@ -801,6 +983,7 @@ usbGetEndpoint (UsbDevice *device, unsigned char endpointAddress) {
           endpoint->direction.input.pending.requests = NULL;
           endpoint->direction.input.pending.alarm = NULL;
           endpoint->direction.input.pending.delay = 0;
+          endpoint->direction.input.pending.depth = USB_INPUT_INTERRUPT_REQUESTS_MINIMUM;
 
           endpoint->direction.input.completed.request = NULL;
           endpoint->direction.input.completed.buffer = NULL;
@@ -811,6 +994,14 @@ usbGetEndpoint (UsbDevice *device, unsigned char endpointAddress) {
           endpoint->direction.input.pipe.monitor = NULL;
           endpoint->direction.input.pipe.error = 0;
 
+          endpoint->direction.input.ring.buffer = NULL;
+          endpoint->direction.input.ring.size = 0;
+          endpoint->direction.input.ring.head = 0;
+          endpoint->direction.input.ring.tail = 0;
+          endpoint->direction.input.ring.doorbell = INVALID_FILE_DESCRIPTOR;
+          endpoint->direction.input.ring.error = 0;
+          endpoint->direction.input.ring.broken = 0;
+
           break;
       }
 
@@ -1112,9 +1303,40 @@ usbAddPendingInputRequest (UsbEndpoint *endpoint) {
   return NULL;
 }
 
+static void
+usbSetPendingInputDepth (UsbEndpoint *endpoint, int depth) {
+  int *current = &endpoint->direction.input.pending.depth;
+
+  depth = MAX(depth, USB_INPUT_INTERRUPT_REQUESTS_MINIMUM);
+  depth = MIN(depth, USB_INPUT_INTERRUPT_REQUESTS_MAXIMUM);
+
+  if (depth != *current) {
+    logMessage(LOG_CATEGORY(USB_IO),
+      "input request depth: Ept:%02X Depth:%d",
+      endpoint->descriptor->bEndpointAddress, depth
+    );
+
+    *current = depth;
+  }
+}
+
+void
+usbNoteInputBurst (UsbEndpoint *endpoint, int count) {
+  /* several reports completed within one wakeup - keep twice that many
+   * requests outstanding so that the next burst doesn't run them dry
+   */
+  if (count > 1) {
+    int depth = count * 2;
+
+    if (depth > endpoint->direction.input.pending.depth) {
+      usbSetPendingInputDepth(endpoint, depth);
+    }
+  }
+}
+
 static void
 usbEnsurePendingInputRequests (UsbEndpoint *endpoint, int count) {
-  int limit = USB_INPUT_INTERRUPT_REQUESTS_MAXIMUM;
+  int limit = endpoint->direction.input.pending.depth;
   if ((count < 1) || (count > limit)) count = limit;
   endpoint->direction.input.pending.delay = 0;
 
@@ -1152,6 +1374,7 @@ usbSchedulePendingInputRequest (UsbEndpoint *endpoint) {
 int
 usbHandleInputResponse (UsbEndpoint *endpoint, const void *buffer, size_t length) {
   int requestsLeft = getQueueSize(endpoint->direction.input.pending.requests);
+  int depth = endpoint->direction.input.pending.depth;
 
   if (length > 0) {
     if (!usbEnqueueInput(endpoint, buffer, length)) {
@@ -1159,10 +1382,13 @@ usbHandleInputResponse (UsbEndpoint *endpoint, const void *buffer, size_t length
       return 0;
     }
 
+    usbSetPendingInputDepth(endpoint, depth+1);
     usbEnsurePendingInputRequests(endpoint, requestsLeft+2);
     return 1;
   }
 
+  usbSetPendingInputDepth(endpoint, depth-1);
+
   if (requestsLeft == 0) {
     usbSchedulePendingInputRequest(endpoint);
   }
@@ -1216,6 +1442,16 @@ usbAwaitInput (
     return 0;
   }
 
+  if (usbHaveInputRing(endpoint)) {
+    if (usbHaveInputError(endpoint)) {
+      errno = endpoint->direction.input.ring.error;
+      return 0;
+    }
+
+    if (usbGetInputRingCount(endpoint)) return 1;
+    return awaitFileInput(endpoint->direction.input.ring.doorbell, timeout);
+  }
+
   if (usbHaveInputPipe(endpoint)) {
     if (usbHaveInputError(endpoint)) {
       errno = endpoint->direction.input.pipe.error;
@@ -1322,13 +1558,19 @@ usbReadData (
     unsigned char *bytes = buffer;
     unsigned char *target = bytes;
 
-    if (usbHaveInputPipe(endpoint)) {
+    if (usbHaveInputQueue(endpoint)) {
       if (usbHaveInputError(endpoint)) {
-        errno = endpoint->direction.input.pipe.error;
-        endpoint->direction.input.pipe.error = EAGAIN;
+        int *error = usbGetInputErrorCode(endpoint);
+
+        errno = *error;
+        *error = EAGAIN;
         return -1;
       }
 
+      if (usbHaveInputRing(endpoint)) {
+        return usbReadInputRing(endpoint, buffer, length, initialTimeout, subsequentTimeout);
+      }
+
       return readFile(endpoint->direction.input.pipe.output, buffer, length, initialTimeout, subsequentTimeout);
     }
 
@@ -1451,7 +1693,7 @@ usbPrepareChannel (UsbChannel *channel) {
           if (!endpoint) {
             ok = 0;
           } else if ((USB_ENDPOINT_TRANSFER(endpoint->descriptor) == UsbEndpointTransfer_Interrupt) ||
-                     usbHaveInputPipe(endpoint)) {
+                     usbHaveInputQueue(endpoint)) {
             usbBeginInput(device, definition->inputEndpoint);
           }
         }
@@ -1516,6 +1758,12 @@ struct UsbChooseChannelDataStruct {
   uint16_t vendorIdentifier;
   uint16_t productIdentifier;
   unsigned genericDevices:1;
+
+  struct {
+    const char **codes;
+    unsigned int count;
+    unsigned int size;
+  } attachedDrivers;
 };
 
 static int
@@ -1779,6 +2027,91 @@ usbGetDriverCodes (uint16_t vendor, uint16_t product) {
   return entry? entry->driverCodes: NULL;
 }
 
+static int
+usbAddAttachedDriver (UsbChooseChannelData *data, const char *code) {
+  for (unsigned int index=0; index<data->attachedDrivers.count; index+=1) {
+    if (strcmp(data->attachedDrivers.codes[index], code) == 0) return 1;
+  }
+
+  if (data->attachedDrivers.count == data->attachedDrivers.size) {
+    unsigned int newSize = data->attachedDrivers.size? data->attachedDrivers.size<<1: 0X10;
+    const char **newCodes = realloc(data->attachedDrivers.codes, ARRAY_SIZE(newCodes, newSize+1));
+
+    if (!newCodes) {
+      logMallocError();
+      return 0;
+    }
+
+    data->attachedDrivers.codes = newCodes;
+    data->attachedDrivers.size = newSize;
+  }
+
+  data->attachedDrivers.codes[data->attachedDrivers.count++] = code;
+  return 1;
+}
+
+static int
+usbNoteAttachedDrivers (UsbDevice *device, UsbChooseChannelData *data) {
+  const UsbDeviceDescriptor *descriptor = &device->descriptor;
+  const char *const *code = usbGetDriverCodes(getLittleEndian16(descriptor->idVendor),
+                                              getLittleEndian16(descriptor->idProduct));
+
+  if (code) {
+    while (*code) {
+      if (!usbAddAttachedDriver(data, *code)) break;
+      code += 1;
+    }
+  }
+
+  return 0;
+}
+
+const char **
+usbGetAttachedDriverCodes (void) {
+  UsbChooseChannelData data;
+
+  memset(&data, 0, sizeof(data));
+  usbFindDevice(usbNoteAttachedDrivers, &data);
+
+  if (!data.attachedDrivers.count) {
+    if (data.attachedDrivers.codes) free(data.attachedDrivers.codes);
+    return NULL;
+  }
+
+  data.attachedDrivers.codes[data.attachedDrivers.count] = NULL;
+  return data.attachedDrivers.codes;
+}
+
+static UsbHotplugHandler *usbHotplugHandler = NULL;
+static void *usbHotplugData = NULL;
+
+void
+usbSetHotplugHandler (UsbHotplugHandler *handler, void *data) {
+  usbHotplugHandler = handler;
+  usbHotplugData = data;
+}
+
+void
+usbNoteHotplug (uint16_t vendor, uint16_t product, int arrived, int opened) {
+  const char *const *drivers = usbGetDriverCodes(vendor, product);
+
+  logMessage(LOG_CATEGORY(USB_IO), "device %s: vendor=%04X product=%04X",
+             (arrived? "arrived": "removed"), vendor, product);
+
+  if (drivers && usbHotplugHandler) {
+    const UsbHotplugParameters parameters = {
+      .driverCodes = drivers,
+      .vendor = vendor,
+      .product = product,
+      .arrived = arrived,
+      .opened = opened,
+      .data = usbHotplugData
+    };
+
+    usbHotplugHandler(&parameters);
+  }
+}
+
 int
 isUsbDeviceIdentifier (const char **identifier) {
   return hasQualifier(identifier, USB_DEVICE_QUALIFIER);
@@ -22,9 +22,35 @@
 #include <errno.h>
 
 #include "log.h"
+#include "parameters.h"
 #include "usb_serial.h"
 #include "usb_ftdi.h"
 
+struct UsbSerialDataStruct {
+  unsigned char latencyTimer;
+  unsigned haveLatencyTimer:1;
+};
+
+static int
+usbMakeData_FTDI (UsbDevice *device, UsbSerialData **serialData) {
+  UsbSerialData *usd;
+
+  if ((usd = malloc(sizeof(*usd)))) {
+    memset(usd, 0, sizeof(*usd));
+    *serialData = usd;
+    return 1;
+  } else {
+    logMallocError();
+  }
+
+  return 0;
+}
+
+static void
+usbDestroyData_FTDI (UsbSerialData *usd) {
+  free(usd);
+}
+
 static int
 usbInputFilter_FTDI (UsbInputFilterData *data) {
   return usbSkipInitialBytes(data, 2);
@@ -175,6 +201,36 @@ usbSetRtsState_FTDI (UsbDevice *device, int state) {
   return usbSetModemState_FTDI(device, state, 1, "RTS");
 }
 
+static int
+usbGetLatencyTimer_FTDI (UsbDevice *device, unsigned char *milliseconds) {
+  return usbControlRead(device, UsbControlRecipient_Device, UsbControlType_Vendor,
+                        10, 0, 0, milliseconds, 1, 1000) == 1;
+}
+
+static int
+usbSetLowLatency_FTDI (UsbDevice *device, int enabled) {
+  /* The chip holds partial packets back until its latency timer expires.
+   * The adapter's own setting is saved so that it can be restored.
+   */
+  UsbSerialData *usd = usbGetSerialData(device);
+
+  if (enabled) {
+    if (!usd->haveLatencyTimer) {
+      if (!usbGetLatencyTimer_FTDI(device, &usd->latencyTimer)) return 0;
+      usd->haveLatencyTimer = 1;
+      logMessage(LOG_CATEGORY(SERIAL_IO), "FTDI latency timer: %ums", usd->latencyTimer);
+    }
+
+    return usbSetAttribute_FTDI(device, 9, SERIAL_LOW_LATENCY_TIMER, 0);
+  }
+
+  if (!usd->haveLatencyTimer) return 1;
+  if (!usbSetAttribute_FTDI(device, 9, usd->latencyTimer, 0)) return 0;
+
+  usd->haveLatencyTimer = 0;
+  return 1;
+}
+
 const UsbSerialOperations usbSerialOperations_FTDI_SIO = {
   .name = "FTDI_SIO",
 
@@ -195,6 +251,9 @@ const UsbSerialOperations usbSerialOperations_FTDI_FT8U232AM = {
 
   .setDtrState = usbSetDtrState_FTDI,
   .setRtsState = usbSetRtsState_FTDI,
+  .setLowLatency = usbSetLowLatency_FTDI,
+  .makeData = usbMakeData_FTDI,
+  .destroyData = usbDestroyData_FTDI,
 
   .inputFilter = usbInputFilter_FTDI
 };
@@ -208,6 +267,9 @@ const UsbSerialOperations usbSerialOperations_FTDI_FT232BM = {
 
   .setDtrState = usbSetDtrState_FTDI,
   .setRtsState = usbSetRtsState_FTDI,
+  .setLowLatency = usbSetLowLatency_FTDI,
+  .makeData = usbMakeData_FTDI,
+  .destroyData = usbDestroyData_FTDI,
 
   .inputFilter = usbInputFilter_FTDI
 };
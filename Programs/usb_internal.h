@@ -35,6 +35,16 @@ typedef struct UsbDeviceExtensionStruct UsbDeviceExtension;
 typedef struct UsbEndpointStruct UsbEndpoint;
 typedef struct UsbEndpointExtensionStruct UsbEndpointExtension;
 
+typedef struct {
+  unsigned char *buffer;
+  size_t size;
+  volatile size_t head; /* only advanced by the reaper */
+  volatile size_t tail; /* only advanced by the reader */
+  FileDescriptor doorbell;
+  int error;
+  unsigned char broken:1;
+} UsbInputRing;
+
 struct UsbEndpointStruct {
   UsbDevice *device;
   const UsbInterfaceDescriptor *interface;
@@ -48,6 +58,7 @@ struct UsbEndpointStruct {
         Queue *requests;
         AsyncHandle alarm;
         int delay;
+        int depth;
       } pending;
 
       struct {
@@ -62,6 +73,8 @@ struct UsbEndpointStruct {
         AsyncHandle monitor;
         int error;
       } pipe;
+
+      UsbInputRing ring;
     } input;
 
     struct {
@@ -105,6 +118,8 @@ extern int usbApplyInputFilters (UsbEndpoint *endpoint, void *buffer, size_t siz
 
 extern void usbLogInputProblem (UsbEndpoint *endpoint, const char *problem);
 extern int usbHandleInputResponse (UsbEndpoint *endpoint, const void *buffer, size_t length);
+extern void usbNoteInputBurst (UsbEndpoint *endpoint, int count);
+extern void usbNoteHotplug (uint16_t vendor, uint16_t product, int arrived, int opened);
 
 extern int usbSetSerialOperations (UsbDevice *device);
 
@@ -121,6 +136,7 @@ extern int usbSetAlternative (
 );
 
 extern int usbMakeInputPipe (UsbEndpoint *endpoint);
+extern int usbMakeInputRing (UsbEndpoint *endpoint, FileDescriptor doorbell);
 extern void usbDestroyInputPipe (UsbEndpoint *endpoint);
 extern int usbEnqueueInput (UsbEndpoint *endpoint, const void *buffer, size_t length);
 
@@ -27,6 +27,7 @@
 #include <sys/stat.h>
 #include <sys/vfs.h>
 #include <sys/ioctl.h>
+#include <sys/eventfd.h>
 #include <linux/usbdevice_fs.h>
 
 #ifndef USBDEVFS_DISCONNECT
@@ -50,6 +51,7 @@
 #include "async_io.h"
 #include "async_signal.h"
 #include "mntpt.h"
+#include "system_linux.h"
 #include "io_usb.h"
 #include "usb_internal.h"
 
@@ -57,12 +59,17 @@ typedef struct {
   char *sysfsPath;
   char *usbfsPath;
   UsbDeviceDescriptor usbDescriptor;
+
+  unsigned int references;
+  unsigned orphaned:1;
 } UsbHostDevice;
 
 static Queue *usbHostDevices = NULL;
+static char *usbfsRoot = NULL;
+static KobjectUeventMonitor *usbUeventMonitor = NULL;
 
 struct UsbDeviceExtensionStruct {
-  const UsbHostDevice *host;
+  UsbHostDevice *host;
   int usbfsFile;
   AsyncHandle usbfsMonitorHandle;
 };
@@ -70,6 +77,11 @@ struct UsbDeviceExtensionStruct {
 struct UsbEndpointExtensionStruct {
   Queue *completedRequests;
 
+  struct {
+    struct usbdevfs_urb *requests[USB_INPUT_INTERRUPT_REQUESTS_MAXIMUM];
+    unsigned int count;
+  } spare;
+
   struct {
     struct {
       AsyncHandle handle;
@@ -553,6 +565,46 @@ usbLogURB (const struct usbdevfs_urb *urb, const char *action) {
   logData(LOG_CATEGORY(USB_IO), usbFormatURB, &fud);
 }
 
+static void
+usbInitializeURB (
+  struct usbdevfs_urb *urb,
+  const UsbEndpointDescriptor *endpoint,
+  void *buffer,
+  size_t length,
+  void *context
+) {
+  memset(urb, 0, sizeof(*urb));
+  urb->endpoint = endpoint->bEndpointAddress;
+  urb->flags = 0;
+  urb->signr = 0;
+  urb->usercontext = context;
+
+  if (!(urb->buffer_length = length)) {
+    urb->buffer = NULL;
+  } else {
+    urb->buffer = urb + 1;
+    if (buffer) memcpy(urb->buffer, buffer, length);
+  }
+
+  switch (USB_ENDPOINT_TRANSFER(endpoint)) {
+    case UsbEndpointTransfer_Control:
+      urb->type = USBDEVFS_URB_TYPE_CONTROL;
+      break;
+
+    case UsbEndpointTransfer_Isochronous:
+      urb->type = USBDEVFS_URB_TYPE_ISO;
+      break;
+
+    case UsbEndpointTransfer_Interrupt:
+      urb->type = USBDEVFS_URB_TYPE_INTERRUPT;
+      break;
+
+    case UsbEndpointTransfer_Bulk:
+      urb->type = USBDEVFS_URB_TYPE_BULK;
+      break;
+  }
+}
+
 static struct usbdevfs_urb *
 usbMakeURB (
   const UsbEndpointDescriptor *endpoint,
@@ -563,45 +615,51 @@ usbMakeURB (
   struct usbdevfs_urb *urb;
 
   if ((urb = malloc(sizeof(*urb) + length))) {
-    memset(urb, 0, sizeof(*urb));
-    urb->endpoint = endpoint->bEndpointAddress;
-    urb->flags = 0;
-    urb->signr = 0;
-    urb->usercontext = context;
-
-    if (!(urb->buffer_length = length)) {
-      urb->buffer = NULL;
-    } else {
-      urb->buffer = urb + 1;
-      if (buffer) memcpy(urb->buffer, buffer, length);
-    }
+    usbInitializeURB(urb, endpoint, buffer, length, context);
+    return urb;
+  } else {
+    logMallocError();
+  }
 
-    switch (USB_ENDPOINT_TRANSFER(endpoint)) {
-      case UsbEndpointTransfer_Control:
-        urb->type = USBDEVFS_URB_TYPE_CONTROL;
-        break;
+  return NULL;
+}
 
-      case UsbEndpointTransfer_Isochronous:
-        urb->type = USBDEVFS_URB_TYPE_ISO;
-        break;
+static struct usbdevfs_urb *
+usbGetSpareURB (UsbEndpoint *endpoint, size_t length, void *context) {
+  UsbEndpointExtension *eptx = endpoint->extension;
 
-      case UsbEndpointTransfer_Interrupt:
-        urb->type = USBDEVFS_URB_TYPE_INTERRUPT;
-        break;
+  while (eptx->spare.count > 0) {
+    struct usbdevfs_urb *urb = eptx->spare.requests[--eptx->spare.count];
 
-      case UsbEndpointTransfer_Bulk:
-        urb->type = USBDEVFS_URB_TYPE_BULK;
-        break;
+    if (urb->buffer_length == length) {
+      usbInitializeURB(urb, endpoint->descriptor, NULL, length, context);
+      return urb;
     }
 
-    return urb;
-  } else {
-    logMallocError();
+    free(urb);
   }
 
   return NULL;
 }
 
+static void
+usbRecycleURB (UsbEndpoint *endpoint, struct usbdevfs_urb *urb) {
+  UsbEndpointExtension *eptx = endpoint->extension;
+
+  if (eptx->spare.count < ARRAY_COUNT(eptx->spare.requests)) {
+    eptx->spare.requests[eptx->spare.count++] = urb;
+  } else {
+    free(urb);
+  }
+}
+
+static void
+usbFreeSpareURBs (UsbEndpointExtension *eptx) {
+  while (eptx->spare.count > 0) {
+    free(eptx->spare.requests[--eptx->spare.count]);
+  }
+}
+
 static int
 usbSubmitURB (struct usbdevfs_urb *urb, UsbEndpoint *endpoint) {
   const UsbEndpointDescriptor *descriptor = endpoint->descriptor;
@@ -649,9 +707,12 @@ usbSubmitRequest (
 
     if ((endpoint = usbGetEndpoint(device, endpointAddress))) {
       UsbEndpointExtension *eptx = endpoint->extension;
-      struct usbdevfs_urb *urb;
+      struct usbdevfs_urb *urb = NULL;
+
+      if (!buffer) urb = usbGetSpareURB(endpoint, length, context);
+      if (!urb) urb = usbMakeURB(endpoint->descriptor, buffer, length, context);
 
-      if ((urb = usbMakeURB(endpoint->descriptor, buffer, length, context))) {
+      if (urb) {
         urb->actual_length = 0;
         urb->signr = eptx->monitor.signal.number;
 
@@ -999,7 +1060,7 @@ ASYNC_SIGNAL_CALLBACK(usbHandleInputSignal) {
         usbStopSignalMonitor(eptx);
       }
 
-      free(urb);
+      usbRecycleURB(endpoint, urb);
       if (!handled) return 0;
     }
   }
@@ -1065,9 +1126,34 @@ usbHandleCompletedInputRequest (UsbEndpoint *endpoint, struct usbdevfs_urb *urb)
   return 0;
 }
 
+static int
+usbHandleReapedInputRequests (void *item, void *data) {
+  UsbEndpoint *endpoint = item;
+  UsbEndpointExtension *eptx = endpoint->extension;
+
+  if (USB_ENDPOINT_DIRECTION(endpoint->descriptor) != UsbEndpointDirection_Input) return 0;
+  usbNoteInputBurst(endpoint, getQueueSize(eptx->completedRequests));
+
+  while (1) {
+    struct usbdevfs_urb *urb = dequeueItem(eptx->completedRequests);
+    if (!urb) break;
+    usbLogURB(urb, "reaped");
+
+    int handled = usbHandleCompletedInputRequest(endpoint, urb);
+    int error = errno;
+    usbRecycleURB(endpoint, urb);
+
+    if (!handled) {
+      usbSetEndpointInputError(endpoint, error);
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
 ASYNC_MONITOR_CALLBACK(usbHandleCompletedInputRequests) {
   UsbDevice *device = parameters->data;
-  UsbEndpoint *endpoint;
 
   {
     int error = parameters->error;
@@ -1079,28 +1165,17 @@ ASYNC_MONITOR_CALLBACK(usbHandleCompletedInputRequests) {
     }
   }
 
-  while ((endpoint = usbReapURB(device, 0))) {
-    UsbEndpointExtension *eptx = endpoint->extension;
+  /* Reap every URB that has already completed before handling any of them
+   * so that a burst of reports is drained within a single wakeup.
+   */
+  while (usbReapURB(device, 0));
 
-    while (1) {
-      struct usbdevfs_urb *urb = dequeueItem(eptx->completedRequests);
-      if (!urb) break;
-      usbLogURB(urb, "reaped");
-
-      int handled = usbHandleCompletedInputRequest(endpoint, urb);
-      int error = errno;
-      free(urb);
-
-      if (!handled) {
-        usbSetEndpointInputError(endpoint, error);
-        return 0;
-      }
-    }
+  if (errno != EAGAIN) {
+    usbSetDeviceInputError(device, errno);
+    return 0;
   }
 
-  if (errno == EAGAIN) return 1;
-  usbSetDeviceInputError(device, errno);
-  return 0;
+  return !processQueue(device->endpoints, usbHandleReapedInputRequests, NULL);
 }
 
 static int
@@ -1125,6 +1200,22 @@ usbStartUsbfsMonitor (UsbDevice *device) {
   return 0;
 }
 
+static int
+usbMakeInputQueue (UsbEndpoint *endpoint) {
+  if (!LINUX_USB_INPUT_RING_DISABLE) {
+    int doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (doorbell != -1) {
+      if (usbMakeInputRing(endpoint, doorbell)) return 1;
+      close(doorbell);
+    } else {
+      logSystemError("eventfd");
+    }
+  }
+
+  return usbMakeInputPipe(endpoint);
+}
+
 static int
 usbPrepareInputEndpoint (UsbEndpoint *endpoint) {
   UsbDevice *device = endpoint->device;
@@ -1140,7 +1231,7 @@ usbPrepareInputEndpoint (UsbEndpoint *endpoint) {
       return 1;
   }
 
-  if (usbMakeInputPipe(endpoint)) {
+  if (usbMakeInputQueue(endpoint)) {
     int monitorStarted = LINUX_USB_INPUT_USE_SIGNAL_MONITOR?
                          usbStartSignalMonitor(endpoint):
                          usbStartUsbfsMonitor(device);
@@ -1153,7 +1244,7 @@ usbPrepareInputEndpoint (UsbEndpoint *endpoint) {
 
     usbDestroyInputPipe(endpoint);
   } else {
-    usbLogInputProblem(endpoint, "pipe not created");
+    usbLogInputProblem(endpoint, "input queue not created");
   }
 
   return 0;
@@ -1191,6 +1282,7 @@ usbAllocateEndpointExtension (UsbEndpoint *endpoint) {
 void
 usbDeallocateEndpointExtension (UsbEndpointExtension *eptx) {
   usbStopSignalMonitor(eptx);
+  usbFreeSpareURBs(eptx);
 
   if (eptx->completedRequests) {
     deallocateQueue(eptx->completedRequests);
@@ -1200,20 +1292,33 @@ usbDeallocateEndpointExtension (UsbEndpointExtension *eptx) {
   free(eptx);
 }
 
-void
-usbDeallocateDeviceExtension (UsbDeviceExtension *devx) {
-  usbStopUsbfsMonitor(devx);
-  usbCloseUsbfsFile(devx);
-  free(devx);
+static void
+usbFreeHostDevice (UsbHostDevice *host) {
+  if (host->sysfsPath) free(host->sysfsPath);
+  if (host->usbfsPath) free(host->usbfsPath);
+  free(host);
 }
 
 static void
 usbDeallocateHostDevice (void *item, void *data) {
   UsbHostDevice *host = item;
 
-  if (host->sysfsPath) free(host->sysfsPath);
-  if (host->usbfsPath) free(host->usbfsPath);
-  free(host);
+  if (host->references) {
+    host->orphaned = 1;
+  } else {
+    usbFreeHostDevice(host);
+  }
+}
+
+void
+usbDeallocateDeviceExtension (UsbDeviceExtension *devx) {
+  UsbHostDevice *host = devx->host;
+
+  usbStopUsbfsMonitor(devx);
+  usbCloseUsbfsFile(devx);
+  free(devx);
+
+  if (!--host->references && host->orphaned) usbFreeHostDevice(host);
 }
 
 typedef struct {
@@ -1224,13 +1329,14 @@ typedef struct {
 
 static int
 usbTestHostDevice (void *item, void *data) {
-  const UsbHostDevice *host = item;
+  UsbHostDevice *host = item;
   UsbTestHostDeviceData *test = data;
   UsbDeviceExtension *devx;
 
   if ((devx = malloc(sizeof(*devx)))) {
     memset(devx, 0, sizeof(*devx));
     devx->host = host;
+    host->references += 1;
     devx->usbfsFile = -1;
     usbInitializeUsbfsMonitor(devx);
 
@@ -1344,13 +1450,16 @@ usbReadHostDeviceDescriptor (UsbHostDevice *host) {
 }
 
 static int
-usbAddHostDevice (const char *path) {
+usbAddHostDevice (const char *path, char *sysfsPath) {
   int ok = 0;
   UsbHostDevice *host;
 
   if ((host = malloc(sizeof(*host)))) {
+    memset(host, 0, sizeof(*host));
+
     if ((host->usbfsPath = strdup(path))) {
-      host->sysfsPath = usbMakeSysfsPath(host->usbfsPath);
+      host->sysfsPath = sysfsPath? sysfsPath: usbMakeSysfsPath(host->usbfsPath);
+      sysfsPath = NULL;
 
       if (!usbReadHostDeviceDescriptor(host)) {
         ok = 1;
@@ -1369,6 +1478,7 @@ usbAddHostDevice (const char *path) {
     logMallocError();
   }
 
+  if (sysfsPath) free(sysfsPath);
   return ok;
 }
 
@@ -1394,7 +1504,7 @@ usbAddHostDevices (const char *root) {
       if (S_ISDIR(status.st_mode)) {
         if (!usbAddHostDevices(path)) ok = 0;
       } else if (S_ISREG(status.st_mode) || S_ISCHR(status.st_mode)) {
-        if (!usbAddHostDevice(path)) ok = 0;
+        if (!usbAddHostDevice(path, NULL)) ok = 0;
       }
 
       if (!ok) break;
@@ -1501,6 +1611,62 @@ usbGetUsbfs (void) {
   return usbGetFileSystem("usbfs", usbfsCandidates, usbTestUsbfs, usbVerifyUsbfs);
 }
 
+static int
+usbTestHostDevicePath (const void *item, void *data) {
+  const UsbHostDevice *host = item;
+  const char *path = data;
+
+  return strcmp(host->usbfsPath, path) == 0;
+}
+
+static KOBJECT_UEVENT_HANDLER(usbHandleUevent) {
+  const char *subsystem = getKobjectUeventProperty(event, "SUBSYSTEM");
+  const char *type = getKobjectUeventProperty(event, "DEVTYPE");
+  const char *bus = getKobjectUeventProperty(event, "BUSNUM");
+  const char *device = getKobjectUeventProperty(event, "DEVNUM");
+
+  if (!(subsystem && (strcmp(subsystem, "usb") == 0))) return;
+  if (!(type && (strcmp(type, "usb_device") == 0))) return;
+  if (!(bus && device && usbHostDevices && usbfsRoot)) return;
+
+  {
+    char path[strlen(usbfsRoot) + 1 + strlen(bus) + 1 + strlen(device) + 1];
+    UsbHostDevice *host;
+
+    snprintf(path, sizeof(path), "%s/%s/%s", usbfsRoot, bus, device);
+    host = findItem(usbHostDevices, usbTestHostDevicePath, path);
+
+    if (strcmp(event->action, "add") == 0) {
+      if (!host) {
+        static const char prefix[] = "/sys";
+        char *sysfsPath;
+
+        if ((sysfsPath = malloc(strlen(prefix) + strlen(event->path) + 1))) {
+          sprintf(sysfsPath, "%s%s", prefix, event->path);
+          usbAddHostDevice(path, sysfsPath);
+
+          if ((host = findItem(usbHostDevices, usbTestHostDevicePath, path))) {
+            usbNoteHotplug(getLittleEndian16(host->usbDescriptor.idVendor),
+                           getLittleEndian16(host->usbDescriptor.idProduct),
+                           1, 0);
+          }
+        } else {
+          logMallocError();
+        }
+      }
+    } else if (strcmp(event->action, "remove") == 0) {
+      if (host) {
+        uint16_t vendor = getLittleEndian16(host->usbDescriptor.idVendor);
+        uint16_t product = getLittleEndian16(host->usbDescriptor.idProduct);
+        int opened = host->references > 0;
+
+        deleteItem(usbHostDevices, host);
+        usbNoteHotplug(vendor, product, 0, opened);
+      }
+    }
+  }
+}
+
 UsbDevice *
 usbFindDevice (UsbDeviceChooser *chooser, UsbChooseChannelData *data) {
   if (!usbHostDevices) {
@@ -1513,7 +1679,17 @@ usbFindDevice (UsbDeviceChooser *chooser, UsbChooseChannelData *data) {
         logMessage(LOG_CATEGORY(USB_IO), "USBFS root: %s", root);
         if (usbAddHostDevices(root)) ok = 1;
 
-        free(root);
+        if (ok && !usbUeventMonitor) {
+          /* Keep the device index current from hotplug events so that it
+           * needn't be rebuilt (i.e. usbfs rescanned) for each search.
+           */
+          if ((usbUeventMonitor = newKobjectUeventMonitor(usbHandleUevent, NULL))) {
+            usbfsRoot = root;
+            root = NULL;
+          }
+        }
+
+        if (root) free(root);
       } else {
         logMessage(LOG_CATEGORY(USB_IO), "USBFS not mounted");
       }
@@ -1540,6 +1716,8 @@ usbFindDevice (UsbDeviceChooser *chooser, UsbChooseChannelData *data) {
 
 void
 usbForgetDevices (void) {
+  if (usbUeventMonitor) return;
+
   if (usbHostDevices) {
     deallocateQueue(usbHostDevices);
     usbHostDevices = NULL;
@@ -218,3 +218,19 @@ usbSetSerialParameters (UsbDevice *device, const SerialParameters *parameters) {
 
   return ok;
 }
+
+int
+usbSetSerialLowLatency (UsbDevice *device, int enabled) {
+  const UsbSerialOperations *serial = usbGetSerialOperations(device);
+
+  if (!serial) {
+    usbLogSerialProblem(device, "no serial operations");
+  } else if (!serial->setLowLatency) {
+    usbLogSerialProblem(device, "setting low latency is not supported");
+  } else {
+    return serial->setLowLatency(device, enabled);
+  }
+
+  errno = ENOSYS;
+  return 0;
+}